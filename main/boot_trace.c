@@ -0,0 +1,224 @@
+#include "boot_trace.h"
+#include "ota_events.h"
+#include "esp_app_desc.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "BOOT_TRACE";
+
+typedef struct {
+    boot_trace_header_t header;
+    boot_trace_event_t events[BOOT_TRACE_MAX_EVENTS];
+} boot_trace_t;
+
+// Not cleared at startup; only valid after a soft reset, checked by magic
+static RTC_NOINIT_ATTR boot_trace_t current;
+static RTC_NOINIT_ATTR boot_trace_t previous;
+
+static portMUX_TYPE trace_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *stage_names[BOOT_TRACE_STAGE_COUNT] = {
+    [BOOT_TRACE_APP_START]    = "app_start",
+    [BOOT_TRACE_NVS]          = "nvs",
+    [BOOT_TRACE_LED]          = "led",
+    [BOOT_TRACE_BUTTON]       = "button",
+    [BOOT_TRACE_RECOVERY]     = "recovery",
+    [BOOT_TRACE_HEALTH_START] = "health_start",
+    [BOOT_TRACE_WIFI]         = "wifi",
+    [BOOT_TRACE_OTA_SERVER]   = "ota_server",
+    [BOOT_TRACE_READY]        = "ready",
+    [BOOT_TRACE_WIFI_IP]      = "wifi_ip",
+    [BOOT_TRACE_VALIDATED]    = "validated",
+    [BOOT_TRACE_OTA_PHASE]    = "ota",
+};
+
+static const char *reset_names[] = {
+    [ESP_RST_UNKNOWN]   = "unknown",
+    [ESP_RST_POWERON]   = "poweron",
+    [ESP_RST_EXT]       = "ext",
+    [ESP_RST_SW]        = "sw",
+    [ESP_RST_PANIC]     = "panic",
+    [ESP_RST_INT_WDT]   = "int_wdt",
+    [ESP_RST_TASK_WDT]  = "task_wdt",
+    [ESP_RST_WDT]       = "wdt",
+    [ESP_RST_DEEPSLEEP] = "deepsleep",
+    [ESP_RST_BROWNOUT]  = "brownout",
+    [ESP_RST_SDIO]      = "sdio",
+};
+
+static bool boot_trace_valid(const boot_trace_t *trace)
+{
+    return trace->header.magic == BOOT_TRACE_MAGIC &&
+           trace->header.format == BOOT_TRACE_FORMAT &&
+           trace->header.count <= BOOT_TRACE_MAX_EVENTS;
+}
+
+const char *boot_trace_stage_name(boot_trace_stage_t stage)
+{
+    return stage < BOOT_TRACE_STAGE_COUNT ? stage_names[stage] : "unknown";
+}
+
+void boot_trace_init(void)
+{
+    esp_reset_reason_t reason = esp_reset_reason();
+    uint32_t boot_count = 1;
+
+    // RTC memory holds garbage after power-on
+    if (reason != ESP_RST_POWERON && boot_trace_valid(&current)) {
+        memcpy(&previous, &current, sizeof(previous));
+        boot_count = current.header.boot_count + 1;
+    } else {
+        previous.header.magic = 0;
+    }
+
+    memset(&current.header, 0, sizeof(current.header));
+    current.header.magic = BOOT_TRACE_MAGIC;
+    current.header.format = BOOT_TRACE_FORMAT;
+    current.header.reset_reason = reason;
+    current.header.boot_count = boot_count;
+    strncpy(current.header.version, esp_app_get_description()->version,
+            sizeof(current.header.version) - 1);
+
+    boot_trace_mark(BOOT_TRACE_APP_START, 0);
+    ESP_LOGI(TAG, "Boot %lu (reset: %s)", (unsigned long)boot_count,
+             reason < sizeof(reset_names) / sizeof(reset_names[0]) ? reset_names[reason] : "?");
+}
+
+void boot_trace_mark(boot_trace_stage_t stage, uint16_t arg)
+{
+    int64_t now = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&trace_lock);
+    if (current.header.count < BOOT_TRACE_MAX_EVENTS) {
+        boot_trace_event_t *event = &current.events[current.header.count++];
+        event->time_us = now;
+        event->stage = stage;
+        event->arg = arg;
+    }
+    taskEXIT_CRITICAL(&trace_lock);
+}
+
+static void boot_trace_snapshot(boot_trace_t *out, const boot_trace_t *trace)
+{
+    taskENTER_CRITICAL(&trace_lock);
+    memcpy(out, trace, sizeof(*out));
+    taskEXIT_CRITICAL(&trace_lock);
+}
+
+static esp_err_t boot_trace_send_json(httpd_req_t *req, const char *key, const boot_trace_t *trace)
+{
+    char buf[160];
+    int len;
+
+    if (!boot_trace_valid(trace)) {
+        len = snprintf(buf, sizeof(buf), "\"%s\":null", key);
+        return httpd_resp_send_chunk(req, buf, len);
+    }
+
+    const boot_trace_header_t *hdr = &trace->header;
+    char version[sizeof(hdr->version) + 1] = {0};
+    memcpy(version, hdr->version, sizeof(hdr->version));
+    for (char *p = version; *p; p++) {
+        if (*p == '"' || *p == '\\' || (unsigned char)*p < 0x20) {
+            *p = '_';
+        }
+    }
+    len = snprintf(buf, sizeof(buf), "\"%s\":{\"boot\":%lu,\"reset\":\"%s\",\"version\":\"%s\",\"events\":[",
+                   key, (unsigned long)hdr->boot_count,
+                   hdr->reset_reason < sizeof(reset_names) / sizeof(reset_names[0])
+                       ? reset_names[hdr->reset_reason] : "?",
+                   version);
+    esp_err_t err = httpd_resp_send_chunk(req, buf, len);
+
+    for (int i = 0; i < hdr->count && err == ESP_OK; i++) {
+        const boot_trace_event_t *event = &trace->events[i];
+        uint64_t dt = i > 0 ? event->time_us - trace->events[i - 1].time_us : event->time_us;
+        const char *detail = event->stage == BOOT_TRACE_OTA_PHASE && event->arg <= OTA_PHASE_CANCELLED
+                             ? ota_phase_name(event->arg) : NULL;
+        len = snprintf(buf, sizeof(buf), "%s{\"stage\":\"%s\",\"t_us\":%llu,\"dt_us\":%llu,\"arg\":%u%s%s%s}",
+                       i > 0 ? "," : "", boot_trace_stage_name(event->stage),
+                       (unsigned long long)event->time_us, (unsigned long long)dt, event->arg,
+                       detail ? ",\"phase\":\"" : "", detail ? detail : "", detail ? "\"" : "");
+        err = httpd_resp_send_chunk(req, buf, len);
+    }
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, "]}", 2);
+    }
+    return err;
+}
+
+static esp_err_t boot_trace_json_handler(httpd_req_t *req)
+{
+    boot_trace_t trace;
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    esp_err_t err = httpd_resp_send_chunk(req, "{", 1);
+    if (err == ESP_OK) {
+        boot_trace_snapshot(&trace, &previous);
+        err = boot_trace_send_json(req, "previous", &trace);
+    }
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, ",", 1);
+    }
+    if (err == ESP_OK) {
+        boot_trace_snapshot(&trace, &current);
+        err = boot_trace_send_json(req, "current", &trace);
+    }
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, "}", 1);
+    }
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, NULL, 0);
+    }
+    return err;
+}
+
+// Header plus the recorded events only; a missing previous trace is skipped
+static esp_err_t boot_trace_bin_handler(httpd_req_t *req)
+{
+    boot_trace_t trace;
+    esp_err_t err = ESP_OK;
+
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    const boot_trace_t *traces[] = { &previous, &current };
+    for (int i = 0; i < 2 && err == ESP_OK; i++) {
+        boot_trace_snapshot(&trace, traces[i]);
+        if (boot_trace_valid(&trace)) {
+            err = httpd_resp_send_chunk(req, (const char *)&trace,
+                                        sizeof(trace.header) + trace.header.count * sizeof(trace.events[0]));
+        }
+    }
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, NULL, 0);
+    }
+    return err;
+}
+
+esp_err_t boot_trace_register_handlers(httpd_handle_t server)
+{
+    httpd_uri_t json_uri = {
+        .uri       = "/trace",
+        .method    = HTTP_GET,
+        .handler   = boot_trace_json_handler,
+    };
+    esp_err_t err = httpd_register_uri_handler(server, &json_uri);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    httpd_uri_t bin_uri = {
+        .uri       = "/trace.bin",
+        .method    = HTTP_GET,
+        .handler   = boot_trace_bin_handler,
+    };
+    return httpd_register_uri_handler(server, &bin_uri);
+}
@@ -0,0 +1,81 @@
+#ifndef BOOT_TRACE_H
+#define BOOT_TRACE_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+/**
+ * Timestamped trace of boot stages and OTA phases, kept in RTC memory so the
+ * trace of the previous boot survives a soft reset (esp_restart, panic,
+ * watchdog, OTA reboot). Each mark records when a stage finished, in
+ * microseconds since startup; the difference to the previous mark is the
+ * time the stage took.
+ *
+ * GET /trace renders both traces as JSON, GET /trace.bin returns the compact
+ * binary form (previous boot, then this one) for tools/boot-trace.py.
+ */
+
+#ifndef BOOT_TRACE_MAX_EVENTS
+#define BOOT_TRACE_MAX_EVENTS  48       // Per boot, later marks are dropped
+#endif
+#define BOOT_TRACE_MAGIC       0x54425254   // "TRBT"
+#define BOOT_TRACE_FORMAT      1
+
+// Stage ids are part of the binary format, append only (tools/boot-trace.py)
+typedef enum {
+    BOOT_TRACE_APP_START = 0,   // app_main() entered
+    BOOT_TRACE_NVS,             // nvs_flash_init(), including an erase
+    BOOT_TRACE_LED,             // led_init()
+    BOOT_TRACE_BUTTON,          // Recovery button debounce and read
+    BOOT_TRACE_RECOVERY,        // Recovery portal up
+    BOOT_TRACE_HEALTH_START,    // Validation registered and started
+    BOOT_TRACE_WIFI,            // wifi_init() returned
+    BOOT_TRACE_OTA_SERVER,      // ota_manager_start() returned
+    BOOT_TRACE_READY,           // Startup done
+    BOOT_TRACE_WIFI_IP,         // Station got an IP address
+    BOOT_TRACE_VALIDATED,       // New image marked valid
+    BOOT_TRACE_OTA_PHASE,       // arg: ota_phase_t entered
+    BOOT_TRACE_STAGE_COUNT,
+} boot_trace_stage_t;
+
+typedef struct __attribute__((packed)) {
+    uint64_t time_us;           // esp_timer_get_time() at the mark
+    uint16_t stage;             // boot_trace_stage_t
+    uint16_t arg;
+} boot_trace_event_t;
+
+/**
+ * Binary dump of one boot: this header, then count events (little endian)
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;             // BOOT_TRACE_MAGIC
+    uint8_t format;             // BOOT_TRACE_FORMAT
+    uint8_t reset_reason;       // esp_reset_reason() that started this boot
+    uint16_t count;             // Events that follow
+    uint32_t boot_count;        // Boots since power-on
+    char version[32];           // App version that recorded the trace
+} boot_trace_header_t;
+
+/**
+ * @brief Keep the previous boot's trace and start a new one
+ * Call first thing in app_main(); records BOOT_TRACE_APP_START.
+ */
+void boot_trace_init(void);
+
+/**
+ * @brief Record that a stage finished now, from any task
+ */
+void boot_trace_mark(boot_trace_stage_t stage, uint16_t arg);
+
+/**
+ * @brief Name of a stage as used in JSON and by the host decoder
+ */
+const char *boot_trace_stage_name(boot_trace_stage_t stage);
+
+/**
+ * @brief Register GET /trace and GET /trace.bin on server
+ */
+esp_err_t boot_trace_register_handlers(httpd_handle_t server);
+
+#endif
@@ -0,0 +1,108 @@
+#include "health_check.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "led_indicator.h"
+#include "boot_trace.h"
+#include "ota_manager.h"
+
+static const char *TAG = "HEALTH";
+
+typedef struct {
+    const char *name;
+    health_check_fn_t fn;
+    void *arg;
+} health_check_t;
+
+static health_check_t checks[HEALTH_CHECK_MAX];
+static int check_count = 0;
+static volatile bool validating = false;
+
+esp_err_t health_check_register(const char *name, health_check_fn_t fn, void *arg)
+{
+    if (validating) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (check_count == HEALTH_CHECK_MAX) {
+        return ESP_ERR_NO_MEM;
+    }
+    checks[check_count++] = (health_check_t){ .name = name, .fn = fn, .arg = arg };
+    return ESP_OK;
+}
+
+health_status_t health_check_heap(void *arg)
+{
+    size_t min_free = (size_t)(uintptr_t)arg;
+    return heap_caps_get_free_size(MALLOC_CAP_8BIT) >= min_free ? HEALTH_PASS : HEALTH_PENDING;
+}
+
+static void health_check_task(void *pvParameter)
+{
+    uint32_t deadline_ms = (uint32_t)(uintptr_t)pvParameter;
+    int64_t start_us = esp_timer_get_time();
+    const char *waiting = NULL;
+
+    while (1) {
+        int passed = 0;
+        waiting = NULL;
+        for (int i = 0; i < check_count; i++) {
+            health_status_t st = checks[i].fn(checks[i].arg);
+            if (st == HEALTH_FAIL) {
+                ESP_LOGE(TAG, "Check '%s' failed, rolling back", checks[i].name);
+                esp_ota_mark_app_invalid_rollback_and_reboot();
+            } else if (st == HEALTH_PASS) {
+                passed++;
+            } else if (waiting == NULL) {
+                waiting = checks[i].name;
+            }
+        }
+
+        int64_t elapsed_ms = (esp_timer_get_time() - start_us) / 1000;
+        if (passed == check_count) {
+            esp_ota_mark_app_valid_cancel_rollback();
+            boot_trace_mark(BOOT_TRACE_VALIDATED, 0);
+            ESP_LOGI(TAG, "Firmware validated after %lld ms (%d checks)", elapsed_ms, check_count);
+            led_set_mode(LED_MODE_NORMAL);
+            break;
+        }
+        if (elapsed_ms >= deadline_ms) {
+            ESP_LOGE(TAG, "Check '%s' still pending after %lu ms, rolling back",
+                     waiting, (unsigned long)deadline_ms);
+            esp_ota_mark_app_invalid_rollback_and_reboot();
+        }
+        vTaskDelay(pdMS_TO_TICKS(HEALTH_CHECK_POLL_MS));
+    }
+
+    validating = false;
+    // The slot can be written again: pick up a download a reset cut off
+    ota_manager_resume_interrupted();
+    vTaskDelete(NULL);
+}
+
+esp_err_t health_check_start(uint32_t deadline_ms)
+{
+    esp_ota_img_states_t state;
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    if (esp_ota_get_state_partition(running, &state) != ESP_OK ||
+        state != ESP_OTA_IMG_PENDING_VERIFY) {
+        return ESP_OK;
+    }
+
+    ESP_LOGI(TAG, "New firmware detected, validating %d checks (deadline %lu ms)",
+             check_count, (unsigned long)deadline_ms);
+    led_set_mode(LED_MODE_OTA);
+    validating = true;
+    if (xTaskCreate(health_check_task, "health", 3072, (void *)(uintptr_t)deadline_ms, 5, NULL) != pdPASS) {
+        validating = false;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+bool health_check_pending(void)
+{
+    return validating;
+}
@@ -0,0 +1,57 @@
+#ifndef HEALTH_CHECK_H
+#define HEALTH_CHECK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * Post-OTA validation. Components register checks that are polled while
+ * normal startup continues; the new image is marked valid as soon as every
+ * check passes, and rolled back if one fails or the deadline expires.
+ */
+
+#ifndef HEALTH_CHECK_MAX
+#define HEALTH_CHECK_MAX         8
+#endif
+#ifndef HEALTH_CHECK_DEADLINE_MS
+#define HEALTH_CHECK_DEADLINE_MS 60000  // Roll back if not healthy by then
+#endif
+#ifndef HEALTH_CHECK_POLL_MS
+#define HEALTH_CHECK_POLL_MS     250
+#endif
+#ifndef HEALTH_CHECK_MIN_HEAP
+#define HEALTH_CHECK_MIN_HEAP    (32 * 1024)
+#endif
+
+typedef enum {
+    HEALTH_PENDING,     // Not there yet, ask again
+    HEALTH_PASS,
+    HEALTH_FAIL,        // Broken for good, roll back now
+} health_status_t;
+
+typedef health_status_t (*health_check_fn_t)(void *arg);
+
+/**
+ * @brief Add a check; must be called before health_check_start()
+ * @param name Shown in logs, must outlive the validation
+ */
+esp_err_t health_check_register(const char *name, health_check_fn_t fn, void *arg);
+
+/**
+ * @brief Start validating the running image in the background
+ * Does nothing unless the image is in ESP_OTA_IMG_PENDING_VERIFY.
+ */
+esp_err_t health_check_start(uint32_t deadline_ms);
+
+/**
+ * @brief True while a validation is still running
+ */
+bool health_check_pending(void);
+
+/**
+ * @brief Built-in check: free 8-bit heap is at least (uintptr_t)arg bytes
+ */
+health_status_t health_check_heap(void *arg);
+
+#endif
@@ -1,39 +1,53 @@
 #include "led_indicator.h"
+#include "led_pattern.h"
 #include "driver/gpio.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
+static portMUX_TYPE led_lock = portMUX_INITIALIZER_UNLOCKED;
 static led_mode_t current_mode = LED_MODE_NORMAL;
-static TaskHandle_t led_task_handle = NULL;
+static int current_progress = -1;   // -1 until OTA progress is reported
+static uint32_t mode_generation;    // Bumped on every mode switch
+static esp_timer_handle_t led_timer = NULL;
 
-static void led_task(void *pvParameters)
+// Owned by the timer callback
+static uint32_t shown_generation;
+static uint32_t step;
+
+// One-shot timer: show the current step, then arm for its duration
+static void led_timer_cb(void *arg)
+{
+    taskENTER_CRITICAL(&led_lock);
+    led_mode_t mode = current_mode;
+    int progress = current_progress;
+    uint32_t generation = mode_generation;
+    taskEXIT_CRITICAL(&led_lock);
+
+    if (generation != shown_generation) {
+        shown_generation = generation;
+        step = 0;
+    }
+
+    int level;
+    uint32_t duration_ms = led_pattern_step(mode, progress, step++, &level);
+    gpio_set_level(LED_GPIO, level);
+    if (duration_ms > 0) {
+        esp_timer_start_once(led_timer, (uint64_t)duration_ms * 1000);
+    }
+}
+
+// Cut the current step short so a new mode shows up immediately
+static void led_kick(void)
 {
-    while (1) {
-        switch (current_mode) {
-            case LED_MODE_NORMAL:
-                gpio_set_level(LED_GPIO, 1);
-                vTaskDelay(pdMS_TO_TICKS(1000));
-                gpio_set_level(LED_GPIO, 0);
-                vTaskDelay(pdMS_TO_TICKS(1000));
-                break;
-                
-            case LED_MODE_OTA:
-                gpio_set_level(LED_GPIO, 1);
-                vTaskDelay(pdMS_TO_TICKS(200));
-                gpio_set_level(LED_GPIO, 0);
-                vTaskDelay(pdMS_TO_TICKS(200));
-                break;
-                
-            case LED_MODE_RECOVERY:
-                // Double blink
-                for (int i = 0; i < 2; i++) {
-                    gpio_set_level(LED_GPIO, 1);
-                    vTaskDelay(pdMS_TO_TICKS(100));
-                    gpio_set_level(LED_GPIO, 0);
-                    vTaskDelay(pdMS_TO_TICKS(100));
-                }
-                vTaskDelay(pdMS_TO_TICKS(800));
-                break;
+    if (led_timer == NULL) {
+        return;
+    }
+    // The callback may re-arm between stop and start; one retry covers that
+    for (int i = 0; i < 2; i++) {
+        esp_timer_stop(led_timer);
+        if (esp_timer_start_once(led_timer, 0) == ESP_OK) {
+            break;
         }
     }
 }
@@ -45,11 +59,42 @@ void led_init(void)
         .mode = GPIO_MODE_OUTPUT,
     };
     gpio_config(&io_conf);
-    
-    xTaskCreate(led_task, "led_task", 2048, NULL, 5, &led_task_handle);
+
+    esp_timer_create_args_t timer_args = {
+        .callback = led_timer_cb,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "led",
+        .skip_unhandled_events = true,
+    };
+    if (esp_timer_create(&timer_args, &led_timer) == ESP_OK) {
+        led_kick();
+    }
 }
 
 void led_set_mode(led_mode_t mode)
 {
+    taskENTER_CRITICAL(&led_lock);
+    bool changed = (mode != current_mode);
     current_mode = mode;
-}
\ No newline at end of file
+    current_progress = -1;
+    if (changed) {
+        mode_generation++;
+    }
+    taskEXIT_CRITICAL(&led_lock);
+
+    if (changed) {
+        led_kick();
+    }
+}
+
+void led_set_progress(int percent)
+{
+    if (percent < 0) {
+        percent = 0;
+    } else if (percent > 100) {
+        percent = 100;
+    }
+    taskENTER_CRITICAL(&led_lock);
+    current_progress = percent;
+    taskEXIT_CRITICAL(&led_lock);
+}
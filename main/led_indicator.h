@@ -5,11 +5,26 @@
 
 typedef enum {
     LED_MODE_NORMAL,    // Slow blink (1s on, 1s off)
-    LED_MODE_OTA,       // Fast blink (200ms on, 200ms off)
-    LED_MODE_RECOVERY   // Double blink pattern
+    LED_MODE_OTA,       // Fast blink (200ms on, 200ms off), duty follows progress once reported
+    LED_MODE_RECOVERY,  // Double blink pattern
+    LED_MODE_OFF        // LED off, no timer wakeups
 } led_mode_t;
 
+// Progress blink during OTA: on-time grows with percent within a fixed period
+#define LED_PROGRESS_PERIOD_MS  1000
+#define LED_PROGRESS_MIN_ON_MS  50
+
 void led_init(void);
+
+/**
+ * @brief Switch pattern; takes effect immediately, restarting at the first step
+ */
 void led_set_mode(led_mode_t mode);
 
-#endif
\ No newline at end of file
+/**
+ * @brief Report OTA progress (0-100) for the LED_MODE_OTA blink
+ * Reset by every led_set_mode(); applied from the next pattern step.
+ */
+void led_set_progress(int percent);
+
+#endif
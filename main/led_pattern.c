@@ -0,0 +1,39 @@
+#include "led_pattern.h"
+#include <stddef.h>
+
+// Step durations in ms, alternating on/off starting with on. No steps = off.
+typedef struct {
+    const uint16_t *steps;
+    uint8_t count;
+} led_pattern_t;
+
+#define LED_PATTERN(s) { (s), sizeof(s) / sizeof((s)[0]) }
+
+static const uint16_t normal_steps[]   = { 1000, 1000 };
+static const uint16_t ota_steps[]      = { 200, 200 };
+static const uint16_t recovery_steps[] = { 100, 100, 100, 900 };     // Double blink
+
+static const led_pattern_t patterns[] = {
+    [LED_MODE_NORMAL]   = LED_PATTERN(normal_steps),
+    [LED_MODE_OTA]      = LED_PATTERN(ota_steps),
+    [LED_MODE_RECOVERY] = LED_PATTERN(recovery_steps),
+    [LED_MODE_OFF]      = { NULL, 0 },
+};
+
+uint32_t led_pattern_step(led_mode_t mode, int progress, uint32_t index, int *level)
+{
+    if (mode == LED_MODE_OTA && progress >= 0) {
+        uint32_t on = LED_PROGRESS_MIN_ON_MS +
+                      (LED_PROGRESS_PERIOD_MS - 2 * LED_PROGRESS_MIN_ON_MS) * progress / 100;
+        *level = (index % 2 == 0);
+        return *level ? on : LED_PROGRESS_PERIOD_MS - on;
+    }
+
+    const led_pattern_t *pattern = &patterns[mode];
+    if (pattern->count == 0) {
+        *level = 0;
+        return 0;
+    }
+    *level = (index % 2 == 0);
+    return pattern->steps[index % pattern->count];
+}
@@ -0,0 +1,20 @@
+#ifndef LED_PATTERN_H
+#define LED_PATTERN_H
+
+#include <stdint.h>
+#include "led_indicator.h"
+
+/**
+ * Blink patterns behind led_indicator.c, internal to it. Pure lookup with no
+ * GPIO or timer, so the step sequence builds and is tested on the host.
+ */
+
+/**
+ * @brief Level and duration of step index of mode
+ * @param progress OTA percent, -1 for the plain LED_MODE_OTA blink
+ * @param level Set to 1 for on, 0 for off
+ * @return Step duration in ms; 0 means hold the level indefinitely
+ */
+uint32_t led_pattern_step(led_mode_t mode, int progress, uint32_t index, int *level);
+
+#endif
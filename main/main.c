@@ -11,15 +11,31 @@
 #include "led_indicator.h"
 #include "wifi_manager.h"
 #include "ota_manager.h"
+#include "ota_arena.h"
 #include "recovery_mode.h"
+#include "health_check.h"
+#include "ota_agent.h"
+#include "boot_trace.h"
 
 static const char *TAG = "MAIN";
 
 #define BOOT_BUTTON_GPIO 4          // ← GANTI KE GPIO4
-#define VALIDATION_TIME_MS 10000
+
+// An AP that is down says nothing about the image: a search that ran and
+// found none of the saved networks passes as well
+static health_status_t check_wifi(void *arg)
+{
+    return wifi_is_connected() || wifi_upstream_absent() ? HEALTH_PASS : HEALTH_PENDING;
+}
+
+static health_status_t check_ota_server(void *arg)
+{
+    return ota_manager_is_running() ? HEALTH_PASS : HEALTH_PENDING;
+}
 
 void app_main(void)
 {
+    boot_trace_init();
     ESP_LOGI(TAG, "Firmware Assessment ESP32 Starting...");
     
     // Initialize NVS
@@ -29,9 +45,15 @@ void app_main(void)
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+    boot_trace_mark(BOOT_TRACE_NVS, 0);
 
     // Initialize LED
     led_init();
+    boot_trace_mark(BOOT_TRACE_LED, 0);
+
+    // Reserve update memory before Wi-Fi and the servers fragment the heap,
+    // recovery mode uploads through the same arena
+    ota_arena_init();
     
     // Check if BOOT button is pressed (Recovery Mode)
     gpio_config_t io_conf = {
@@ -45,6 +67,7 @@ void app_main(void)
     
     int boot_level = gpio_get_level(BOOT_BUTTON_GPIO);
     ESP_LOGI(TAG, "GPIO%d (Recovery Button) level: %d", BOOT_BUTTON_GPIO, boot_level);
+    boot_trace_mark(BOOT_TRACE_BUTTON, boot_level);
     
     if (boot_level == 0) {
         ESP_LOGI(TAG, "Recovery mode triggered!");
@@ -53,33 +76,33 @@ void app_main(void)
         return; // Stay in recovery
     }
 
-    // Normal boot - validate current partition
+    // Normal boot - a freshly updated image is validated while startup continues
     const esp_partition_t *running = esp_ota_get_running_partition();
-    esp_ota_img_states_t ota_state;
-    
-    if (esp_ota_get_state_partition(running, &ota_state) == ESP_OK) {
-        if (ota_state == ESP_OTA_IMG_PENDING_VERIFY) {
-            ESP_LOGI(TAG, "New firmware detected, validating...");
-            led_set_mode(LED_MODE_OTA);
-            
-            // Wait 10 seconds for stability check
-            vTaskDelay(pdMS_TO_TICKS(VALIDATION_TIME_MS));
-            
-            // Mark as valid
-            esp_ota_mark_app_valid_cancel_rollback();
-            ESP_LOGI(TAG, "Firmware validated successfully!");
-        }
-    }
+    health_check_register("wifi", check_wifi, NULL);
+    health_check_register("ota_server", check_ota_server, NULL);
+    health_check_register("heap", health_check_heap, (void *)HEALTH_CHECK_MIN_HEAP);
+    health_check_start(HEALTH_CHECK_DEADLINE_MS);
+    boot_trace_mark(BOOT_TRACE_HEALTH_START, health_check_pending());
 
     // Normal operation
-    led_set_mode(LED_MODE_NORMAL);
+    if (!health_check_pending()) {
+        led_set_mode(LED_MODE_NORMAL);
+    }
     ESP_LOGI(TAG, "Starting normal operation...");
     ESP_LOGI(TAG, "Running from partition: %s", running->label);
     
     // Initialize WiFi and start OTA server
     wifi_init();
+    boot_trace_mark(BOOT_TRACE_WIFI, wifi_is_connected());
     ota_manager_start();
+    boot_trace_mark(BOOT_TRACE_OTA_SERVER, 0);
+
+    // Pull updates from a manifest, if this build has one configured
+    if (OTA_AGENT_MANIFEST_URL[0] != '\0') {
+        ota_agent_start(OTA_AGENT_MANIFEST_URL);
+    }
     
+    boot_trace_mark(BOOT_TRACE_READY, 0);
     ESP_LOGI(TAG, "System ready. Access OTA portal at http://<ESP32_IP>");
     
     // Main loop
@@ -0,0 +1,234 @@
+#include "ota_agent.h"
+#include "ota_header.h"
+#include "ota_job.h"
+#include "wifi_manager.h"
+#include "health_check.h"
+#include "esp_app_desc.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+static const char *TAG = "OTA_AGENT";
+
+static TaskHandle_t agent_task = NULL;
+static char manifest_url[OTA_JOB_URL_MAX];
+
+// Last manifest accepted, reused while the server answers 304
+static char manifest_etag[80];
+static uint32_t manifest_version = 0;
+static char manifest_fw_url[OTA_JOB_URL_MAX];
+
+// Manifest whose image failed for good, skipped until the manifest changes
+static char rejected_etag[sizeof(manifest_etag)];
+static uint32_t rejected_version = 0;
+
+static esp_err_t ota_agent_http_event(esp_http_client_event_t *evt)
+{
+    if (evt->event_id == HTTP_EVENT_ON_HEADER && strcasecmp(evt->header_key, "ETag") == 0) {
+        char *etag = (char *)evt->user_data;
+        strncpy(etag, evt->header_value, sizeof(manifest_etag) - 1);
+        etag[sizeof(manifest_etag) - 1] = '\0';
+    }
+    return ESP_OK;
+}
+
+// Value of a top-level "key": "string" pair; the manifest is flat and ours
+static bool ota_agent_json_str(const char *json, const char *key, char *out, size_t out_len)
+{
+    char pattern[24];
+    snprintf(pattern, sizeof(pattern), "\"%s\"", key);
+    const char *p = strstr(json, pattern);
+    if (p == NULL) {
+        return false;
+    }
+    p += strlen(pattern);
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+    if (*p++ != ':') {
+        return false;
+    }
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+    if (*p++ != '"') {
+        return false;
+    }
+    const char *end = strchr(p, '"');
+    if (end == NULL || end - p >= out_len) {
+        return false;
+    }
+    memcpy(out, p, end - p);
+    out[end - p] = '\0';
+    return true;
+}
+
+// Refresh the cached manifest; a 304 leaves it as it is
+static esp_err_t ota_agent_fetch(void)
+{
+    char etag[sizeof(manifest_etag)] = {0};
+    esp_http_client_config_t config = {
+        .url = manifest_url,
+        .timeout_ms = 10000,
+        .event_handler = ota_agent_http_event,
+        .user_data = etag,
+    };
+
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (client == NULL) {
+        ESP_LOGE(TAG, "Failed to initialize HTTP client");
+        return ESP_FAIL;
+    }
+    if (manifest_etag[0] != '\0') {
+        esp_http_client_set_header(client, "If-None-Match", manifest_etag);
+    }
+
+    esp_err_t err = esp_http_client_open(client, 0);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Manifest server unreachable: %s", esp_err_to_name(err));
+        esp_http_client_cleanup(client);
+        return err;
+    }
+    esp_http_client_fetch_headers(client);
+    int status_code = esp_http_client_get_status_code(client);
+
+    if (status_code == 304) {
+        ESP_LOGD(TAG, "Manifest unchanged");
+    } else if (status_code == 200) {
+        char body[OTA_AGENT_MANIFEST_MAX];
+        int len = 0;
+        while (len < sizeof(body) - 1) {
+            int n = esp_http_client_read(client, body + len, sizeof(body) - 1 - len);
+            if (n <= 0) {
+                break;
+            }
+            len += n;
+        }
+        body[len] = '\0';
+
+        char version[32];
+        char url[OTA_JOB_URL_MAX];
+        if (ota_agent_json_str(body, "version", version, sizeof(version)) &&
+            ota_agent_json_str(body, "url", url, sizeof(url))) {
+            manifest_version = ota_header_version_from_string(version);
+            strcpy(manifest_fw_url, url);
+            strcpy(manifest_etag, etag);
+            ESP_LOGI(TAG, "Manifest: version %s at %s", version, url);
+        } else {
+            ESP_LOGE(TAG, "Manifest without version/url");
+            err = ESP_ERR_INVALID_RESPONSE;
+        }
+    } else {
+        ESP_LOGW(TAG, "Manifest request failed, HTTP %d", status_code);
+        err = ESP_ERR_INVALID_RESPONSE;
+    }
+
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+    return err;
+}
+
+// Failures that come from the image itself; a network error is worth retrying
+static bool ota_agent_is_rejection(esp_err_t err)
+{
+    return err == ESP_ERR_INVALID_VERSION || err == ESP_ERR_INVALID_CRC ||
+           err == ESP_ERR_INVALID_SIZE || err == ESP_ERR_OTA_VALIDATE_FAILED;
+}
+
+// The manifest's image failed verification last time, or it booted and was
+// rolled back; fetching it again would end the same way
+static bool ota_agent_rejected(void)
+{
+    ota_job_status_t st;
+    ota_job_get_status(&st);
+    if (st.phase == OTA_PHASE_FAILED && strcmp(st.url, manifest_fw_url) == 0 &&
+        ota_agent_is_rejection(st.last_error)) {
+        ESP_LOGW(TAG, "Version 0x%06lx rejected: %s", (unsigned long)manifest_version,
+                 esp_err_to_name(st.last_error));
+        return true;
+    }
+
+    const esp_partition_t *invalid = esp_ota_get_last_invalid_partition();
+    esp_app_desc_t desc;
+    if (invalid != NULL && esp_ota_get_partition_description(invalid, &desc) == ESP_OK &&
+        ota_header_version_from_string(desc.version) == manifest_version) {
+        ESP_LOGW(TAG, "Version 0x%06lx rolled back", (unsigned long)manifest_version);
+        return true;
+    }
+    return false;
+}
+
+static void ota_agent_poll(void)
+{
+    if (ota_agent_fetch() != ESP_OK || manifest_fw_url[0] == '\0') {
+        return;
+    }
+
+    uint32_t running = ota_header_version_from_string(esp_app_get_description()->version);
+    if (manifest_version <= running) {
+        return;
+    }
+    // A new ETag (or version) means the server published something else
+    if (manifest_version == rejected_version && strcmp(manifest_etag, rejected_etag) == 0) {
+        ESP_LOGD(TAG, "Skipping rejected version 0x%06lx", (unsigned long)manifest_version);
+        return;
+    }
+    if (ota_agent_rejected()) {
+        rejected_version = manifest_version;
+        strcpy(rejected_etag, manifest_etag);
+        return;
+    }
+
+    // Still offered after a failed download: queue it again, the job worker
+    // coalesces it if it is already running and the journal resumes it
+    ESP_LOGI(TAG, "Update available: 0x%06lx -> 0x%06lx",
+             (unsigned long)running, (unsigned long)manifest_version);
+    if (OTA_AGENT_BACKGROUND) {
+        ota_job_submit_background(manifest_fw_url, manifest_version);
+    } else {
+        ota_job_submit_versioned(manifest_fw_url, manifest_version);
+    }
+}
+
+// OTA_AGENT_INTERVAL_MS +/- OTA_AGENT_JITTER_PCT, uniformly
+static uint32_t ota_agent_next_delay_ms(void)
+{
+    uint32_t span = (uint64_t)OTA_AGENT_INTERVAL_MS * OTA_AGENT_JITTER_PCT / 100;
+    return OTA_AGENT_INTERVAL_MS - span + esp_random() % (2 * span + 1);
+}
+
+static void ota_agent_task(void *pvParameter)
+{
+    uint32_t delay_ms = esp_random() % (OTA_AGENT_INTERVAL_MS + 1);
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(delay_ms));
+        delay_ms = ota_agent_next_delay_ms();
+
+        // Updating while this image is on probation would lose the rollback
+        if (!wifi_is_connected() || health_check_pending()) {
+            continue;
+        }
+        ota_agent_poll();
+    }
+}
+
+esp_err_t ota_agent_start(const char *url)
+{
+    if (agent_task != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (url == NULL || url[0] == '\0' || strlen(url) >= sizeof(manifest_url)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    strcpy(manifest_url, url);
+
+    if (xTaskCreate(ota_agent_task, "ota_agent", 6144, NULL, 3, &agent_task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start update agent");
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Polling %s every ~%d s", manifest_url, OTA_AGENT_INTERVAL_MS / 1000);
+    return ESP_OK;
+}
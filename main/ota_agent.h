@@ -0,0 +1,41 @@
+#ifndef OTA_AGENT_H
+#define OTA_AGENT_H
+
+#include "esp_err.h"
+
+/**
+ * Pull-based updates: a background task fetches a small JSON manifest
+ *
+ *     {"version": "1.2.3", "url": "http://server/firmware.bin"}
+ *
+ * with If-None-Match, and queues the download on the OTA job worker only
+ * when the advertised version is newer than the running one. Between
+ * releases each poll costs one 304 response.
+ *
+ * A version whose image was rejected (failed verification, or booted and
+ * rolled back) is not queued again until the manifest's ETag or version
+ * changes. Network failures are retried on the next poll.
+ */
+
+#ifndef OTA_AGENT_MANIFEST_URL
+#define OTA_AGENT_MANIFEST_URL  ""      // Empty disables polling
+#endif
+#ifndef OTA_AGENT_INTERVAL_MS
+#define OTA_AGENT_INTERVAL_MS   (60 * 60 * 1000)
+#endif
+#ifndef OTA_AGENT_JITTER_PCT
+#define OTA_AGENT_JITTER_PCT    25      // Each interval is randomised by +/- this much
+#endif
+#ifndef OTA_AGENT_BACKGROUND
+#define OTA_AGENT_BACKGROUND    1       // Download throttled, activate in the maintenance window
+#endif
+#define OTA_AGENT_MANIFEST_MAX  512     // Manifest bytes read, the rest is ignored
+
+/**
+ * @brief Start polling manifest_url in the background
+ * The first poll happens after a random share of the interval, so a fleet
+ * that boots together does not poll together.
+ */
+esp_err_t ota_agent_start(const char *manifest_url);
+
+#endif
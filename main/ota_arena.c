@@ -0,0 +1,134 @@
+#include "ota_arena.h"
+#include "ota_manager.h"
+#include "ota_peer.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include <stdint.h>
+#include <string.h>
+
+static const char *TAG = "OTA_ARENA";
+
+#define ARENA_ALIGN 8
+#define ARENA_TOTAL (OTA_ARENA_SIZE + OTA_PEER_ARENA_SIZE)
+
+typedef struct {
+    uint8_t *base;
+    size_t size;
+    size_t used;
+} ota_pool_t;
+
+static portMUX_TYPE arena_lock = portMUX_INITIALIZER_UNLOCKED;
+static ota_pool_t bulk;
+static ota_pool_t dma;          // Only used with a PSRAM arena
+static size_t pinned;           // Head of bulk that resets keep
+static bool updated;            // An update has allocated since init
+static ota_arena_stats_t stats;
+
+esp_err_t ota_arena_init(void)
+{
+    if (bulk.base != NULL) {
+        return ESP_OK;
+    }
+
+#if OTA_ARENA_PSRAM
+    bulk.base = heap_caps_malloc(ARENA_TOTAL - OTA_ARENA_DMA_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (bulk.base != NULL) {
+        dma.base = heap_caps_malloc(OTA_ARENA_DMA_SIZE, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+        if (dma.base == NULL) {
+            heap_caps_free(bulk.base);
+            bulk.base = NULL;
+        } else {
+            bulk.size = ARENA_TOTAL - OTA_ARENA_DMA_SIZE;
+            dma.size = OTA_ARENA_DMA_SIZE;
+            stats.psram = true;
+        }
+    }
+#endif
+    if (bulk.base == NULL) {
+        bulk.base = heap_caps_malloc(ARENA_TOTAL, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+        bulk.size = ARENA_TOTAL;
+    }
+    if (bulk.base == NULL) {
+        ESP_LOGE(TAG, "Failed to reserve %u bytes", (unsigned)ARENA_TOTAL);
+        bulk.size = 0;
+        return ESP_ERR_NO_MEM;
+    }
+
+    stats.size = ARENA_TOTAL;
+    ESP_LOGI(TAG, "Reserved %u bytes%s", (unsigned)ARENA_TOTAL, stats.psram ? " (PSRAM)" : "");
+    return ESP_OK;
+}
+
+static void *ota_arena_take(ota_pool_t *pool, size_t size)
+{
+    size_t aligned = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    void *p = NULL;
+
+    taskENTER_CRITICAL(&arena_lock);
+    if (pool->size - pool->used >= aligned) {
+        p = pool->base + pool->used;
+        pool->used += aligned;
+        stats.used = bulk.used + dma.used;
+        if (stats.used > stats.high_water) {
+            stats.high_water = stats.used;
+        }
+    } else {
+        stats.failures++;
+    }
+    taskEXIT_CRITICAL(&arena_lock);
+
+    if (p == NULL) {
+        ESP_LOGE(TAG, "Budget exhausted: %u bytes requested, %u of %u in use",
+                 (unsigned)size, (unsigned)pool->used, (unsigned)pool->size);
+        return NULL;
+    }
+    memset(p, 0, size);
+    return p;
+}
+
+void *ota_arena_alloc(size_t size)
+{
+    updated = true;
+    return ota_arena_take(&bulk, size);
+}
+
+void *ota_arena_alloc_dma(size_t size)
+{
+    updated = true;
+    return ota_arena_take(dma.base ? &dma : &bulk, size);
+}
+
+void *ota_arena_alloc_pinned(size_t size)
+{
+    // Pinned blocks must sit below everything an update allocates
+    if (updated || stats.pinned + size > OTA_PEER_ARENA_SIZE) {
+        ESP_LOGE(TAG, "Cannot pin %u bytes (%u of %u pinned)", (unsigned)size,
+                 (unsigned)stats.pinned, (unsigned)OTA_PEER_ARENA_SIZE);
+        return NULL;
+    }
+    void *p = ota_arena_take(&bulk, size);
+    if (p != NULL) {
+        taskENTER_CRITICAL(&arena_lock);
+        pinned = bulk.used;
+        stats.pinned = pinned;
+        taskEXIT_CRITICAL(&arena_lock);
+    }
+    return p;
+}
+
+void ota_arena_reset(void)
+{
+    taskENTER_CRITICAL(&arena_lock);
+    bulk.used = pinned;
+    dma.used = 0;
+    stats.used = pinned;
+    taskEXIT_CRITICAL(&arena_lock);
+}
+
+void ota_arena_get_stats(ota_arena_stats_t *out)
+{
+    taskENTER_CRITICAL(&arena_lock);
+    *out = stats;
+    taskEXIT_CRITICAL(&arena_lock);
+}
@@ -0,0 +1,63 @@
+#ifndef OTA_ARENA_H
+#define OTA_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/**
+ * Memory for the update pipeline. OTA_ARENA_SIZE bytes are reserved once at
+ * startup, before the heap has had time to fragment; every buffer of an update
+ * (ring slots, flash sector buffers, decoder state, segment buffers) is carved
+ * from it with a bump allocator, and the whole arena is recycled when the next
+ * update claims the slot. Nothing is freed individually, and a budget that is
+ * too small fails the update at setup, before anything is erased.
+ *
+ * With OTA_ARENA_PSRAM the bulk lives in PSRAM and only OTA_ARENA_DMA_SIZE
+ * stays in internal RAM for the flash sector buffers.
+ *
+ * Buffers that outlive a single update (peer serving) are pinned on top of
+ * the update budget: taken once before the first update and kept by resets.
+ */
+
+#define OTA_ARENA_DMA_SIZE   (2 * 4096 + 64)    // Sector + readback buffer
+
+typedef struct {
+    size_t size;                // Bytes reserved
+    size_t used;                // Bytes handed out in the current update, pinned included
+    size_t pinned;              // Bytes kept across updates
+    size_t high_water;          // Most ever used by one update
+    unsigned failures;          // Allocations refused for lack of budget
+    bool psram;                 // Bulk part lives in PSRAM
+} ota_arena_stats_t;
+
+/**
+ * @brief Reserve the arena, safe to call more than once
+ * Called from app_main before Wi-Fi starts, while the heap is still unfragmented.
+ */
+esp_err_t ota_arena_init(void);
+
+/**
+ * @brief Zeroed block from the arena, NULL when the budget is exhausted
+ */
+void *ota_arena_alloc(size_t size);
+
+/**
+ * @brief Like ota_arena_alloc(), but DMA-capable internal RAM
+ */
+void *ota_arena_alloc_dma(size_t size);
+
+/**
+ * @brief Block that survives ota_arena_reset(), from the pinned budget
+ * Only before the first update has allocated anything, NULL afterwards.
+ */
+void *ota_arena_alloc_pinned(size_t size);
+
+/**
+ * @brief Recycle everything, only while no update is running
+ */
+void ota_arena_reset(void);
+
+void ota_arena_get_stats(ota_arena_stats_t *stats);
+
+#endif
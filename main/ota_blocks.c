@@ -0,0 +1,139 @@
+#include "ota_blocks.h"
+#include "ota_arena.h"
+#include "esp_log.h"
+#include "mbedtls/sha256.h"
+#include <string.h>
+
+static const char *TAG = "OTA_BLOCKS";
+
+struct ota_blocks {
+    ota_blocks_ext_t ext;
+    uint32_t payload_size;
+    uint8_t *table;             // block_count digests
+    uint8_t *buf;               // Block being assembled
+    uint32_t index;             // Block being assembled
+    uint32_t fill;              // Bytes of it in buf
+    ota_blocks_out_cb_t out_cb;
+    void *arg;
+};
+
+static uint32_t ota_blocks_len(const ota_blocks_t *blocks, uint32_t index)
+{
+    uint32_t start = index * blocks->ext.block_size;
+    uint32_t left = blocks->payload_size - start;
+    return left < blocks->ext.block_size ? left : blocks->ext.block_size;
+}
+
+ota_blocks_t *ota_blocks_create(const ota_blocks_ext_t *ext, uint32_t payload_size,
+                                ota_blocks_out_cb_t out_cb, void *arg)
+{
+    if (ext->block_size == 0 || ext->block_size % 4096 != 0 || ext->block_size > OTA_BLOCK_MAX_SIZE) {
+        ESP_LOGE(TAG, "Unsupported block size %lu", ext->block_size);
+        return NULL;
+    }
+    uint32_t count = (payload_size + ext->block_size - 1) / ext->block_size;
+    if (ext->block_count != count || count > OTA_BLOCK_MAX_COUNT) {
+        ESP_LOGE(TAG, "Block table has %lu entries, payload needs %lu",
+                 ext->block_count, (unsigned long)count);
+        return NULL;
+    }
+
+    ota_blocks_t *blocks = ota_arena_alloc(sizeof(*blocks));
+    if (blocks == NULL) {
+        return NULL;
+    }
+    blocks->table = ota_arena_alloc(count * OTA_BLOCK_DIGEST_SIZE);
+    blocks->buf = ota_arena_alloc(ext->block_size);
+    if (blocks->table == NULL || blocks->buf == NULL) {
+        return NULL;
+    }
+    blocks->ext = *ext;
+    blocks->payload_size = payload_size;
+    blocks->index = 0;
+    blocks->fill = 0;
+    blocks->out_cb = out_cb;
+    blocks->arg = arg;
+    return blocks;
+}
+
+uint8_t *ota_blocks_table(ota_blocks_t *blocks, size_t *len)
+{
+    *len = blocks->ext.block_count * OTA_BLOCK_DIGEST_SIZE;
+    return blocks->table;
+}
+
+esp_err_t ota_blocks_check_table(const ota_blocks_t *blocks)
+{
+    uint8_t digest[32];
+    mbedtls_sha256(blocks->table, blocks->ext.block_count * OTA_BLOCK_DIGEST_SIZE, digest, 0);
+    if (memcmp(digest, blocks->ext.table_sha256, sizeof(digest)) != 0) {
+        ESP_LOGE(TAG, "Block table digest mismatch");
+        return ESP_ERR_INVALID_CRC;
+    }
+    return ESP_OK;
+}
+
+esp_err_t ota_blocks_feed(ota_blocks_t *blocks, const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        if (blocks->index >= blocks->ext.block_count) {
+            ESP_LOGE(TAG, "Data past the last block");
+            return ESP_ERR_INVALID_SIZE;
+        }
+        uint32_t block_len = ota_blocks_len(blocks, blocks->index);
+        size_t n = block_len - blocks->fill;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(blocks->buf + blocks->fill, data, n);
+        blocks->fill += n;
+        data += n;
+        len -= n;
+
+        if (blocks->fill < block_len) {
+            break;
+        }
+
+        uint8_t digest[32];
+        mbedtls_sha256(blocks->buf, block_len, digest, 0);
+        if (memcmp(digest, blocks->table + blocks->index * OTA_BLOCK_DIGEST_SIZE, sizeof(digest)) != 0) {
+            // Kept buffered until the caller rewinds or gives up
+            ESP_LOGW(TAG, "Block %lu/%lu corrupt", (unsigned long)blocks->index,
+                     blocks->ext.block_count);
+            return ESP_ERR_INVALID_CRC;
+        }
+        esp_err_t err = blocks->out_cb(blocks->buf, block_len, blocks->arg);
+        if (err != ESP_OK) {
+            return err;
+        }
+        blocks->index++;
+        blocks->fill = 0;
+    }
+    return ESP_OK;
+}
+
+uint32_t ota_blocks_rewind(ota_blocks_t *blocks)
+{
+    blocks->fill = 0;
+    return blocks->index * blocks->ext.block_size;
+}
+
+esp_err_t ota_blocks_seek(ota_blocks_t *blocks, uint32_t payload_offset)
+{
+    if (payload_offset % blocks->ext.block_size != 0 || payload_offset > blocks->payload_size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    blocks->index = payload_offset / blocks->ext.block_size;
+    blocks->fill = 0;
+    return ESP_OK;
+}
+
+uint32_t ota_blocks_size(const ota_blocks_t *blocks)
+{
+    return blocks->ext.block_size;
+}
+
+bool ota_blocks_done(const ota_blocks_t *blocks)
+{
+    return blocks->index == blocks->ext.block_count && blocks->fill == 0;
+}
@@ -0,0 +1,81 @@
+#ifndef OTA_BLOCKS_H
+#define OTA_BLOCKS_H
+
+#include "esp_err.h"
+#include "ota_header.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef OTA_BLOCK_MAX_SIZE
+#define OTA_BLOCK_MAX_SIZE   (16 * 1024)    // Largest block accepted, one is buffered in RAM
+#endif
+#ifndef OTA_BLOCK_MAX_COUNT
+#define OTA_BLOCK_MAX_COUNT  1024           // Digest table entries, 32 bytes each
+#endif
+#ifndef OTA_BLOCK_RETRIES
+#define OTA_BLOCK_RETRIES    2              // Re-requests of one corrupt block before giving up
+#endif
+
+/**
+ * Per-block verification for containers with OTA_HEADER_FLAG_BLOCKS. Sits
+ * between the network and the payload decoder: bytes are buffered until a
+ * block is complete, hashed, and only passed on when the digest matches the
+ * table. A corrupt block is caught as soon as it arrives instead of by the
+ * whole-image hash at the end, and nothing from it reaches flash.
+ */
+typedef struct ota_blocks ota_blocks_t;
+
+/**
+ * @brief Receives verified payload bytes; a non-ESP_OK return stops verification
+ */
+typedef esp_err_t (*ota_blocks_out_cb_t)(const uint8_t *data, size_t len, void *arg);
+
+/**
+ * @brief Check the extension against payload_size and allocate the table and block buffer
+ * @return NULL if the geometry is invalid or allocation fails
+ */
+ota_blocks_t *ota_blocks_create(const ota_blocks_ext_t *ext, uint32_t payload_size,
+                                ota_blocks_out_cb_t out_cb, void *arg);
+
+/**
+ * @brief Where the digest table read from the container goes
+ * @param len Set to the table size in bytes
+ */
+uint8_t *ota_blocks_table(ota_blocks_t *blocks, size_t *len);
+
+/**
+ * @brief Verify the filled-in table against the extension's table_sha256
+ * @return ESP_ERR_INVALID_CRC on mismatch
+ */
+esp_err_t ota_blocks_check_table(const ota_blocks_t *blocks);
+
+/**
+ * @brief Verify the next piece of the payload
+ * @return ESP_ERR_INVALID_CRC when a block fails its digest (it is not
+ *         passed on), or the callback's error
+ */
+esp_err_t ota_blocks_feed(ota_blocks_t *blocks, const uint8_t *data, size_t len);
+
+/**
+ * @brief Drop the partially buffered block, to re-fetch it from the start
+ * @return Payload offset of the block to fetch again
+ */
+uint32_t ota_blocks_rewind(ota_blocks_t *blocks);
+
+/**
+ * @brief Continue at payload_offset, which must be on a block boundary
+ */
+esp_err_t ota_blocks_seek(ota_blocks_t *blocks, uint32_t payload_offset);
+
+/**
+ * @brief Block size from the extension
+ */
+uint32_t ota_blocks_size(const ota_blocks_t *blocks);
+
+/**
+ * @brief True once every block has been verified and passed on
+ */
+bool ota_blocks_done(const ota_blocks_t *blocks);
+
+#endif
@@ -0,0 +1,183 @@
+#include "ota_delta.h"
+#include "ota_arena.h"
+#include "esp_log.h"
+#include "mbedtls/sha256.h"
+#include <string.h>
+
+static const char *TAG = "OTA_DELTA";
+
+#define DELTA_READ_CHUNK  1024      // Base partition read granularity
+
+typedef enum {
+    DELTA_STATE_OP,         // Collecting an op header
+    DELTA_STATE_ADD,        // Passing literal bytes through
+} delta_state_t;
+
+struct ota_delta {
+    const esp_partition_t *base;
+    uint32_t base_size;
+    ota_delta_out_cb_t out_cb;
+    void *arg;
+    delta_state_t state;
+    uint8_t op[9];          // Op byte + up to two u32 arguments
+    size_t op_len;
+    uint32_t add_remaining;
+    uint8_t chunk[DELTA_READ_CHUNK];
+};
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static size_t op_size(uint8_t op)
+{
+    switch (op) {
+        case OTA_DELTA_OP_COPY: return 9;
+        case OTA_DELTA_OP_ADD:  return 5;
+        default:                return 0;
+    }
+}
+
+esp_err_t ota_delta_check_base(const esp_partition_t *base, uint32_t base_size,
+                               const uint8_t base_sha256[32])
+{
+    if (base_size > base->size) {
+        ESP_LOGE(TAG, "Base image (%lu bytes) larger than partition %s",
+                 base_size, base->label);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint8_t *buf = ota_arena_alloc(DELTA_READ_CHUNK);
+    if (buf == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+
+    esp_err_t err = ESP_OK;
+    for (uint32_t offset = 0; offset < base_size; offset += DELTA_READ_CHUNK) {
+        size_t n = base_size - offset < DELTA_READ_CHUNK ? base_size - offset : DELTA_READ_CHUNK;
+        err = esp_partition_read(base, offset, buf, n);
+        if (err != ESP_OK) {
+            break;
+        }
+        mbedtls_sha256_update(&sha, buf, n);
+    }
+
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to read base image: %s", esp_err_to_name(err));
+        return err;
+    }
+    if (memcmp(digest, base_sha256, sizeof(digest)) != 0) {
+        ESP_LOGE(TAG, "Patch base does not match running image on %s", base->label);
+        return ESP_ERR_INVALID_STATE;
+    }
+    return ESP_OK;
+}
+
+ota_delta_t *ota_delta_create(const esp_partition_t *base, uint32_t base_size,
+                              ota_delta_out_cb_t out_cb, void *arg)
+{
+    ota_delta_t *delta = ota_arena_alloc(sizeof(*delta));
+    if (delta == NULL) {
+        return NULL;
+    }
+    delta->base = base;
+    delta->base_size = base_size;
+    delta->out_cb = out_cb;
+    delta->arg = arg;
+    delta->state = DELTA_STATE_OP;
+    return delta;
+}
+
+void ota_delta_delete(ota_delta_t *delta)
+{
+    // State goes back with the arena
+}
+
+static esp_err_t delta_copy(ota_delta_t *delta, uint32_t src, uint32_t len)
+{
+    if (src > delta->base_size || len > delta->base_size - src) {
+        ESP_LOGE(TAG, "COPY out of range: %lu+%lu > %lu", src, len, delta->base_size);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    while (len > 0) {
+        size_t n = len < DELTA_READ_CHUNK ? len : DELTA_READ_CHUNK;
+        esp_err_t err = esp_partition_read(delta->base, src, delta->chunk, n);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Base read failed: %s", esp_err_to_name(err));
+            return err;
+        }
+        err = delta->out_cb(delta->chunk, n, delta->arg);
+        if (err != ESP_OK) {
+            return err;
+        }
+        src += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+esp_err_t ota_delta_feed(ota_delta_t *delta, const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        if (delta->state == DELTA_STATE_ADD) {
+            size_t n = len < delta->add_remaining ? len : delta->add_remaining;
+            esp_err_t err = delta->out_cb(data, n, delta->arg);
+            if (err != ESP_OK) {
+                return err;
+            }
+            data += n;
+            len -= n;
+            delta->add_remaining -= n;
+            if (delta->add_remaining == 0) {
+                delta->state = DELTA_STATE_OP;
+            }
+            continue;
+        }
+
+        // Op headers may straddle feed() calls, collect them byte by byte
+        delta->op[delta->op_len++] = *data++;
+        len--;
+
+        size_t need = op_size(delta->op[0]);
+        if (need == 0) {
+            ESP_LOGE(TAG, "Unknown patch op 0x%02x", delta->op[0]);
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        if (delta->op_len < need) {
+            continue;
+        }
+        delta->op_len = 0;
+
+        if (delta->op[0] == OTA_DELTA_OP_COPY) {
+            esp_err_t err = delta_copy(delta, get_le32(&delta->op[1]), get_le32(&delta->op[5]));
+            if (err != ESP_OK) {
+                return err;
+            }
+        } else {
+            delta->add_remaining = get_le32(&delta->op[1]);
+            if (delta->add_remaining > 0) {
+                delta->state = DELTA_STATE_ADD;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t ota_delta_finish(const ota_delta_t *delta)
+{
+    if (delta->state != DELTA_STATE_OP || delta->op_len != 0) {
+        ESP_LOGE(TAG, "Patch stream ended inside an op");
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
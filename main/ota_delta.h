@@ -0,0 +1,57 @@
+#ifndef OTA_DELTA_H
+#define OTA_DELTA_H
+
+#include "esp_err.h"
+#include "esp_partition.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Streaming applier for patches produced by tools/make-delta.py.
+ *
+ * Patch stream (little endian), repeated until the new image is complete:
+ *   0x01 COPY  u32 src_offset, u32 len   - len bytes from the base partition
+ *   0x02 ADD   u32 len, len bytes         - literal bytes from the patch
+ */
+#define OTA_DELTA_OP_COPY    0x01
+#define OTA_DELTA_OP_ADD     0x02
+
+typedef struct ota_delta ota_delta_t;
+
+/**
+ * @brief Receives reconstructed image bytes; a non-ESP_OK return stops patching
+ */
+typedef esp_err_t (*ota_delta_out_cb_t)(const uint8_t *data, size_t len, void *arg);
+
+/**
+ * @brief Hash the first base_size bytes of base and compare to base_sha256
+ * Run before erasing anything so a patch for another image is rejected early.
+ * @return ESP_ERR_INVALID_STATE if the running image is not the patch base
+ */
+esp_err_t ota_delta_check_base(const esp_partition_t *base, uint32_t base_size,
+                               const uint8_t base_sha256[32]);
+
+/**
+ * @brief Create an applier reading COPY sources from base
+ * @return NULL on allocation failure
+ */
+ota_delta_t *ota_delta_create(const esp_partition_t *base, uint32_t base_size,
+                              ota_delta_out_cb_t out_cb, void *arg);
+
+/**
+ * @brief Free applier state
+ */
+void ota_delta_delete(ota_delta_t *delta);
+
+/**
+ * @brief Apply the next piece of the patch stream
+ * @return ESP_ERR_INVALID_RESPONSE on malformed ops, or the callback's error
+ */
+esp_err_t ota_delta_feed(ota_delta_t *delta, const uint8_t *data, size_t len);
+
+/**
+ * @brief Check the stream did not end in the middle of an op
+ */
+esp_err_t ota_delta_finish(const ota_delta_t *delta);
+
+#endif
@@ -0,0 +1,678 @@
+#include "ota_engine.h"
+#include "esp_ota_ops.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "led_indicator.h"
+#include "ota_ring.h"
+#include "ota_header.h"
+#include "ota_inflate.h"
+#include "ota_delta.h"
+#include "ota_blocks.h"
+#include "ota_image.h"
+#include "ota_throttle.h"
+#include "ota_journal.h"
+#include "ota_segfetch.h"
+#include "ota_flash.h"
+#include "ota_arena.h"
+#include "esp_timer.h"
+#include "mbedtls/sha256.h"
+#include <string.h>
+
+static const char *TAG = "OTA_ENGINE";
+
+#define OTA_RX_BUF_SIZE 1024    // Network read granularity
+#define OTA_MAX_RESUMES 5       // Range reconnects per update after a dropped connection
+#ifndef OTA_RESUME_DELAY_MS
+#define OTA_RESUME_DELAY_MS 1000    // Backoff step between reconnects
+#endif
+
+typedef struct {
+    ota_ring_t *ring;
+    ota_sink_t sink;            // Usually the OTA partition (ota_flash)
+    int fw_size;                // Expected firmware bytes (for progress)
+    int written;                // Bytes accepted by the sink
+    volatile esp_err_t err;     // First write error, polled by the network task
+    SemaphoreHandle_t done;     // Given when the writer has drained the ring
+    ota_journal_t *journal;     // Checkpointed every OTA_JOURNAL_INTERVAL, NULL if not resumable
+} ota_writer_ctx_t;
+
+// Flash stage of the pipeline: drains ring slots into the OTA partition
+static void ota_writer_task(void *pvParameter)
+{
+    ota_writer_ctx_t *ctx = (ota_writer_ctx_t *)pvParameter;
+    int last_progress = 0;
+
+    while (1) {
+        size_t len;
+        const uint8_t *data = ota_ring_peek(ctx->ring, &len);
+        if (len == 0) {
+            ota_ring_release(ctx->ring);
+            break;
+        }
+
+        // After a failure keep draining so the network task never blocks
+        if (ctx->err == ESP_OK) {
+            esp_err_t err = ctx->sink.write(ctx->sink.ctx, data, len);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "OTA write failed: %s", esp_err_to_name(err));
+                ctx->err = err;
+            } else {
+                ctx->written += len;
+                if (ctx->journal && ctx->written - ctx->journal->written >= OTA_JOURNAL_INTERVAL) {
+                    ctx->journal->written = ctx->written & ~(SPI_FLASH_SEC_SIZE - 1);
+                    ota_journal_save(ctx->journal);
+                }
+                int progress = ctx->fw_size > 0 ? ((int64_t)ctx->written * 100) / ctx->fw_size : 0;
+                led_set_progress(progress);
+                if (progress >= last_progress + 10) {
+                    ESP_LOGI(TAG, "Progress: %d%% (%d / %d bytes)",
+                             progress, ctx->written, ctx->fw_size);
+                    last_progress = progress;
+                }
+            }
+        }
+        ota_ring_release(ctx->ring);
+    }
+
+    xSemaphoreGive(ctx->done);
+    vTaskDelete(NULL);
+}
+
+// Producer side of the ring: packs decoded firmware bytes into whole slots
+typedef struct {
+    ota_ring_t *ring;
+    ota_writer_ctx_t *writer;
+    uint8_t *slot;              // Slot currently being filled
+    size_t fill;
+    int produced;               // Firmware bytes pushed so far
+    int limit;                  // Declared firmware size
+    bool check_image;           // Check the app header once it is in the first slot
+    uint32_t min_version;       // For the app header check
+    mbedtls_sha256_context sha;
+} ota_stream_t;
+
+static esp_err_t ota_stream_push(const uint8_t *data, size_t len, void *arg)
+{
+    ota_stream_t *stream = (ota_stream_t *)arg;
+    const size_t slot_size = ota_ring_slot_size(stream->ring);
+
+    if (stream->writer->err != ESP_OK) {
+        return stream->writer->err;
+    }
+    if (stream->produced + (int)len > stream->limit) {
+        ESP_LOGE(TAG, "Firmware exceeds declared size of %d bytes", stream->limit);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    mbedtls_sha256_update(&stream->sha, data, len);
+    stream->produced += len;
+
+    while (len > 0) {
+        size_t n = slot_size - stream->fill;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(stream->slot + stream->fill, data, n);
+        stream->fill += n;
+        data += n;
+        len -= n;
+
+        // Still the first slot: nothing has been erased or written yet
+        if (stream->check_image && stream->fill >= OTA_IMAGE_CHECK_SIZE) {
+            stream->check_image = false;
+            esp_err_t err = ota_image_check(stream->slot, stream->min_version);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+
+        if (stream->fill == slot_size) {
+            ota_ring_commit(stream->ring, stream->fill);
+            stream->slot = ota_ring_acquire(stream->ring);
+            stream->fill = 0;
+        }
+    }
+    return ESP_OK;
+}
+
+static void ota_stream_flush(ota_stream_t *stream)
+{
+    if (stream->fill > 0) {
+        ota_ring_commit(stream->ring, stream->fill);
+        stream->slot = ota_ring_acquire(stream->ring);
+        stream->fill = 0;
+    }
+}
+
+// Fold already-flashed bytes into the running hash after a resume
+static esp_err_t ota_rehash_partition(const esp_partition_t *partition, size_t len,
+                                      mbedtls_sha256_context *sha, char *buf)
+{
+    for (size_t offset = 0; offset < len; offset += OTA_RX_BUF_SIZE) {
+        size_t n = len - offset < OTA_RX_BUF_SIZE ? len - offset : OTA_RX_BUF_SIZE;
+        esp_err_t err = esp_partition_read(partition, offset, buf, n);
+        if (err != ESP_OK) {
+            return err;
+        }
+        mbedtls_sha256_update(sha, (const uint8_t *)buf, n);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t ota_delta_feed_cb(const uint8_t *data, size_t len, void *arg)
+{
+    return ota_delta_feed((ota_delta_t *)arg, data, len);
+}
+
+// Payload decoding chain: [block check] -> [inflate] -> [delta patch] -> stream
+typedef struct {
+    ota_blocks_t *blocks;           // Verifies each payload block before decoding
+    ota_inflate_t *inflate;         // First decoding stage when the payload is compressed
+    ota_inflate_out_cb_t out_cb;    // Receives payload (or inflated) bytes
+    void *out_arg;
+} ota_decoder_t;
+
+static esp_err_t ota_decode_payload(const uint8_t *data, size_t len, void *arg)
+{
+    ota_decoder_t *dec = (ota_decoder_t *)arg;
+    if (dec->inflate) {
+        return ota_inflate_feed(dec->inflate, data, len);
+    }
+    return dec->out_cb(data, len, dec->out_arg);
+}
+
+static esp_err_t ota_decode(ota_decoder_t *dec, const uint8_t *data, size_t len)
+{
+    if (dec->blocks) {
+        return ota_blocks_feed(dec->blocks, data, len);
+    }
+    return ota_decode_payload(data, len, dec);
+}
+
+// Re-requests spent on one block, the budget starts over at the next one
+typedef struct {
+    uint32_t offset;            // Payload offset of the block being retried
+    int count;
+} ota_block_retry_t;
+
+// A corrupt block is requested again from its first byte; the rest of the
+// old response is dropped with its connection
+static bool ota_refetch_block(ota_transport_t *transport, ota_decoder_t *dec, int payload_start,
+                              int content_length, int *received, ota_block_retry_t *retry)
+{
+    if (dec->blocks == NULL || transport->url == NULL) {
+        return false;
+    }
+    uint32_t offset = ota_blocks_rewind(dec->blocks);
+    if (offset != retry->offset) {
+        retry->offset = offset;
+        retry->count = 0;
+    }
+    if (retry->count >= OTA_BLOCK_RETRIES) {
+        return false;
+    }
+    retry->count++;
+    *received = payload_start + offset;
+    ESP_LOGW(TAG, "Re-requesting block at %d (%d/%d)", *received, retry->count, OTA_BLOCK_RETRIES);
+    return ota_transport_resume(transport, *received, content_length) == ESP_OK;
+}
+
+static void ota_throttle_wait(ota_throttle_t *throttle, size_t len)
+{
+    // Sub-tick waits round to a yield, the debt carries into the next one
+    int64_t wait_us = ota_throttle_take(throttle, len, esp_timer_get_time());
+    if (wait_us > 0) {
+        vTaskDelay(pdMS_TO_TICKS(wait_us / 1000));
+    }
+}
+
+void ota_engine_report(const ota_update_config_t *config, ota_phase_t phase, int done, int total)
+{
+    if (config->progress) {
+        config->progress(phase, done, total, config->progress_arg);
+    }
+}
+
+bool ota_engine_cancelled(const ota_update_config_t *config)
+{
+    return config->cancel && *config->cancel;
+}
+
+esp_err_t ota_engine_run(ota_transport_t *transport, const ota_update_config_t *ota_config,
+                         const esp_partition_t *update_partition)
+{
+    const char *url = transport->url;  // NULL for sources that cannot be re-fetched
+    esp_err_t err;
+    ota_flash_t *flash = NULL;
+
+    // Everything below is released at cleanup
+    ota_ring_t *ring = NULL;
+    SemaphoreHandle_t writer_done = NULL;
+    char *buffer = NULL;
+    ota_inflate_t *inflate = NULL;
+    ota_delta_t *delta = NULL;
+    ota_segfetch_t *segfetch = NULL;
+    ota_blocks_t *blocks = NULL;
+    bool network_error = false;     // Keep the journal, the next attempt resumes
+    int resume_offset = 0;
+    ota_stream_t stream = {0};
+    ota_writer_ctx_t writer = {0};
+    ota_journal_t journal = {0};
+    ota_decoder_t decoder = {0};
+    ota_throttle_t throttle;
+    mbedtls_sha256_init(&stream.sha);
+
+    ota_engine_report(ota_config, OTA_PHASE_CONNECTING, 0, 0);
+
+    int content_length;
+    err = ota_transport_open(transport, 0, &content_length);
+    if (err != ESP_OK) {
+        goto cleanup;
+    }
+
+    // Read first bytes to check for custom header
+    uint8_t header[OTA_HEADER_SIZE];
+    int first_read = ota_transport_read_full(transport, (char *)header, OTA_HEADER_SIZE);
+    if (first_read < OTA_HEADER_SIZE) {
+        ESP_LOGE(TAG, "Failed to read header");
+        err = ESP_FAIL;
+        goto cleanup;
+    }
+
+    // Check for custom header magic (0xDEADBEEF)
+    ota_header_t fw_header;
+    bool has_custom_header = ota_header_parse(header, &fw_header);
+    bool compressed = false;
+    bool is_delta = false;
+    ota_delta_ext_t delta_ext;
+    ota_blocks_ext_t blocks_ext;
+    
+    int received = first_read;             // Bytes pulled from the server so far
+    int actual_fw_size = content_length;   // Bytes that end up in flash
+    
+    if (has_custom_header) {
+        ESP_LOGI(TAG, "Custom header detected (magic: 0x%08lx)", fw_header.magic);
+        actual_fw_size = fw_header.size;
+        compressed = OTA_HEADER_FLAGS(&fw_header) & OTA_HEADER_FLAG_DEFLATE;
+        is_delta = OTA_HEADER_FLAGS(&fw_header) & OTA_HEADER_FLAG_DELTA;
+        ESP_LOGI(TAG, "Header - Version: 0x%06lx, Size: %lu, Flags: 0x%02x",
+                 OTA_HEADER_VERSION(&fw_header), fw_header.size, OTA_HEADER_FLAGS(&fw_header));
+
+        if (is_delta) {
+            if (ota_transport_read_full(transport, (char *)&delta_ext, OTA_DELTA_EXT_SIZE) != OTA_DELTA_EXT_SIZE) {
+                ESP_LOGE(TAG, "Failed to read delta header");
+                err = ESP_FAIL;
+                goto cleanup;
+            }
+            received += OTA_DELTA_EXT_SIZE;
+        }
+
+        if (OTA_HEADER_FLAGS(&fw_header) & OTA_HEADER_FLAG_BLOCKS) {
+            if (ota_transport_read_full(transport, (char *)&blocks_ext, OTA_BLOCKS_EXT_SIZE) != OTA_BLOCKS_EXT_SIZE) {
+                ESP_LOGE(TAG, "Failed to read block header");
+                err = ESP_FAIL;
+                goto cleanup;
+            }
+            received += OTA_BLOCKS_EXT_SIZE;
+
+            int64_t payload_size = (int64_t)content_length - received -
+                                   (int64_t)blocks_ext.block_count * OTA_BLOCK_DIGEST_SIZE;
+            if (payload_size >= 0) {
+                blocks = ota_blocks_create(&blocks_ext, payload_size, ota_decode_payload, &decoder);
+            }
+            if (blocks == NULL) {
+                ESP_LOGE(TAG, "Invalid block table (%lu x %lu bytes)",
+                         blocks_ext.block_count, blocks_ext.block_size);
+                err = ESP_ERR_INVALID_SIZE;
+                goto cleanup;
+            }
+
+            size_t table_len;
+            uint8_t *table = ota_blocks_table(blocks, &table_len);
+            if (ota_transport_read_full(transport, (char *)table, table_len) != (int)table_len) {
+                ESP_LOGE(TAG, "Failed to read block table");
+                err = ESP_FAIL;
+                goto cleanup;
+            }
+            received += table_len;
+            err = ota_blocks_check_table(blocks);
+            if (err != ESP_OK) {
+                goto cleanup;
+            }
+            ESP_LOGI(TAG, "Verifying %lu blocks of %lu bytes", blocks_ext.block_count, blocks_ext.block_size);
+        }
+
+        // Reject before anything is erased
+        if (OTA_HEADER_VERSION(&fw_header) < ota_config->min_version) {
+            ESP_LOGE(TAG, "Image version 0x%06lx older than expected 0x%06lx",
+                     OTA_HEADER_VERSION(&fw_header), ota_config->min_version);
+            err = ESP_ERR_INVALID_VERSION;
+            goto cleanup;
+        }
+
+        bool size_ok = (compressed || is_delta) ? fw_header.size <= update_partition->size
+                                                : fw_header.size == (uint32_t)(content_length - received);
+        if (!size_ok) {
+            ESP_LOGE(TAG, "Size mismatch: header %lu, payload %d bytes",
+                     fw_header.size, content_length - received);
+            err = ESP_ERR_INVALID_SIZE;
+            goto cleanup;
+        }
+
+        if (is_delta) {
+            ESP_LOGI(TAG, "Delta update against %lu-byte base image", delta_ext.base_size);
+            err = ota_delta_check_base(esp_ota_get_running_partition(),
+                                       delta_ext.base_size, delta_ext.base_sha256);
+            if (err != ESP_OK) {
+                goto cleanup;
+            }
+        }
+    } else {
+        ESP_LOGI(TAG, "Raw firmware detected (magic: 0x%02x)", header[0]);
+    }
+
+    // Plain images map stream offsets 1:1 onto flash offsets, so they can
+    // continue across reboots. Compressed/delta decoder state lives in RAM only.
+    bool resumable = !compressed && !is_delta && url != NULL;
+    int payload_start = has_custom_header ? received : 0;
+
+    if (has_custom_header) {
+        memcpy(journal.image_id, fw_header.sha256, sizeof(journal.image_id));
+    } else if (url) {
+        mbedtls_sha256((const unsigned char *)url, strlen(url), journal.image_id, 0);
+    }
+    journal.stream_size = content_length;
+    if (url) {
+        strncpy(journal.url, url, sizeof(journal.url) - 1);
+    }
+    journal.partition_addr = update_partition->address;
+
+    ota_journal_t saved;
+    if (ota_journal_load(&saved) == ESP_OK) {
+        if (resumable && saved.stream_size == journal.stream_size &&
+            saved.partition_addr == journal.partition_addr &&
+            memcmp(saved.image_id, journal.image_id, sizeof(saved.image_id)) == 0 &&
+            saved.written > 0 && saved.written < (uint32_t)actual_fw_size) {
+            // Block checks restart on a block boundary
+            resume_offset = saved.written;
+            if (blocks) {
+                resume_offset -= resume_offset % ota_blocks_size(blocks);
+            }
+        } else {
+            ota_journal_clear();
+        }
+    }
+
+    ring = ota_ring_create(OTA_RING_SLOT_SIZE, OTA_RING_SLOT_COUNT);
+    writer_done = xSemaphoreCreateBinary();
+    buffer = ota_arena_alloc(OTA_RX_BUF_SIZE);
+
+    decoder.blocks = blocks;
+    decoder.out_cb = ota_stream_push;
+    decoder.out_arg = &stream;
+    if (is_delta) {
+        delta = ota_delta_create(esp_ota_get_running_partition(), delta_ext.base_size,
+                                 ota_stream_push, &stream);
+        decoder.out_cb = ota_delta_feed_cb;
+        decoder.out_arg = delta;
+    }
+    if (compressed) {
+        inflate = ota_inflate_create(decoder.out_cb, decoder.out_arg);
+        decoder.inflate = inflate;
+    }
+    // Segmented mode: workers and their clients exist before the slot is touched
+    bool segmented = url && ota_config->connections > 1;
+    if (segmented) {
+        segfetch = ota_segfetch_create(url, ota_config->connections, OTA_SEGMENT_SIZE);
+    }
+    if (ring == NULL || writer_done == NULL || buffer == NULL || (segmented && segfetch == NULL) ||
+        (compressed && inflate == NULL) || (is_delta && delta == NULL)) {
+        ESP_LOGE(TAG, "Failed to allocate pipeline buffers");
+        err = ESP_ERR_NO_MEM;
+        goto cleanup;
+    }
+
+    // Hash every firmware byte as it streams past, no second pass over flash
+    mbedtls_sha256_starts(&stream.sha, 0);
+
+    if (resume_offset > 0) {
+        ESP_LOGI(TAG, "Resuming interrupted update at %d / %d bytes", resume_offset, actual_fw_size);
+        err = ota_rehash_partition(update_partition, resume_offset, &stream.sha, buffer);
+        if (err == ESP_OK) {
+            err = ota_transport_resume(transport, payload_start + resume_offset, content_length);
+            network_error = (err != ESP_OK);
+        }
+        if (err == ESP_OK && blocks) {
+            err = ota_blocks_seek(blocks, resume_offset);
+        }
+        if (err == ESP_OK) {
+            err = ota_flash_open(update_partition, actual_fw_size, resume_offset,
+                                 ota_config->skip_unchanged, &flash);
+        }
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "OTA resume failed: %s", esp_err_to_name(err));
+            goto cleanup;
+        }
+        received = payload_start + resume_offset;
+        stream.produced = resume_offset;
+        journal.written = resume_offset;
+    } else {
+        // Begin OTA - sectors are erased lazily, only up to actual_fw_size
+        err = ota_flash_open(update_partition, actual_fw_size, 0, ota_config->skip_unchanged, &flash);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "OTA begin failed: %s", esp_err_to_name(err));
+            goto cleanup;
+        }
+    }
+    ESP_LOGI(TAG, "OTA begin successful");
+
+    writer.ring = ring;
+    ota_flash_get_sink(flash, &writer.sink);
+    writer.fw_size = actual_fw_size;
+    writer.err = ESP_OK;
+    writer.done = writer_done;
+    writer.written = resume_offset;
+    writer.journal = resumable ? &journal : NULL;
+    // Same priority as the network side, lowered for background updates
+    if (xTaskCreate(ota_writer_task, "ota_writer", 4096, &writer, uxTaskPriorityGet(NULL), NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start flash writer task");
+        err = ESP_ERR_NO_MEM;
+        goto cleanup;
+    }
+
+    ESP_LOGI(TAG, "Writing firmware%s%s...", compressed ? " (decompressing)" : "",
+             is_delta ? " (patching)" : "");
+    ota_engine_report(ota_config, OTA_PHASE_DOWNLOADING, resume_offset, actual_fw_size);
+
+    // Network stage: decoded bytes fill whole slots while the writer flashes the previous ones
+    stream.ring = ring;
+    stream.writer = &writer;
+    stream.slot = ota_ring_acquire(ring);
+    stream.limit = actual_fw_size;
+    stream.check_image = (resume_offset == 0);
+    stream.min_version = ota_config->min_version;
+    ota_throttle_init(&throttle, ota_config->background ? OTA_BACKGROUND_RATE : 0,
+                      OTA_BACKGROUND_BURST, esp_timer_get_time());
+
+    // Raw firmware - the bytes already read belong to the image
+    if (!has_custom_header && resume_offset == 0) {
+        err = ota_stream_push(header, first_read, &stream);
+    }
+
+    // Segmented mode: the first connection only delivered the header
+    if (err == ESP_OK && segmented && received < content_length) {
+        ota_transport_close(transport);
+        ota_segfetch_start(segfetch, received, content_length);
+        while (err == ESP_OK && received < content_length) {
+            if (ota_engine_cancelled(ota_config)) {
+                err = ESP_ERR_INVALID_STATE;
+                break;
+            }
+            const uint8_t *data;
+            int len = ota_segfetch_next(segfetch, &data);
+            if (len <= 0) {
+                ESP_LOGE(TAG, "Error reading data");
+                err = ESP_FAIL;
+                network_error = true;
+                break;
+            }
+            received += len;
+            err = ota_decode(&decoder, data, len);
+            ota_segfetch_release(segfetch);
+            ota_throttle_wait(&throttle, len);
+            ota_engine_report(ota_config, OTA_PHASE_DOWNLOADING, stream.produced, actual_fw_size);
+        }
+        if (err == ESP_OK) {
+            ESP_LOGI(TAG, "Download complete");
+        }
+    }
+
+    int resumes = 0;
+    ota_block_retry_t block_retry = { .offset = UINT32_MAX };
+    while (err == ESP_OK && !segmented) {
+        if (ota_engine_cancelled(ota_config)) {
+            err = ESP_ERR_INVALID_STATE;
+            break;
+        }
+        int want = content_length - received;
+        if (want > OTA_RX_BUF_SIZE) {
+            want = OTA_RX_BUF_SIZE;
+        }
+        int data_read = ota_transport_read_full(transport, buffer, want);
+        if (data_read < want) {
+            // Dropped connection: keep decoder state and continue with a Range request
+            if (data_read > 0) {
+                received += data_read;
+                ota_throttle_wait(&throttle, data_read);
+                err = ota_decode(&decoder, (const uint8_t *)buffer, data_read);
+                if (err == ESP_ERR_INVALID_CRC &&
+                    ota_refetch_block(transport, &decoder, payload_start, content_length,
+                                      &received, &block_retry)) {
+                    err = ESP_OK;
+                    continue;
+                }
+                if (err != ESP_OK) {
+                    break;
+                }
+            }
+            if (url == NULL || resumes++ >= OTA_MAX_RESUMES) {
+                ESP_LOGE(TAG, "Error reading data");
+                err = ESP_FAIL;
+                network_error = true;
+                break;
+            }
+            ESP_LOGW(TAG, "Connection lost at %d / %d bytes, resuming (%d/%d)",
+                     received, content_length, resumes, OTA_MAX_RESUMES);
+            vTaskDelay(pdMS_TO_TICKS(OTA_RESUME_DELAY_MS * resumes));
+            if (ota_transport_resume(transport, received, content_length) != ESP_OK) {
+                err = ESP_FAIL;
+                network_error = true;
+                break;
+            }
+            continue;
+        }
+        received += data_read;
+        ota_throttle_wait(&throttle, data_read);
+
+        err = ota_decode(&decoder, (const uint8_t *)buffer, data_read);
+        if (err == ESP_ERR_INVALID_CRC) {
+            if (!ota_refetch_block(transport, &decoder, payload_start, content_length,
+                                   &received, &block_retry)) {
+                break;
+            }
+            err = ESP_OK;
+            continue;
+        }
+        ota_engine_report(ota_config, OTA_PHASE_DOWNLOADING, stream.produced, actual_fw_size);
+
+        if (received == content_length) {
+            ESP_LOGI(TAG, "Download complete");
+            break;
+        }
+    }
+
+    if (err == ESP_ERR_INVALID_STATE) {
+        ESP_LOGW(TAG, "Update cancelled at %d / %d bytes", stream.produced, actual_fw_size);
+    }
+
+    // Flush the partial slot, then a zero-length slot to stop the writer
+    if (err == ESP_OK) {
+        ota_stream_flush(&stream);
+        ota_engine_report(ota_config, OTA_PHASE_VERIFYING, stream.produced, actual_fw_size);
+    }
+    ota_ring_commit(ring, 0);
+    xSemaphoreTake(writer_done, portMAX_DELAY);
+
+    if (err == ESP_OK) {
+        err = writer.err;
+    }
+    if (err == ESP_OK) {
+        err = writer.sink.finish(writer.sink.ctx);
+    }
+
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&stream.sha, digest);
+
+    if (err == ESP_OK && blocks && !ota_blocks_done(blocks)) {
+        ESP_LOGE(TAG, "Block stream ended early");
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    if (err == ESP_OK && compressed && !ota_inflate_done(inflate)) {
+        ESP_LOGE(TAG, "Compressed stream ended early");
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    if (err == ESP_OK && is_delta) {
+        err = ota_delta_finish(delta);
+    }
+    if (err == ESP_OK && (received != content_length || stream.produced != actual_fw_size)) {
+        ESP_LOGE(TAG, "Truncated download: %d of %d bytes", stream.produced, actual_fw_size);
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    if (err == ESP_OK && has_custom_header) {
+        if (memcmp(digest, fw_header.sha256, sizeof(digest)) != 0) {
+            ESP_LOGE(TAG, "SHA256 mismatch, refusing to boot new image");
+            err = ESP_ERR_INVALID_CRC;
+        } else {
+            ESP_LOGI(TAG, "SHA256 verified");
+        }
+    }
+    if (err == ESP_OK) {
+        ota_flash_stats_t stats;
+        ota_flash_get_stats(flash, &stats);
+        ESP_LOGI(TAG, "Total firmware bytes written: %d", writer.written);
+        ESP_LOGI(TAG, "Flash: %lu erases (%lu bytes, %lld ms), %lu programs (%lu bytes, %lld ms)",
+                 stats.erase_ops, stats.erased_bytes, stats.erase_us / 1000,
+                 stats.write_ops, stats.written_bytes, stats.write_us / 1000);
+        ESP_LOGI(TAG, "Sectors: %lu written, %lu unchanged", stats.sectors_written, stats.sectors_skipped);
+        if (ota_config->result) {
+            ota_config->result->image_bytes = writer.written;
+            ota_config->result->sectors_written = stats.sectors_written;
+            ota_config->result->sectors_skipped = stats.sectors_skipped;
+        }
+    } else {
+        ESP_LOGE(TAG, "Download failed");
+    }
+
+cleanup:
+    // Integrity failures must start over; network failures resume next time
+    if ((flash != NULL || resume_offset > 0) && !network_error) {
+        ota_journal_clear();
+    }
+    mbedtls_sha256_free(&stream.sha);
+    ota_segfetch_stop(segfetch);
+    ota_inflate_delete(inflate);
+    ota_delta_delete(delta);
+    ota_ring_delete(ring);
+    if (writer_done) {
+        vSemaphoreDelete(writer_done);
+    }
+    ota_transport_close(transport);
+    ota_flash_close(flash);
+
+    ota_arena_stats_t arena;
+    ota_arena_get_stats(&arena);
+    ESP_LOGI(TAG, "Arena: %u of %u bytes used", (unsigned)arena.used, (unsigned)arena.size);
+    return err;
+}
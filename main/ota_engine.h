@@ -0,0 +1,38 @@
+#ifndef OTA_ENGINE_H
+#define OTA_ENGINE_H
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "ota_manager.h"
+#include "ota_transport.h"
+
+/**
+ * Download/decode/flash core of an update. Reads the container from an
+ * ota_transport_t, runs it through the decoding chain (block check, inflate,
+ * delta) and streams the image into the slot through ota_flash, with the
+ * network and flash stages overlapped by the ring. It knows nothing about
+ * HTTP endpoints, the single-flight claim or rebooting (ota_manager.c), so
+ * it builds unchanged on the host (test/host) against a file-backed
+ * partition and an in-process transport.
+ */
+
+/**
+ * @brief Download, decode and flash one image from transport into partition
+ * Buffers come from the OTA arena; the caller owns the claim and the reset.
+ * @return ESP_OK once the image is in the slot and its hash matched
+ */
+esp_err_t ota_engine_run(ota_transport_t *transport, const ota_update_config_t *config,
+                         const esp_partition_t *partition);
+
+/**
+ * @brief Call the config's progress hook, if any
+ */
+void ota_engine_report(const ota_update_config_t *config, ota_phase_t phase, int done, int total);
+
+/**
+ * @brief True once the config's cancel flag has been raised
+ */
+bool ota_engine_cancelled(const ota_update_config_t *config);
+
+#endif
@@ -0,0 +1,186 @@
+#include "ota_events.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "OTA_EVENTS";
+
+static portMUX_TYPE events_lock = portMUX_INITIALIZER_UNLOCKED;
+static ota_event_t latest = { .phase = OTA_PHASE_IDLE, .eta = -1, .error = ESP_OK };
+static int64_t last_emit_us = 0;
+static TaskHandle_t subscribers[OTA_EVENTS_MAX_SUBSCRIBERS];
+
+static const char *phase_names[] = {
+    [OTA_PHASE_IDLE]        = "idle",
+    [OTA_PHASE_QUEUED]      = "queued",
+    [OTA_PHASE_CONNECTING]  = "connecting",
+    [OTA_PHASE_DOWNLOADING] = "downloading",
+    [OTA_PHASE_VERIFYING]   = "verifying",
+    [OTA_PHASE_SCHEDULED]   = "scheduled",
+    [OTA_PHASE_REBOOTING]   = "rebooting",
+    [OTA_PHASE_FAILED]      = "failed",
+    [OTA_PHASE_CANCELLED]   = "cancelled",
+};
+
+const char *ota_phase_name(ota_phase_t phase)
+{
+    return phase_names[phase];
+}
+
+void ota_events_publish(const ota_event_t *event)
+{
+    TaskHandle_t wake[OTA_EVENTS_MAX_SUBSCRIBERS];
+    int64_t now = esp_timer_get_time();
+    bool emit;
+
+    taskENTER_CRITICAL(&events_lock);
+    emit = event->phase != latest.phase || event->error != latest.error ||
+           now - last_emit_us >= OTA_EVENTS_MIN_INTERVAL_MS * 1000LL;
+    if (emit) {
+        uint32_t seq = latest.seq + 1;
+        latest = *event;
+        latest.seq = seq;
+        latest.eta = (event->rate > 0 && event->total > event->bytes)
+                     ? (int)((event->total - event->bytes) / event->rate) : -1;
+        last_emit_us = now;
+        memcpy(wake, subscribers, sizeof(wake));
+    }
+    taskEXIT_CRITICAL(&events_lock);
+
+    if (emit) {
+        for (int i = 0; i < OTA_EVENTS_MAX_SUBSCRIBERS; i++) {
+            if (wake[i] != NULL) {
+                xTaskNotifyGive(wake[i]);
+            }
+        }
+    }
+}
+
+void ota_events_get(ota_event_t *event)
+{
+    taskENTER_CRITICAL(&events_lock);
+    *event = latest;
+    taskEXIT_CRITICAL(&events_lock);
+}
+
+int ota_events_to_json(const ota_event_t *event, char *buf, size_t len)
+{
+    return snprintf(buf, len,
+                    "{\"seq\":%lu,\"phase\":\"%s\",\"bytes\":%d,\"total\":%d,"
+                    "\"rate\":%lu,\"eta\":%d,\"error\":\"%s\"}",
+                    (unsigned long)event->seq, ota_phase_name(event->phase), event->bytes,
+                    event->total, (unsigned long)event->rate, event->eta,
+                    esp_err_to_name(event->error));
+}
+
+static bool ota_events_subscribe(void)
+{
+    bool added = false;
+
+    taskENTER_CRITICAL(&events_lock);
+    for (int i = 0; i < OTA_EVENTS_MAX_SUBSCRIBERS && !added; i++) {
+        if (subscribers[i] == NULL) {
+            subscribers[i] = xTaskGetCurrentTaskHandle();
+            added = true;
+        }
+    }
+    taskEXIT_CRITICAL(&events_lock);
+    return added;
+}
+
+static void ota_events_unsubscribe(void)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+    taskENTER_CRITICAL(&events_lock);
+    for (int i = 0; i < OTA_EVENTS_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i] == self) {
+            subscribers[i] = NULL;
+        }
+    }
+    taskEXIT_CRITICAL(&events_lock);
+}
+
+static void ota_events_task(void *pvParameter)
+{
+    httpd_req_t *req = (httpd_req_t *)pvParameter;
+    char buf[200];
+    uint32_t sent_seq = 0;
+    esp_err_t err = ESP_OK;
+
+    if (!ota_events_subscribe()) {
+        // Lost the race for the last slot
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_sendstr(req, "Too many event streams");
+        httpd_req_async_handler_complete(req);
+        vTaskDelete(NULL);
+        return;
+    }
+
+    httpd_resp_set_type(req, "text/event-stream");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    // Current state right away, then every newer event
+    for (bool first = true; err == ESP_OK; first = false) {
+        if (!first && ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(OTA_EVENTS_KEEPALIVE_MS)) == 0) {
+            err = httpd_resp_send_chunk(req, ": keepalive\n\n", HTTPD_RESP_USE_STRLEN);
+            continue;
+        }
+
+        ota_event_t event;
+        ota_events_get(&event);
+        if (!first && event.seq == sent_seq) {
+            continue;
+        }
+        sent_seq = event.seq;
+
+        int len = snprintf(buf, sizeof(buf), "data: ");
+        len += ota_events_to_json(&event, buf + len, sizeof(buf) - len);
+        len += snprintf(buf + len, sizeof(buf) - len, "\n\n");
+        err = httpd_resp_send_chunk(req, buf, len);
+    }
+
+    ESP_LOGD(TAG, "Event stream closed");
+    ota_events_unsubscribe();
+    httpd_req_async_handler_complete(req);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t ota_events_handler(httpd_req_t *req)
+{
+    // Quick check, the task claims the slot for real
+    bool full = true;
+    taskENTER_CRITICAL(&events_lock);
+    for (int i = 0; i < OTA_EVENTS_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i] == NULL) {
+            full = false;
+        }
+    }
+    taskEXIT_CRITICAL(&events_lock);
+    if (full) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_sendstr(req, "Too many event streams");
+    }
+
+    // Streams for as long as the client listens, off the server task
+    httpd_req_t *async_req = NULL;
+    esp_err_t err = httpd_req_async_handler_begin(req, &async_req);
+    if (err == ESP_OK && xTaskCreate(ota_events_task, "ota_events", 3072, async_req, 3, NULL) != pdPASS) {
+        httpd_resp_send_err(async_req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        httpd_req_async_handler_complete(async_req);
+        err = ESP_ERR_NO_MEM;
+    }
+    return err;
+}
+
+esp_err_t ota_events_register_handlers(httpd_handle_t server)
+{
+    httpd_uri_t events_uri = {
+        .uri       = "/ota/events",
+        .method    = HTTP_GET,
+        .handler   = ota_events_handler,
+    };
+    return httpd_register_uri_handler(server, &events_uri);
+}
@@ -0,0 +1,65 @@
+#ifndef OTA_EVENTS_H
+#define OTA_EVENTS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "freertos/FreeRTOS.h"
+#include "ota_manager.h"
+
+/**
+ * Progress pub/sub. The OTA side publishes snapshots without ever blocking;
+ * only the latest one is kept, and subscribers (Server-Sent Events clients on
+ * GET /ota/events) are woken with a task notification to pick it up. Progress
+ * within a phase is emitted at most every OTA_EVENTS_MIN_INTERVAL_MS, phase
+ * changes and errors always go out.
+ */
+
+#ifndef OTA_EVENTS_MIN_INTERVAL_MS
+#define OTA_EVENTS_MIN_INTERVAL_MS  250
+#endif
+#ifndef OTA_EVENTS_MAX_SUBSCRIBERS
+#define OTA_EVENTS_MAX_SUBSCRIBERS  3       // Open /ota/events streams, each holds a socket and a task
+#endif
+#define OTA_EVENTS_KEEPALIVE_MS     15000   // Comment line to detect clients that went away
+
+typedef struct {
+    uint32_t seq;               // Increments with every emitted event
+    ota_phase_t phase;
+    int bytes;                  // Firmware bytes decoded so far
+    int total;                  // Firmware size, 0 until known
+    uint32_t rate;              // Average bytes/s in this download
+    int eta;                    // Seconds left, -1 if unknown
+    esp_err_t error;            // Result of the last failed or cancelled update
+} ota_event_t;
+
+/**
+ * @brief Name of a phase as used in JSON ("downloading", ...)
+ */
+const char *ota_phase_name(ota_phase_t phase);
+
+/**
+ * @brief Publish a snapshot, seq and eta are filled in here
+ * Never blocks; dropped if it arrives within OTA_EVENTS_MIN_INTERVAL_MS of
+ * the previous one and carries the same phase and error.
+ */
+void ota_events_publish(const ota_event_t *event);
+
+/**
+ * @brief Latest event, for subscribers and one-off readers
+ */
+void ota_events_get(ota_event_t *event);
+
+/**
+ * @brief Format an event as a JSON object
+ * @return Length written, as snprintf
+ */
+int ota_events_to_json(const ota_event_t *event, char *buf, size_t len);
+
+/**
+ * @brief Register GET /ota/events (text/event-stream) on server
+ */
+esp_err_t ota_events_register_handlers(httpd_handle_t server);
+
+#endif
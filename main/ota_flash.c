@@ -0,0 +1,211 @@
+#include "ota_flash.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "ota_arena.h"
+#include "esp_ota_ops.h"
+#include <string.h>
+
+static const char *TAG = "OTA_FLASH";
+
+#define SECTOR_SIZE      SPI_FLASH_SEC_SIZE
+#define ALIGN_UP(x, a)   (((x) + (a) - 1) / (a) * (a))
+
+struct ota_flash {
+    const esp_partition_t *partition;
+    size_t limit;               // Image size rounded up to a sector
+    size_t flash_pos;           // Next sector to program
+    size_t erased_end;          // [flash_pos, erased_end) is erased
+    uint8_t *sector;            // DMA-capable coalescing buffer
+    size_t fill;
+    uint8_t *readback;          // Current slot contents, skip_unchanged only
+    ota_flash_stats_t stats;
+};
+
+esp_err_t ota_flash_open(const esp_partition_t *partition, size_t image_size,
+                         size_t offset, bool skip_unchanged, ota_flash_t **out)
+{
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    if (partition == NULL || partition == running || partition->type != ESP_PARTITION_TYPE_APP) {
+        ESP_LOGE(TAG, "Invalid OTA target partition");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Same guard as esp_ota_begin(): the running image must be confirmed first
+    esp_ota_img_states_t state;
+    if (esp_ota_get_state_partition(running, &state) == ESP_OK &&
+        state == ESP_OTA_IMG_PENDING_VERIFY) {
+        ESP_LOGE(TAG, "Running image not validated yet");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (image_size > partition->size || offset % SECTOR_SIZE != 0 || offset > image_size) {
+        ESP_LOGE(TAG, "Image of %u bytes (offset %u) does not fit %s",
+                 (unsigned)image_size, (unsigned)offset, partition->label);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    ota_flash_t *flash = ota_arena_alloc(sizeof(*flash));
+    if (flash == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    flash->sector = ota_arena_alloc_dma(SECTOR_SIZE);
+    if (skip_unchanged) {
+        flash->readback = ota_arena_alloc_dma(SECTOR_SIZE);
+    }
+    if (flash->sector == NULL || (skip_unchanged && flash->readback == NULL)) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    flash->partition = partition;
+    flash->limit = ALIGN_UP(image_size, SECTOR_SIZE);
+    flash->flash_pos = offset;
+    flash->erased_end = offset;
+    *out = flash;
+    return ESP_OK;
+}
+
+// Make sure the sector at flash_pos is erased, erasing a run ahead of it
+static esp_err_t ota_flash_erase_ahead(ota_flash_t *flash)
+{
+    if (flash->flash_pos < flash->erased_end) {
+        return ESP_OK;
+    }
+
+    size_t end = (flash->erased_end / OTA_FLASH_ERASE_AHEAD + 1) * OTA_FLASH_ERASE_AHEAD;
+    if (end > flash->limit) {
+        end = flash->limit;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t err = esp_partition_erase_range(flash->partition, flash->erased_end,
+                                              end - flash->erased_end);
+    flash->stats.erase_us += esp_timer_get_time() - start_us;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Erase at 0x%x failed: %s", (unsigned)flash->erased_end, esp_err_to_name(err));
+        return err;
+    }
+
+    flash->stats.erase_ops++;
+    flash->stats.erased_bytes += end - flash->erased_end;
+    flash->erased_end = end;
+    return ESP_OK;
+}
+
+// Erase just the sector at flash_pos (skip_unchanged mode)
+static esp_err_t ota_flash_erase_sector(ota_flash_t *flash)
+{
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t err = esp_partition_erase_range(flash->partition, flash->flash_pos, SECTOR_SIZE);
+    flash->stats.erase_us += esp_timer_get_time() - start_us;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Erase at 0x%x failed: %s", (unsigned)flash->flash_pos, esp_err_to_name(err));
+        return err;
+    }
+    flash->stats.erase_ops++;
+    flash->stats.erased_bytes += SECTOR_SIZE;
+    return ESP_OK;
+}
+
+static esp_err_t ota_flash_program(ota_flash_t *flash)
+{
+    esp_err_t err;
+
+    if (flash->readback) {
+        err = esp_partition_read(flash->partition, flash->flash_pos, flash->readback, flash->fill);
+        if (err == ESP_OK && memcmp(flash->readback, flash->sector, flash->fill) == 0) {
+            flash->stats.sectors_skipped++;
+            flash->flash_pos += SECTOR_SIZE;
+            flash->fill = 0;
+            return ESP_OK;
+        }
+        err = ota_flash_erase_sector(flash);
+    } else {
+        err = ota_flash_erase_ahead(flash);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    err = esp_partition_write(flash->partition, flash->flash_pos, flash->sector, flash->fill);
+    flash->stats.write_us += esp_timer_get_time() - start_us;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Write at 0x%x failed: %s", (unsigned)flash->flash_pos, esp_err_to_name(err));
+        return err;
+    }
+
+    flash->stats.sectors_written++;
+    flash->stats.write_ops++;
+    flash->stats.written_bytes += flash->fill;
+    flash->flash_pos += SECTOR_SIZE;
+    flash->fill = 0;
+    return ESP_OK;
+}
+
+esp_err_t ota_flash_write(ota_flash_t *flash, const void *data, size_t len)
+{
+    const uint8_t *src = data;
+
+    if (flash->flash_pos + flash->fill + len > flash->limit) {
+        ESP_LOGE(TAG, "Write past declared image size");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    while (len > 0) {
+        size_t n = SECTOR_SIZE - flash->fill;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(flash->sector + flash->fill, src, n);
+        flash->fill += n;
+        src += n;
+        len -= n;
+
+        if (flash->fill == SECTOR_SIZE) {
+            esp_err_t err = ota_flash_program(flash);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t ota_flash_finish(ota_flash_t *flash)
+{
+    if (flash->fill == 0) {
+        return ESP_OK;
+    }
+    // esp_partition_write() needs 4-byte multiples with flash encryption; pad with erased state
+    size_t padded = ALIGN_UP(flash->fill, 16);
+    memset(flash->sector + flash->fill, 0xFF, padded - flash->fill);
+    flash->fill = padded;
+    return ota_flash_program(flash);
+}
+
+static esp_err_t ota_flash_sink_write(void *ctx, const uint8_t *data, size_t len)
+{
+    return ota_flash_write((ota_flash_t *)ctx, data, len);
+}
+
+static esp_err_t ota_flash_sink_finish(void *ctx)
+{
+    return ota_flash_finish((ota_flash_t *)ctx);
+}
+
+void ota_flash_get_sink(ota_flash_t *flash, ota_sink_t *sink)
+{
+    sink->write = ota_flash_sink_write;
+    sink->finish = ota_flash_sink_finish;
+    sink->ctx = flash;
+}
+
+void ota_flash_get_stats(const ota_flash_t *flash, ota_flash_stats_t *stats)
+{
+    *stats = flash->stats;
+}
+
+void ota_flash_close(ota_flash_t *flash)
+{
+    // Buffers go back with the arena, nothing is held outside it
+}
@@ -0,0 +1,77 @@
+#ifndef OTA_FLASH_H
+#define OTA_FLASH_H
+
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "ota_sink.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Erase granularity ahead of the write cursor; 64KB aligned runs use block erase
+#ifndef OTA_FLASH_ERASE_AHEAD
+#define OTA_FLASH_ERASE_AHEAD  (64 * 1024)
+#endif
+
+/**
+ * Flash operation counters for one update
+ */
+typedef struct {
+    uint32_t erase_ops;         // esp_partition_erase_range() calls
+    uint32_t erased_bytes;
+    uint32_t write_ops;         // esp_partition_write() calls, one per sector
+    uint32_t written_bytes;
+    int64_t erase_us;           // Time spent blocked in erase
+    int64_t write_us;           // Time spent blocked in program
+    uint32_t sectors_written;   // Sectors erased and programmed
+    uint32_t sectors_skipped;   // Sectors that already held the same bytes
+} ota_flash_stats_t;
+
+/**
+ * Sector-coalescing writer for an OTA slot. Replaces esp_ota_begin()/
+ * esp_ota_write(): nothing is erased up front, sectors are erased in
+ * OTA_FLASH_ERASE_AHEAD runs just before the write cursor reaches them and
+ * only up to the declared image size, and data is programmed one full
+ * sector at a time from a DMA-capable buffer. Image validation is left to
+ * esp_ota_set_boot_partition().
+ *
+ * With skip_unchanged, every sector is first read back and compared; sectors
+ * the slot already holds (retries, A/B ping-pong of near-identical images)
+ * are neither erased nor programmed. Erase then happens per sector.
+ */
+typedef struct ota_flash ota_flash_t;
+
+/**
+ * @brief Prepare to write image_size bytes into partition starting at offset
+ * @param offset Sector-aligned resume point, 0 for a fresh update
+ * @param skip_unchanged Compare against current slot contents before writing
+ */
+esp_err_t ota_flash_open(const esp_partition_t *partition, size_t image_size,
+                         size_t offset, bool skip_unchanged, ota_flash_t **out);
+
+/**
+ * @brief Append image bytes
+ */
+esp_err_t ota_flash_write(ota_flash_t *flash, const void *data, size_t len);
+
+/**
+ * @brief Program the final partial sector
+ */
+esp_err_t ota_flash_finish(ota_flash_t *flash);
+
+/**
+ * @brief Expose the writer as a generic pipeline sink
+ */
+void ota_flash_get_sink(ota_flash_t *flash, ota_sink_t *sink);
+
+/**
+ * @brief Counters since ota_flash_open()
+ */
+void ota_flash_get_stats(const ota_flash_t *flash, ota_flash_stats_t *stats);
+
+/**
+ * @brief Release the writer (does not touch flash)
+ */
+void ota_flash_close(ota_flash_t *flash);
+
+#endif
@@ -0,0 +1,19 @@
+#include "ota_header.h"
+#include <stdio.h>
+#include <string.h>
+
+bool ota_header_parse(const uint8_t *buf, ota_header_t *out)
+{
+    memcpy(out, buf, sizeof(*out));
+    return out->magic == OTA_HEADER_MAGIC;
+}
+
+uint32_t ota_header_version_from_string(const char *version)
+{
+    unsigned major = 0, minor = 0, patch = 0;
+    if (version[0] == 'v') {
+        version++;
+    }
+    sscanf(version, "%u.%u.%u", &major, &minor, &patch);
+    return (major & 0xFF) << 16 | (minor & 0xFF) << 8 | (patch & 0xFF);
+}
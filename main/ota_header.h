@@ -0,0 +1,69 @@
+#ifndef OTA_HEADER_H
+#define OTA_HEADER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define OTA_HEADER_SIZE      44     // Custom header from tools/prepare-firmware.py
+#define OTA_HEADER_MAGIC     0xDEADBEEF
+
+/**
+ * Layout written by tools/prepare-firmware.py (little endian)
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;         // OTA_HEADER_MAGIC
+    uint32_t version;       // flags << 24 | major << 16 | minor << 8 | patch
+    uint32_t size;          // Firmware image bytes (after decoding the payload)
+    uint8_t sha256[32];     // SHA-256 of the firmware image
+} ota_header_t;
+
+// Flags live in the top byte of the version word, zero in older containers
+#define OTA_HEADER_FLAG_DEFLATE  0x01   // Payload is raw deflate, OTA_INFLATE_WINDOW_BITS window
+#define OTA_HEADER_FLAG_DELTA    0x02   // ota_delta_ext_t follows, payload is a patch stream
+#define OTA_HEADER_FLAG_BLOCKS   0x04   // ota_blocks_ext_t and a digest table precede the payload
+
+#define OTA_HEADER_FLAGS(hdr)    ((uint8_t)((hdr)->version >> 24))
+#define OTA_HEADER_VERSION(hdr)  ((hdr)->version & 0x00FFFFFF)
+
+_Static_assert(sizeof(ota_header_t) == OTA_HEADER_SIZE, "ota_header_t must match prepare-firmware.py");
+
+/**
+ * Extension after the header when OTA_HEADER_FLAG_DELTA is set: identifies
+ * the image the patch was generated against (tools/make-delta.py)
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t base_size;         // Bytes of the base image
+    uint8_t base_sha256[32];    // SHA-256 of those bytes
+} ota_delta_ext_t;
+
+#define OTA_DELTA_EXT_SIZE   sizeof(ota_delta_ext_t)
+
+/**
+ * Extension when OTA_HEADER_FLAG_BLOCKS is set, after the delta extension if
+ * any (tools/prepare-firmware.py --block-size). The payload as transported
+ * (compressed or patch bytes included) is split into block_size pieces, the
+ * last one shorter; block_count SHA-256 digests follow this struct, and
+ * table_sha256 covers that table.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t block_size;        // Payload bytes per block, multiple of 4096
+    uint32_t block_count;       // Digests in the table
+    uint8_t table_sha256[32];   // SHA-256 of the digest table
+} ota_blocks_ext_t;
+
+#define OTA_BLOCKS_EXT_SIZE  sizeof(ota_blocks_ext_t)
+#define OTA_BLOCK_DIGEST_SIZE 32
+
+/**
+ * @brief Decode the first OTA_HEADER_SIZE bytes of a download
+ * @return true if buf starts with a custom header
+ */
+bool ota_header_parse(const uint8_t *buf, ota_header_t *out);
+
+/**
+ * @brief Encode "major.minor.patch" (optional leading 'v') like the header
+ * version field, without flags. Unparsed parts count as 0.
+ */
+uint32_t ota_header_version_from_string(const char *version);
+
+#endif
@@ -0,0 +1,71 @@
+#include "ota_image.h"
+#include "ota_header.h"
+#include "esp_app_desc.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_log.h"
+#include "hal/efuse_hal.h"
+#include <string.h>
+
+static const char *TAG = "OTA_IMAGE";
+
+esp_err_t ota_image_check(const uint8_t *buf, uint32_t min_version)
+{
+    esp_image_header_t image;
+    esp_app_desc_t desc;
+    memcpy(&image, buf, sizeof(image));
+    memcpy(&desc, buf + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(desc));
+
+    if (image.magic != ESP_IMAGE_HEADER_MAGIC || desc.magic_word != ESP_APP_DESC_MAGIC_WORD) {
+        ESP_LOGE(TAG, "Not an app image (magic 0x%02x, app desc 0x%08lx)",
+                 image.magic, desc.magic_word);
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+
+    // The running image was built for this chip, compare against its header
+    esp_image_header_t running_image;
+    esp_err_t err = esp_partition_read(esp_ota_get_running_partition(), 0,
+                                       &running_image, sizeof(running_image));
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (image.chip_id != running_image.chip_id) {
+        ESP_LOGE(TAG, "Image built for chip id %d, this is %d", image.chip_id, running_image.chip_id);
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+
+    uint32_t revision = efuse_hal_chip_revision();
+    // Images from IDF releases without the field leave the maximum at 0
+    if (revision < image.min_chip_rev_full ||
+        (image.max_chip_rev_full != 0 && revision > image.max_chip_rev_full)) {
+        ESP_LOGE(TAG, "Image needs chip revision v%d.%d - v%d.%d, this is v%lu.%lu",
+                 image.min_chip_rev_full / 100, image.min_chip_rev_full % 100,
+                 image.max_chip_rev_full / 100, image.max_chip_rev_full % 100,
+                 revision / 100, revision % 100);
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+
+    const esp_app_desc_t *running = esp_app_get_description();
+    desc.project_name[sizeof(desc.project_name) - 1] = '\0';
+    desc.version[sizeof(desc.version) - 1] = '\0';
+    if (OTA_IMAGE_CHECK_PROJECT && strcmp(desc.project_name, running->project_name) != 0) {
+        ESP_LOGE(TAG, "Image is for project '%s', running '%s'", desc.project_name, running->project_name);
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+
+    uint32_t version = ota_header_version_from_string(desc.version);
+    if (!OTA_IMAGE_ALLOW_DOWNGRADE) {
+        uint32_t running_version = ota_header_version_from_string(running->version);
+        if (min_version < running_version) {
+            min_version = running_version;
+        }
+    }
+    if (version < min_version) {
+        ESP_LOGE(TAG, "Image version %s older than 0x%06lx", desc.version, min_version);
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    ESP_LOGI(TAG, "Image %s %s accepted (chip id %d, rev v%d.%d+)", desc.project_name,
+             desc.version, image.chip_id, image.min_chip_rev_full / 100, image.min_chip_rev_full % 100);
+    return ESP_OK;
+}
@@ -0,0 +1,35 @@
+#ifndef OTA_IMAGE_H
+#define OTA_IMAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_app_format.h"
+
+#ifndef OTA_IMAGE_CHECK_PROJECT
+#define OTA_IMAGE_CHECK_PROJECT   1     // Reject images built for another project
+#endif
+#ifndef OTA_IMAGE_ALLOW_DOWNGRADE
+#define OTA_IMAGE_ALLOW_DOWNGRADE 1     // 0: reject versions older than the running app
+#endif
+
+// Image header, first segment header and app description: the first bytes
+// of every app image, enough to tell whether it can run here at all
+#define OTA_IMAGE_CHECK_SIZE  (sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + \
+                               sizeof(esp_app_desc_t))
+
+/**
+ * @brief Check the start of a decoded image against this device
+ *
+ * Rejects non-app binaries, another chip target or unsupported chip revision,
+ * another project name (OTA_IMAGE_CHECK_PROJECT) and versions below
+ * min_version (or below the running app without OTA_IMAGE_ALLOW_DOWNGRADE).
+ *
+ * @param buf First OTA_IMAGE_CHECK_SIZE bytes of the image
+ * @param min_version Lowest acceptable version as ota_header_version_from_string(), 0 for any
+ * @return ESP_ERR_OTA_VALIDATE_FAILED for images that cannot run here,
+ *         ESP_ERR_INVALID_VERSION for a rejected version
+ */
+esp_err_t ota_image_check(const uint8_t *buf, uint32_t min_version);
+
+#endif
@@ -0,0 +1,82 @@
+#include "ota_inflate.h"
+#include "ota_arena.h"
+#include "esp_log.h"
+#include "rom/miniz.h"
+
+static const char *TAG = "OTA_INFLATE";
+
+struct ota_inflate {
+    tinfl_decompressor decomp;
+    uint8_t window[OTA_INFLATE_WINDOW_SIZE];    // Circular history, power of two
+    size_t window_ofs;
+    ota_inflate_out_cb_t out_cb;
+    void *arg;
+    bool done;
+};
+
+ota_inflate_t *ota_inflate_create(ota_inflate_out_cb_t out_cb, void *arg)
+{
+    ota_inflate_t *inf = ota_arena_alloc(sizeof(*inf));
+    if (inf == NULL) {
+        return NULL;
+    }
+    tinfl_init(&inf->decomp);
+    inf->window_ofs = 0;
+    inf->out_cb = out_cb;
+    inf->arg = arg;
+    inf->done = false;
+    return inf;
+}
+
+void ota_inflate_delete(ota_inflate_t *inf)
+{
+    // State goes back with the arena
+}
+
+esp_err_t ota_inflate_feed(ota_inflate_t *inf, const uint8_t *data, size_t len)
+{
+    while (!inf->done) {
+        size_t in_bytes = len;
+        size_t out_bytes = OTA_INFLATE_WINDOW_SIZE - inf->window_ofs;
+
+        // Wrapping output mode: the window doubles as the deflate dictionary
+        tinfl_status status = tinfl_decompress(&inf->decomp, data, &in_bytes,
+                                               inf->window, inf->window + inf->window_ofs,
+                                               &out_bytes, TINFL_FLAG_HAS_MORE_INPUT);
+        data += in_bytes;
+        len -= in_bytes;
+
+        if (out_bytes > 0) {
+            esp_err_t err = inf->out_cb(inf->window + inf->window_ofs, out_bytes, inf->arg);
+            if (err != ESP_OK) {
+                return err;
+            }
+            inf->window_ofs = (inf->window_ofs + out_bytes) & (OTA_INFLATE_WINDOW_SIZE - 1);
+        }
+
+        if (status < TINFL_STATUS_DONE) {
+            ESP_LOGE(TAG, "Corrupt compressed stream (status %d)", status);
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        if (status == TINFL_STATUS_DONE) {
+            inf->done = true;
+        } else if (status == TINFL_STATUS_NEEDS_MORE_INPUT && len == 0) {
+            break;
+        }
+    }
+
+    if (len > 0) {
+        ESP_LOGW(TAG, "Ignoring %u bytes after end of compressed stream", (unsigned)len);
+    }
+    return ESP_OK;
+}
+
+bool ota_inflate_done(const ota_inflate_t *inf)
+{
+    return inf->done;
+}
+
+size_t ota_inflate_footprint(void)
+{
+    return sizeof(ota_inflate_t);
+}
@@ -0,0 +1,55 @@
+#ifndef OTA_INFLATE_H
+#define OTA_INFLATE_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Raw deflate window used by tools/prepare-firmware.py --compress.
+// The decompressor keeps exactly this much history, so RAM stays bounded.
+#ifndef OTA_INFLATE_WINDOW_BITS
+#define OTA_INFLATE_WINDOW_BITS 12
+#endif
+#define OTA_INFLATE_WINDOW_SIZE (1 << OTA_INFLATE_WINDOW_BITS)
+
+/**
+ * Streaming raw-deflate decoder built on the ROM tinfl implementation.
+ * Compressed bytes go in through ota_inflate_feed(), decoded bytes come
+ * out through the callback in chunks of at most OTA_INFLATE_WINDOW_SIZE.
+ */
+typedef struct ota_inflate ota_inflate_t;
+
+/**
+ * @brief Receives decoded bytes; a non-ESP_OK return stops decoding
+ */
+typedef esp_err_t (*ota_inflate_out_cb_t)(const uint8_t *data, size_t len, void *arg);
+
+/**
+ * @brief Allocate decoder state and history window
+ * @return NULL on allocation failure
+ */
+ota_inflate_t *ota_inflate_create(ota_inflate_out_cb_t out_cb, void *arg);
+
+/**
+ * @brief Free decoder state
+ */
+void ota_inflate_delete(ota_inflate_t *inf);
+
+/**
+ * @brief Decode the next piece of the compressed stream
+ * @return ESP_ERR_INVALID_RESPONSE on corrupt data, or the callback's error
+ */
+esp_err_t ota_inflate_feed(ota_inflate_t *inf, const uint8_t *data, size_t len);
+
+/**
+ * @brief True once the final deflate block has been decoded
+ */
+bool ota_inflate_done(const ota_inflate_t *inf);
+
+/**
+ * @brief Bytes of heap held by one decoder instance
+ */
+size_t ota_inflate_footprint(void);
+
+#endif
@@ -0,0 +1,346 @@
+#include "ota_job.h"
+#include "ota_events.h"
+#include "ota_arena.h"
+#include "boot_trace.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "OTA_JOB";
+
+typedef struct {
+    char url[OTA_JOB_URL_MAX];
+    uint32_t min_version;
+    bool background;
+} ota_job_t;
+
+static portMUX_TYPE job_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t job_task = NULL;
+static ota_job_t queue[OTA_JOB_QUEUE_LEN];
+static int queue_head = 0;
+static ota_job_status_t status = { .phase = OTA_PHASE_IDLE, .last_error = ESP_OK };
+static volatile bool cancel_requested = false;
+static int64_t rate_start_us;
+static int rate_start_bytes;
+
+// Caller holds job_lock
+static bool ota_job_active(void)
+{
+    return status.phase >= OTA_PHASE_CONNECTING && status.phase <= OTA_PHASE_REBOOTING;
+}
+
+// Caller holds job_lock; publish the result after releasing it
+static void ota_job_snapshot(ota_event_t *event)
+{
+    event->phase = status.phase;
+    event->bytes = status.bytes;
+    event->total = status.total;
+    event->rate = status.rate;
+    event->error = status.last_error;
+}
+
+// Caller holds job_lock. A new run owns the status from here on; a cancel
+// that arrives after this point is meant for it.
+static void ota_job_begin_locked(const char *label)
+{
+    cancel_requested = false;
+    strncpy(status.url, label, sizeof(status.url) - 1);
+    status.url[sizeof(status.url) - 1] = '\0';
+    status.bytes = 0;
+    status.total = 0;
+    status.rate = 0;
+    status.phase = OTA_PHASE_CONNECTING;
+}
+
+static void ota_job_progress(ota_phase_t phase, int done, int total, void *arg)
+{
+    int64_t now = esp_timer_get_time();
+    ota_event_t event;
+    bool phase_changed;
+
+    taskENTER_CRITICAL(&job_lock);
+    phase_changed = (phase != status.phase);
+    if (phase == OTA_PHASE_DOWNLOADING && status.phase != OTA_PHASE_DOWNLOADING) {
+        rate_start_us = now;
+        rate_start_bytes = done;
+    }
+    if (total > 0) {
+        status.bytes = done;
+        status.total = total;
+        if (now > rate_start_us) {
+            status.rate = (uint32_t)((int64_t)(done - rate_start_bytes) * 1000000 / (now - rate_start_us));
+        }
+    }
+    status.phase = phase;
+    ota_job_snapshot(&event);
+    taskEXIT_CRITICAL(&job_lock);
+
+    if (phase_changed) {
+        boot_trace_mark(BOOT_TRACE_OTA_PHASE, phase);
+    }
+    ota_events_publish(&event);
+}
+
+void ota_job_finished(esp_err_t err)
+{
+    ota_event_t event;
+
+    taskENTER_CRITICAL(&job_lock);
+    if (status.phase == OTA_PHASE_FAILED || status.phase == OTA_PHASE_CANCELLED) {
+        status.last_error = err;
+    }
+    ota_job_snapshot(&event);
+    taskEXIT_CRITICAL(&job_lock);
+
+    ota_events_publish(&event);
+}
+
+static void ota_job_hook(ota_update_config_t *config)
+{
+    config->progress = ota_job_progress;
+    config->progress_arg = NULL;
+    config->cancel = &cancel_requested;
+}
+
+void ota_job_bind(ota_update_config_t *config, const char *label)
+{
+    ota_event_t event;
+
+    taskENTER_CRITICAL(&job_lock);
+    ota_job_begin_locked(label);
+    ota_job_snapshot(&event);
+    taskEXIT_CRITICAL(&job_lock);
+    ota_events_publish(&event);
+
+    ota_job_hook(config);
+}
+
+// Takes the next job and makes it the active one in the same step, so a
+// cancel from here on reaches it instead of a queue that is already empty
+static bool ota_job_pop(ota_job_t *job)
+{
+    bool found = false;
+    ota_event_t event;
+
+    taskENTER_CRITICAL(&job_lock);
+    if (status.queued > 0) {
+        *job = queue[queue_head];
+        queue_head = (queue_head + 1) % OTA_JOB_QUEUE_LEN;
+        status.queued--;
+        ota_job_begin_locked(job->url);
+        found = true;
+    }
+    ota_job_snapshot(&event);
+    taskEXIT_CRITICAL(&job_lock);
+
+    if (found) {
+        ota_events_publish(&event);
+    }
+    return found;
+}
+
+static void ota_job_task(void *pvParameter)
+{
+    ota_job_t job;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while (ota_job_pop(&job)) {
+            ESP_LOGI(TAG, "Running job: %s", job.url);
+            ota_update_config_t config = OTA_UPDATE_CONFIG_DEFAULT();
+            config.url = job.url;
+            config.min_version = job.min_version;
+            config.background = job.background;
+            ota_job_hook(&config);
+            if (cancel_requested) {
+                // Cancelled between the pop and here, nothing was touched yet
+                ota_job_progress(OTA_PHASE_CANCELLED, 0, 0, NULL);
+                ota_job_finished(ESP_ERR_INVALID_STATE);
+                ESP_LOGW(TAG, "Job cancelled before it started");
+                continue;
+            }
+            if (job.background) {
+                // One throttled stream, below the application's tasks
+                config.connections = 1;
+                vTaskPrioritySet(NULL, OTA_BACKGROUND_PRIORITY);
+            }
+
+            // Returns only on failure, success reboots
+            esp_err_t err = ota_update_start(&config);
+            vTaskPrioritySet(NULL, OTA_JOB_PRIORITY);
+            ota_job_finished(err);
+            ESP_LOGW(TAG, "Job finished: %s", esp_err_to_name(err));
+        }
+    }
+}
+
+esp_err_t ota_job_init(void)
+{
+    if (job_task != NULL) {
+        return ESP_OK;
+    }
+    if (xTaskCreate(ota_job_task, "ota_task", 8192, NULL, OTA_JOB_PRIORITY, &job_task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start OTA worker");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t ota_job_enqueue(const char *url, uint32_t min_version, bool background)
+{
+    if (job_task == NULL || url == NULL || strlen(url) >= OTA_JOB_URL_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = ESP_OK;
+    bool coalesced = false;
+    ota_event_t event;
+
+    taskENTER_CRITICAL(&job_lock);
+    if (ota_job_active() && strcmp(status.url, url) == 0) {
+        coalesced = true;
+    }
+    for (int i = 0; i < status.queued && !coalesced; i++) {
+        if (strcmp(queue[(queue_head + i) % OTA_JOB_QUEUE_LEN].url, url) == 0) {
+            coalesced = true;
+        }
+    }
+    if (!coalesced) {
+        if (status.queued == OTA_JOB_QUEUE_LEN) {
+            err = ESP_ERR_NO_MEM;
+        } else {
+            ota_job_t *job = &queue[(queue_head + status.queued) % OTA_JOB_QUEUE_LEN];
+            strcpy(job->url, url);
+            job->min_version = min_version;
+            job->background = background;
+            status.queued++;
+            if (!ota_job_active()) {
+                status.phase = OTA_PHASE_QUEUED;
+            }
+        }
+    }
+    ota_job_snapshot(&event);
+    taskEXIT_CRITICAL(&job_lock);
+    ota_events_publish(&event);
+
+    if (coalesced) {
+        ESP_LOGI(TAG, "Already scheduled, coalesced: %s", url);
+    } else if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Queue full, rejected: %s", url);
+    } else {
+        ESP_LOGI(TAG, "Queued: %s", url);
+        xTaskNotifyGive(job_task);
+    }
+    return err;
+}
+
+esp_err_t ota_job_submit(const char *url)
+{
+    return ota_job_enqueue(url, 0, false);
+}
+
+esp_err_t ota_job_submit_versioned(const char *url, uint32_t min_version)
+{
+    return ota_job_enqueue(url, min_version, false);
+}
+
+esp_err_t ota_job_submit_background(const char *url, uint32_t min_version)
+{
+    return ota_job_enqueue(url, min_version, true);
+}
+
+void ota_job_cancel(void)
+{
+    ota_event_t event;
+
+    taskENTER_CRITICAL(&job_lock);
+    status.queued = 0;
+    if (ota_job_active()) {
+        cancel_requested = true;
+    } else if (status.phase == OTA_PHASE_QUEUED) {
+        status.phase = OTA_PHASE_CANCELLED;
+    }
+    ota_job_snapshot(&event);
+    taskEXIT_CRITICAL(&job_lock);
+    ota_events_publish(&event);
+    ESP_LOGW(TAG, "Cancel requested");
+}
+
+bool ota_job_pending(void)
+{
+    taskENTER_CRITICAL(&job_lock);
+    bool pending = status.queued > 0;
+    taskEXIT_CRITICAL(&job_lock);
+    return pending;
+}
+
+void ota_job_get_status(ota_job_status_t *out)
+{
+    taskENTER_CRITICAL(&job_lock);
+    *out = status;
+    taskEXIT_CRITICAL(&job_lock);
+}
+
+static esp_err_t ota_status_handler(httpd_req_t *req)
+{
+    ota_job_status_t st;
+    ota_job_get_status(&st);
+
+    // URLs come from form input, keep the JSON well-formed
+    for (char *p = st.url; *p; p++) {
+        if (*p == '"' || *p == '\\' || (unsigned char)*p < 0x20) {
+            *p = '_';
+        }
+    }
+
+    ota_arena_stats_t arena;
+    ota_arena_get_stats(&arena);
+
+    char json[OTA_JOB_URL_MAX + 256];
+    snprintf(json, sizeof(json),
+             "{\"phase\":\"%s\",\"bytes\":%d,\"total\":%d,\"rate\":%lu,"
+             "\"queued\":%d,\"error\":\"%s\",\"url\":\"%s\","
+             "\"arena\":{\"size\":%u,\"used\":%u,\"peak\":%u,\"failures\":%u}}",
+             ota_phase_name(st.phase), st.bytes, st.total, (unsigned long)st.rate,
+             st.queued, esp_err_to_name(st.last_error), st.url,
+             (unsigned)arena.size, (unsigned)arena.used, (unsigned)arena.high_water, arena.failures);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_sendstr(req, json);
+}
+
+static esp_err_t ota_cancel_handler(httpd_req_t *req)
+{
+    ota_job_cancel();
+    return httpd_resp_sendstr(req, "Cancel requested");
+}
+
+esp_err_t ota_job_register_handlers(httpd_handle_t server)
+{
+    httpd_uri_t status_uri = {
+        .uri       = "/ota/status",
+        .method    = HTTP_GET,
+        .handler   = ota_status_handler,
+    };
+    esp_err_t err = httpd_register_uri_handler(server, &status_uri);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    httpd_uri_t cancel_uri = {
+        .uri       = "/ota/cancel",
+        .method    = HTTP_POST,
+        .handler   = ota_cancel_handler,
+    };
+    err = httpd_register_uri_handler(server, &cancel_uri);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    return ota_events_register_handlers(server);
+}
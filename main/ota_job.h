@@ -0,0 +1,88 @@
+#ifndef OTA_JOB_H
+#define OTA_JOB_H
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "ota_manager.h"
+
+/**
+ * Asynchronous OTA scheduler. One worker task runs queued URL updates one
+ * after another, so HTTP handlers return immediately and repeated clicks
+ * cannot start concurrent writers. A request for a URL that is already
+ * running or queued is coalesced into the existing job.
+ */
+
+#ifndef OTA_JOB_QUEUE_LEN
+#define OTA_JOB_QUEUE_LEN   2       // Pending jobs behind the running one
+#endif
+#define OTA_JOB_URL_MAX     200     // Same limit as the resume journal
+#define OTA_JOB_PRIORITY    5       // Worker task, dropped to OTA_BACKGROUND_PRIORITY for background jobs
+
+typedef struct {
+    ota_phase_t phase;
+    int bytes;                  // Firmware bytes decoded so far
+    int total;                  // Firmware size, 0 until known
+    uint32_t rate;              // Average download rate in bytes/s
+    int queued;                 // Jobs waiting behind the current one
+    esp_err_t last_error;       // Result of the last failed or cancelled job
+    char url[OTA_JOB_URL_MAX];  // Source of the current (or last) job
+} ota_job_status_t;
+
+/**
+ * @brief Start the worker task, safe to call more than once
+ */
+esp_err_t ota_job_init(void);
+
+/**
+ * @brief Queue an update from url
+ * @return ESP_OK when queued or coalesced, ESP_ERR_NO_MEM when the queue is full
+ */
+esp_err_t ota_job_submit(const char *url);
+
+/**
+ * @brief Queue an update that must carry at least min_version in its header
+ * See ota_update_config_t.min_version.
+ */
+esp_err_t ota_job_submit_versioned(const char *url, uint32_t min_version);
+
+/**
+ * @brief Queue a versioned update in background mode
+ * Single throttled stream at OTA_BACKGROUND_PRIORITY; the verified image is
+ * activated only inside the maintenance window. See ota_update_config_t.background.
+ */
+esp_err_t ota_job_submit_background(const char *url, uint32_t min_version);
+
+/**
+ * @brief Abort the running job and drop all queued ones
+ */
+void ota_job_cancel(void);
+
+/**
+ * @brief True while jobs wait behind the running one
+ */
+bool ota_job_pending(void);
+
+/**
+ * @brief Snapshot of the scheduler state
+ */
+void ota_job_get_status(ota_job_status_t *status);
+
+/**
+ * @brief Report progress and take cancellation from the scheduler
+ * For updates that run outside the worker (e.g. /upload). Makes the update
+ * the active one in the status and clears any earlier cancel request.
+ * @param label Shown as the job source in the status
+ */
+void ota_job_bind(ota_update_config_t *config, const char *label);
+
+/**
+ * @brief Record the result of a bound update that returned instead of rebooting
+ */
+void ota_job_finished(esp_err_t err);
+
+/**
+ * @brief Register GET /ota/status, POST /ota/cancel and GET /ota/events on server
+ */
+esp_err_t ota_job_register_handlers(httpd_handle_t server);
+
+#endif
@@ -0,0 +1,69 @@
+#include "ota_journal.h"
+#include "esp_log.h"
+#include "nvs.h"
+
+static const char *TAG = "OTA_JOURNAL";
+
+#define NVS_NAMESPACE        "ota_journal"
+#define NVS_JOURNAL_KEY      "progress"
+#define OTA_JOURNAL_VERSION  1
+
+esp_err_t ota_journal_load(ota_journal_t *journal)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    if (err != ESP_OK) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    size_t len = sizeof(*journal);
+    err = nvs_get_blob(nvs_handle, NVS_JOURNAL_KEY, journal, &len);
+    nvs_close(nvs_handle);
+
+    if (err != ESP_OK || len != sizeof(*journal) || journal->version != OTA_JOURNAL_VERSION) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return ESP_OK;
+}
+
+esp_err_t ota_journal_save(const ota_journal_t *journal)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    ota_journal_t entry = *journal;
+    entry.version = OTA_JOURNAL_VERSION;
+
+    err = nvs_set_blob(nvs_handle, NVS_JOURNAL_KEY, &entry, sizeof(entry));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save progress: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+esp_err_t ota_journal_clear(void)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    err = nvs_erase_key(nvs_handle, NVS_JOURNAL_KEY);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
+        err = ESP_OK;
+    }
+    nvs_close(nvs_handle);
+    return err;
+}
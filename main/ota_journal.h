@@ -0,0 +1,41 @@
+#ifndef OTA_JOURNAL_H
+#define OTA_JOURNAL_H
+
+#include "esp_err.h"
+#include <stdint.h>
+
+// Checkpoint interval for interrupted downloads, multiple of the flash sector size
+#ifndef OTA_JOURNAL_INTERVAL
+#define OTA_JOURNAL_INTERVAL  (64 * 1024)
+#endif
+
+/**
+ * Progress of an in-flight download, persisted in NVS so a transfer
+ * interrupted by a Wi-Fi drop or reset continues where it stopped.
+ */
+typedef struct {
+    uint32_t version;           // OTA_JOURNAL_VERSION
+    uint8_t image_id[32];       // Header SHA-256, or SHA-256 of the URL for raw images
+    uint32_t stream_size;       // Content-Length of the full download
+    uint32_t partition_addr;    // Target partition the bytes were written to
+    uint32_t written;           // Image bytes safely in flash, sector aligned
+    char url[200];              // Source, so an interrupted update restarts after reboot
+} ota_journal_t;
+
+/**
+ * @brief Load the journal of the last unfinished download
+ * @return ESP_ERR_NOT_FOUND if there is none
+ */
+esp_err_t ota_journal_load(ota_journal_t *journal);
+
+/**
+ * @brief Persist download progress
+ */
+esp_err_t ota_journal_save(const ota_journal_t *journal);
+
+/**
+ * @brief Forget the unfinished download
+ */
+esp_err_t ota_journal_clear(void);
+
+#endif
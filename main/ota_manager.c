@@ -1,57 +1,51 @@
 #include "ota_manager.h"
 #include "esp_ota_ops.h"
 #include "esp_http_server.h"
-#include "esp_http_client.h"
 #include "esp_log.h"
 #include "esp_app_format.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "led_indicator.h"
+#include "ota_engine.h"
+#include "ota_window.h"
+#include "ota_journal.h"
+#include "ota_job.h"
+#include "ota_peer.h"
+#include "ota_arena.h"
+#include "web_assets.h"
+#include "health_check.h"
+#include "boot_trace.h"
 #include <string.h>
 
 static const char *TAG = "OTA_MGR";
 static httpd_handle_t ota_server = NULL;
 
-// Forward declaration
-static void ota_update_task_wrapper(void *pvParameter);
+// Single-flight guard: every entry point shares one target slot
+static portMUX_TYPE update_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool update_running = false;
+static uint32_t update_generation = 0;  // Bumped by every claim, tells whether the slot changed hands
+
+WEB_ASSET_DECLARE(ota_html_gz);
 
 // Handler untuk halaman OTA
 static esp_err_t ota_page_handler(httpd_req_t *req)
+{
+    return web_asset_send(req, _binary_ota_html_gz_start, _binary_ota_html_gz_end, "text/html");
+}
+
+// The only dynamic part of the portal
+static esp_err_t ota_info_handler(httpd_req_t *req)
 {
     const esp_partition_t *running = esp_ota_get_running_partition();
     const esp_app_desc_t *app_desc = esp_app_get_description();
-    
-    httpd_resp_set_type(req, "text/html");
-    
-    httpd_resp_sendstr_chunk(req, 
-        "<!DOCTYPE html><html><head>"
-        "<meta charset='utf-8'>"
-        "<title>ESP32 OTA</title>"
-        "<style>"
-        "body{font-family:Arial;max-width:600px;margin:50px auto;padding:20px;}"
-        "input[type=text]{width:100%;padding:8px;margin:8px 0;}"
-        "input[type=submit]{background:#4CAF50;color:white;padding:10px 20px;"
-        "border:none;cursor:pointer;}"
-        "</style>"
-        "</head><body>"
-        "<h2>ESP32 OTA Update</h2>"
-    );
-    
-    char info[150];
-    snprintf(info, sizeof(info), 
-        "<p>Partition: <b>%s</b> | Version: <b>%s</b></p>",
-        running->label, app_desc->version);
-    httpd_resp_sendstr_chunk(req, info);
-    
-    httpd_resp_sendstr_chunk(req,
-        "<form action='/update' method='post'>"
-        "Firmware URL:<br>"
-        "<input type='text' name='url' placeholder='http://192.168.x.x:8000/firmware.bin'><br>"
-        "<input type='submit' value='Start Update'>"
-        "</form>"
-        "</body></html>"
-    );
-    
-    httpd_resp_sendstr_chunk(req, NULL);
-    return ESP_OK;
+
+    char json[160];
+    snprintf(json, sizeof(json), "{\"partition\":\"%s\",\"version\":\"%s\",\"idf\":\"%s\"}",
+             running->label, app_desc->version, app_desc->idf_ver);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_sendstr(req, json);
 }
 
 // Handler untuk trigger OTA update
@@ -97,236 +91,278 @@ static esp_err_t ota_update_handler(httpd_req_t *req)
     }
 
     ESP_LOGI(TAG, "OTA URL: %s", url);
-    httpd_resp_sendstr(req, "OTA started! Device will reboot.");
-
-    char *url_copy = strdup(url);
-    if (url_copy) {
-        xTaskCreate(ota_update_task_wrapper, "ota_task", 8192, url_copy, 5, NULL);
+    if (ota_job_submit(url) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OTA queue full");
+        return ESP_FAIL;
     }
+    httpd_resp_sendstr(req, "OTA queued! Progress at /ota/status, device reboots when done.");
 
     return ESP_OK;
 }
 
-static void ota_update_task_wrapper(void *pvParameter)
+static bool ota_update_claim(void)
 {
-    char *url = (char *)pvParameter;
-    ota_update_from_url(url);
-    free(url);
-    vTaskDelete(NULL);
+    taskENTER_CRITICAL(&update_lock);
+    bool claimed = !update_running;
+    update_running = true;
+    if (claimed) {
+        update_generation++;
+    }
+    taskEXIT_CRITICAL(&update_lock);
+    if (!claimed) {
+        ESP_LOGW(TAG, "Another update is already running");
+        return false;
+    }
+
+    // The previous update is done with every buffer
+    ota_arena_reset();
+    return true;
 }
 
-esp_err_t ota_update_from_url(const char *url)
+static void ota_update_release(void)
 {
-    ESP_LOGI(TAG, "=== Starting OTA Update ===");
-    ESP_LOGI(TAG, "URL: %s", url);
-    led_set_mode(LED_MODE_OTA);
-
-    esp_err_t err;
-    esp_ota_handle_t update_handle = 0;
-    const esp_partition_t *update_partition = NULL;
+    taskENTER_CRITICAL(&update_lock);
+    update_running = false;
+    taskEXIT_CRITICAL(&update_lock);
+}
 
-    update_partition = esp_ota_get_next_update_partition(NULL);
-    if (update_partition == NULL) {
-        ESP_LOGE(TAG, "No OTA partition available");
-        led_set_mode(LED_MODE_NORMAL);
-        return ESP_FAIL;
+// Take the claim back after ota_update_release(), but only if nobody else
+// held it in between: otherwise the slot no longer holds our image
+static bool ota_update_reclaim(uint32_t generation)
+{
+    taskENTER_CRITICAL(&update_lock);
+    bool claimed = !update_running && update_generation == generation;
+    if (claimed) {
+        update_running = true;
     }
-    ESP_LOGI(TAG, "Target partition: %s (offset 0x%08lx)", 
-             update_partition->label, update_partition->address);
+    taskEXIT_CRITICAL(&update_lock);
+    return claimed;
+}
 
-    esp_http_client_config_t config = {
-        .url = url,
-        .timeout_ms = 10000,
-        .keep_alive_enable = true,
-        .buffer_size = 1024,
-    };
-    
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (client == NULL) {
-        ESP_LOGE(TAG, "Failed to initialize HTTP client");
-        led_set_mode(LED_MODE_NORMAL);
-        return ESP_FAIL;
-    }
+static bool ota_update_superseded(uint32_t generation)
+{
+    taskENTER_CRITICAL(&update_lock);
+    bool superseded = update_generation != generation;
+    taskEXIT_CRITICAL(&update_lock);
+    return superseded;
+}
 
-    err = esp_http_client_open(client, 0);
+esp_err_t ota_update_from_url(const char *url)
+{
+    ota_update_config_t config = OTA_UPDATE_CONFIG_DEFAULT();
+    config.url = url;
+    return ota_update_start(&config);
+}
+
+
+// Switch otadata to the freshly written slot; the running image stays
+// the boot image if this fails
+static esp_err_t ota_update_activate(const esp_partition_t *update_partition)
+{
+    // Verifies the image in the slot before switching otadata
+    esp_err_t err = esp_ota_set_boot_partition(update_partition);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open connection: %s", esp_err_to_name(err));
-        esp_http_client_cleanup(client);
-        led_set_mode(LED_MODE_NORMAL);
+        ESP_LOGE(TAG, "Failed to set boot partition: %s", esp_err_to_name(err));
         return err;
     }
+    ESP_LOGI(TAG, "=== OTA Update Successful ===");
+    return ESP_OK;
+}
 
-    int content_length = esp_http_client_fetch_headers(client);
-    int status_code = esp_http_client_get_status_code(client);
-    
-    ESP_LOGI(TAG, "HTTP Status: %d, Content Length: %d", status_code, content_length);
+// Only after ota_update_activate() succeeded
+static void ota_update_reboot(void)
+{
+    ESP_LOGI(TAG, "Rebooting in 3 seconds...");
+    vTaskDelay(pdMS_TO_TICKS(3000));
+    esp_restart();
+}
 
-    if (status_code != 200 || content_length <= 0) {
-        ESP_LOGE(TAG, "Invalid HTTP response");
-        esp_http_client_close(client);
-        esp_http_client_cleanup(client);
-        led_set_mode(LED_MODE_NORMAL);
-        return ESP_FAIL;
+// Background updates keep the verified image in the slot until the window
+// opens. The claim is let go meanwhile, so an upload or a queued job can take
+// over the slot instead of waiting for hours; the wait then ends.
+// Returns ESP_OK with the claim held again, anything else without it.
+static esp_err_t ota_update_wait_window(const ota_update_config_t *ota_config)
+{
+    if (ota_window_open()) {
+        return ESP_OK;
+    }
+    ESP_LOGI(TAG, "Image ready, activation waits for the maintenance window");
+    ota_engine_report(ota_config, OTA_PHASE_SCHEDULED, 0, 0);
+    led_set_mode(LED_MODE_NORMAL);
+
+    taskENTER_CRITICAL(&update_lock);
+    uint32_t generation = update_generation;
+    taskEXIT_CRITICAL(&update_lock);
+    ota_update_release();
+
+    while (!ota_window_open()) {
+        if (ota_engine_cancelled(ota_config)) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        if (ota_job_pending() || ota_update_superseded(generation)) {
+            ESP_LOGW(TAG, "Scheduled image superseded by another update");
+            return ESP_ERR_INVALID_STATE;
+        }
+        vTaskDelay(pdMS_TO_TICKS(1000));
     }
+    if (!ota_update_reclaim(generation)) {
+        ESP_LOGW(TAG, "Slot was taken while waiting for the window");
+        return ESP_ERR_INVALID_STATE;
+    }
+    led_set_mode(LED_MODE_OTA);
+    return ESP_OK;
+}
 
-    // Allocate buffer
-    char *buffer = malloc(1024);
-    if (buffer == NULL) {
-        ESP_LOGE(TAG, "Failed to allocate buffer");
-        esp_http_client_close(client);
-        esp_http_client_cleanup(client);
-        led_set_mode(LED_MODE_NORMAL);
-        return ESP_ERR_NO_MEM;
+esp_err_t ota_update_start(const ota_update_config_t *ota_config)
+{
+    if (!ota_update_claim()) {
+        // Someone else owns the slot (e.g. an upload); the caller's job is over
+        ota_engine_report(ota_config, OTA_PHASE_FAILED, 0, 0);
+        return ESP_ERR_INVALID_STATE;
     }
+    ESP_LOGI(TAG, "=== Starting OTA Update ===");
+    ESP_LOGI(TAG, "URL: %s", ota_config->url);
+    led_set_mode(LED_MODE_OTA);
 
-    // Read first chunk to check for custom header
-    int first_read = esp_http_client_read(client, buffer, 44);  // Header size = 44 bytes
-    if (first_read < 44) {
-        ESP_LOGE(TAG, "Failed to read header");
-        free(buffer);
-        esp_http_client_close(client);
-        esp_http_client_cleanup(client);
+    const esp_partition_t *update_partition = esp_ota_get_next_update_partition(NULL);
+    if (update_partition == NULL) {
+        ESP_LOGE(TAG, "No OTA partition available");
         led_set_mode(LED_MODE_NORMAL);
+        ota_update_release();
         return ESP_FAIL;
     }
+    ESP_LOGI(TAG, "Target partition: %s (offset 0x%08lx)", 
+             update_partition->label, update_partition->address);
 
-    // Check for custom header magic (0xDEADBEEF)
-    uint32_t magic = *((uint32_t *)buffer);
-    bool has_custom_header = (magic == 0xDEADBEEF);
-    
-    int header_offset = 0;
-    int actual_fw_size = content_length;
-    
-    if (has_custom_header) {
-        ESP_LOGI(TAG, "Custom header detected (magic: 0x%08lx)", magic);
-        header_offset = 44;  // Skip 44-byte header
-        actual_fw_size = content_length - 44;
-        
-        // Validate SHA256 here if needed
-        uint32_t version = *((uint32_t *)(buffer + 4));
-        uint32_t size = *((uint32_t *)(buffer + 8));
-        ESP_LOGI(TAG, "Header - Version: 0x%08lx, Size: %lu", version, size);
-    } else {
-        ESP_LOGI(TAG, "Raw firmware detected (magic: 0x%02x)", buffer[0]);
+    ota_transport_t transport = {0};
+    bool claimed = true;
+    esp_err_t err = ota_transport_http_init(&transport, ota_config->url);
+    if (err == ESP_OK) {
+        err = ota_engine_run(&transport, ota_config, update_partition);
+        ota_transport_http_deinit(&transport);
+    }
+    if (err == ESP_OK && ota_config->background) {
+        err = ota_update_wait_window(ota_config);
+        claimed = (err == ESP_OK);
+    }
+    if (err == ESP_OK) {
+        err = ota_update_activate(update_partition);
+    }
+    if (err == ESP_OK) {
+        ota_engine_report(ota_config, OTA_PHASE_REBOOTING, 0, 0);
+        ota_update_reboot();
     }
-
-    // Begin OTA
-    err = esp_ota_begin(update_partition, OTA_SIZE_UNKNOWN, &update_handle);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "OTA begin failed: %s", esp_err_to_name(err));
-        free(buffer);
-        esp_http_client_close(client);
-        esp_http_client_cleanup(client);
+        ota_engine_report(ota_config, ota_engine_cancelled(ota_config) ? OTA_PHASE_CANCELLED : OTA_PHASE_FAILED, 0, 0);
         led_set_mode(LED_MODE_NORMAL);
-        return err;
     }
-    ESP_LOGI(TAG, "OTA begin successful");
-
-    int binary_file_length = 0;
-    int last_progress = 0;
-    
-    ESP_LOGI(TAG, "Writing firmware...");
-
-    // If custom header, skip it by not writing first 44 bytes
-    if (has_custom_header) {
-        // Write remaining data from first read (after header)
-        int remaining_first_chunk = first_read - 44;
-        if (remaining_first_chunk > 0) {
-            err = esp_ota_write(update_handle, (const void *)(buffer + 44), remaining_first_chunk);
-            if (err != ESP_OK) {
-                ESP_LOGE(TAG, "OTA write failed: %s", esp_err_to_name(err));
-                esp_ota_abort(update_handle);
-                free(buffer);
-                esp_http_client_close(client);
-                esp_http_client_cleanup(client);
-                led_set_mode(LED_MODE_NORMAL);
-                return err;
-            }
-            binary_file_length += remaining_first_chunk;
-        }
-    } else {
-        // Raw firmware - write first chunk as-is
-        err = esp_ota_write(update_handle, (const void *)buffer, first_read);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "OTA write failed: %s", esp_err_to_name(err));
-            esp_ota_abort(update_handle);
-            free(buffer);
-            esp_http_client_close(client);
-            esp_http_client_cleanup(client);
-            led_set_mode(LED_MODE_NORMAL);
-            return err;
-        }
-        binary_file_length += first_read;
-    }
-
-    // Continue reading and writing
-    while (1) {
-        int data_read = esp_http_client_read(client, buffer, 1024);
-        
-        if (data_read < 0) {
-            ESP_LOGE(TAG, "Error reading data");
-            err = ESP_FAIL;
-            break;
-        } else if (data_read > 0) {
-            err = esp_ota_write(update_handle, (const void *)buffer, data_read);
-            if (err != ESP_OK) {
-                ESP_LOGE(TAG, "OTA write failed: %s", esp_err_to_name(err));
-                break;
-            }
-            binary_file_length += data_read;
-            
-            int progress = (binary_file_length * 100) / actual_fw_size;
-            if (progress >= last_progress + 10) {
-                ESP_LOGI(TAG, "Progress: %d%% (%d / %d bytes)", 
-                         progress, binary_file_length, actual_fw_size);
-                last_progress = progress;
-            }
-        } else if (data_read == 0) {
-            ESP_LOGI(TAG, "Download complete");
-            break;
-        }
+    if (claimed) {
+        ota_update_release();
     }
+    return err;
+}
 
-    free(buffer);
-    esp_http_client_close(client);
-    esp_http_client_cleanup(client);
+// Runs the upload outside the server task, which keeps serving /ota/status
+// and /ota/cancel meanwhile; holds the claim taken by the handler
+static void ota_upload_task(void *pvParameter)
+{
+    httpd_req_t *req = (httpd_req_t *)pvParameter;
+    ESP_LOGI(TAG, "=== Starting OTA Upload (%d bytes) ===", req->content_len);
+    led_set_mode(LED_MODE_OTA);
 
+    // Shows up in /ota/status and honours /ota/cancel like a queued job
+    const esp_partition_t *update_partition = esp_ota_get_next_update_partition(NULL);
+    ota_transport_t transport = {0};
+    ota_update_config_t config = OTA_UPDATE_CONFIG_DEFAULT();
+    ota_job_bind(&config, "upload");
+    esp_err_t err = ota_transport_upload_init(&transport, req);
+    if (err == ESP_OK) {
+        err = ota_engine_run(&transport, &config, update_partition);
+    }
+    // The client only hears OK once the slot is the boot partition
+    if (err == ESP_OK) {
+        err = ota_update_activate(update_partition);
+    }
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Download failed");
-        esp_ota_abort(update_handle);
+        ota_engine_report(&config, ota_engine_cancelled(&config) ? OTA_PHASE_CANCELLED : OTA_PHASE_FAILED, 0, 0);
+        ota_job_finished(err);
         led_set_mode(LED_MODE_NORMAL);
-        return err;
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, esp_err_to_name(err));
+        httpd_req_async_handler_complete(req);
+        ota_update_release();
+        vTaskDelete(NULL);
+        return;
     }
 
-    ESP_LOGI(TAG, "Total firmware bytes written: %d", binary_file_length);
+    ota_engine_report(&config, OTA_PHASE_REBOOTING, 0, 0);
+    httpd_resp_sendstr(req, "Upload OK! Device will reboot.");
+    httpd_req_async_handler_complete(req);
+    ota_update_reboot();
+}
 
-    err = esp_ota_end(update_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "OTA end failed: %s", esp_err_to_name(err));
-        led_set_mode(LED_MODE_NORMAL);
-        return err;
+esp_err_t ota_upload_handler(httpd_req_t *req)
+{
+    if (!ota_update_claim()) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Another update is running");
+        return ESP_FAIL;
+    }
+    if (esp_ota_get_next_update_partition(NULL) == NULL) {
+        ESP_LOGE(TAG, "No OTA partition available");
+        ota_update_release();
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "No OTA partition");
+        return ESP_FAIL;
     }
 
-    err = esp_ota_set_boot_partition(update_partition);
+    // Receive and flash from a separate task, the server task stays free
+    httpd_req_t *async_req = NULL;
+    esp_err_t err = httpd_req_async_handler_begin(req, &async_req);
+    if (err == ESP_OK && xTaskCreate(ota_upload_task, "ota_upload", 8192, async_req,
+                                     OTA_JOB_PRIORITY, NULL) != pdPASS) {
+        httpd_resp_send_err(async_req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        httpd_req_async_handler_complete(async_req);
+        err = ESP_ERR_NO_MEM;
+    }
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to set boot partition: %s", esp_err_to_name(err));
-        led_set_mode(LED_MODE_NORMAL);
-        return err;
+        ESP_LOGE(TAG, "Failed to start upload worker: %s", esp_err_to_name(err));
+        ota_update_release();
     }
+    return err;
+}
 
-    ESP_LOGI(TAG, "=== OTA Update Successful ===");
-    ESP_LOGI(TAG, "Rebooting in 3 seconds...");
-    
-    vTaskDelay(pdMS_TO_TICKS(3000));
-    esp_restart();
+void ota_manager_resume_interrupted(void)
+{
+    // Both the startup and the health check path may get here, resume once
+    static bool resume_checked = false;
+    taskENTER_CRITICAL(&update_lock);
+    bool first = ota_server != NULL && !resume_checked;
+    if (first) {
+        resume_checked = true;
+    }
+    taskEXIT_CRITICAL(&update_lock);
+    if (!first) {
+        return;
+    }
 
-    return ESP_OK;
+    ota_journal_t journal;
+    if (ota_journal_load(&journal) == ESP_OK && journal.url[0] != '\0') {
+        ESP_LOGI(TAG, "Resuming interrupted OTA from %s", journal.url);
+        ota_job_submit(journal.url);
+    }
+}
+
+bool ota_manager_is_running(void)
+{
+    return ota_server != NULL;
 }
 
 esp_err_t ota_manager_start(void)
 {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.server_port = 80;
+    config.max_uri_handlers = 12;
+
+    ota_job_init();
+    ota_window_init();
 
     if (httpd_start(&ota_server, &config) == ESP_OK) {
         httpd_uri_t ota_page = {
@@ -336,6 +372,13 @@ esp_err_t ota_manager_start(void)
         };
         httpd_register_uri_handler(ota_server, &ota_page);
 
+        httpd_uri_t ota_info = {
+            .uri       = "/info",
+            .method    = HTTP_GET,
+            .handler   = ota_info_handler,
+        };
+        httpd_register_uri_handler(ota_server, &ota_info);
+
         httpd_uri_t ota_update = {
             .uri       = "/update",
             .method    = HTTP_POST,
@@ -343,7 +386,26 @@ esp_err_t ota_manager_start(void)
         };
         httpd_register_uri_handler(ota_server, &ota_update);
 
+        httpd_uri_t ota_upload = {
+            .uri       = "/upload",
+            .method    = HTTP_POST,
+            .handler   = ota_upload_handler,
+        };
+        httpd_register_uri_handler(ota_server, &ota_upload);
+
+        ota_job_register_handlers(ota_server);
+        boot_trace_register_handlers(ota_server);
+#if OTA_PEER_SERVE
+        ota_peer_register_handlers(ota_server);
+#endif
+
         ESP_LOGI(TAG, "OTA server started on port 80");
+
+        // Not while this image is still being validated: the slot cannot be
+        // opened until then, the health check calls back once it passes
+        if (!health_check_pending()) {
+            ota_manager_resume_interrupted();
+        }
         return ESP_OK;
     }
 
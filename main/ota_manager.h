@@ -1,7 +1,101 @@
 #ifndef OTA_MANAGER_H
 #define OTA_MANAGER_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include "esp_err.h"
+#include "esp_http_server.h"
+
+// Download pipeline: the network task fills slots while a flash task drains them
+#ifndef OTA_RING_SLOT_SIZE
+#define OTA_RING_SLOT_SIZE   4096   // Bytes per slot (one flash sector)
+#endif
+#ifndef OTA_RING_SLOT_COUNT
+#define OTA_RING_SLOT_COUNT  4      // Slots in flight between network and flash
+#endif
+
+// Segmented download: >1 fetches byte ranges over that many connections
+#ifndef OTA_PARALLEL_CONNECTIONS
+#define OTA_PARALLEL_CONNECTIONS 1
+#endif
+#ifndef OTA_SEGMENT_SIZE
+#define OTA_SEGMENT_SIZE     (16 * 1024)    // Reorder buffer per connection
+#endif
+
+// One budget for every buffer an update needs, reserved once at startup (ota_arena.h)
+#ifndef OTA_ARENA_SIZE
+#define OTA_ARENA_SIZE       (64 * 1024 + (OTA_PARALLEL_CONNECTIONS > 1 ? \
+                              OTA_PARALLEL_CONNECTIONS * OTA_SEGMENT_SIZE : 0))
+#endif
+#ifndef OTA_ARENA_PSRAM
+#define OTA_ARENA_PSRAM      0      // Put the bulk of the arena in PSRAM when present
+#endif
+
+// Background mode (ota_update_config_t.background): trickle the image in
+// without starving the application's traffic, activate in the window (ota_window.h)
+#ifndef OTA_BACKGROUND_RATE
+#define OTA_BACKGROUND_RATE     (32 * 1024)    // Bytes/s read from the network
+#endif
+#ifndef OTA_BACKGROUND_BURST
+#define OTA_BACKGROUND_BURST    (8 * 1024)     // Token bucket depth
+#endif
+#ifndef OTA_BACKGROUND_PRIORITY
+#define OTA_BACKGROUND_PRIORITY 2              // Download and flash tasks, foreground runs at 5
+#endif
+
+// Compare each sector with the slot before erasing; saves wear on retries
+#ifndef OTA_SKIP_UNCHANGED
+#define OTA_SKIP_UNCHANGED   0
+#endif
+
+typedef struct {
+    uint32_t image_bytes;       // Firmware bytes written to the slot
+    uint32_t sectors_written;   // Sectors erased and programmed
+    uint32_t sectors_skipped;   // Sectors left alone because they matched
+} ota_update_result_t;
+
+typedef enum {
+    OTA_PHASE_IDLE,
+    OTA_PHASE_QUEUED,
+    OTA_PHASE_CONNECTING,
+    OTA_PHASE_DOWNLOADING,
+    OTA_PHASE_VERIFYING,
+    OTA_PHASE_SCHEDULED,        // Verified, waiting for the maintenance window
+    OTA_PHASE_REBOOTING,
+    OTA_PHASE_FAILED,
+    OTA_PHASE_CANCELLED,
+} ota_phase_t;
+
+/**
+ * @brief Progress hook, called from the OTA task
+ * @param done Firmware bytes decoded so far
+ * @param total Firmware size, 0 until the header has been read
+ */
+typedef void (*ota_progress_cb_t)(ota_phase_t phase, int done, int total, void *arg);
+
+typedef struct {
+    const char *url;            // Firmware URL (http/https)
+    int connections;            // Parallel Range connections, 1 = single stream
+    bool skip_unchanged;        // Skip sectors the slot already holds
+    ota_update_result_t *result; // Optional, filled in once flashing completes
+    ota_progress_cb_t progress; // Optional
+    void *progress_arg;
+    const volatile bool *cancel; // Optional, abort the download when it turns true
+    uint32_t min_version;       // Reject headers older than this (major << 16 | minor << 8 | patch), 0 = any
+    bool background;            // Throttle to OTA_BACKGROUND_RATE, activate only in the window
+} ota_update_config_t;
+
+#define OTA_UPDATE_CONFIG_DEFAULT() { \
+    .url = NULL, \
+    .connections = OTA_PARALLEL_CONNECTIONS, \
+    .skip_unchanged = OTA_SKIP_UNCHANGED, \
+    .result = NULL, \
+    .progress = NULL, \
+    .progress_arg = NULL, \
+    .cancel = NULL, \
+    .min_version = 0, \
+    .background = false, \
+}
 
 /**
  * @brief Start OTA manager
@@ -9,11 +103,39 @@
  */
 esp_err_t ota_manager_start(void);
 
+/**
+ * @brief True once the OTA HTTP server is accepting requests
+ */
+bool ota_manager_is_running(void);
+
+/**
+ * @brief Queue the download a reset cut off, if the journal holds one
+ * Called by ota_manager_start() and, when the image was still being
+ * validated then, by the health check once it passes. Acts only once,
+ * and only after the server has started.
+ */
+void ota_manager_resume_interrupted(void);
+
 /**
  * @brief Perform OTA update from URL
  * @param url Firmware URL (http/https)
  */
 esp_err_t ota_update_from_url(const char *url);
 
+/**
+ * @brief Perform OTA update with explicit download options
+ * Only one update runs at a time; a second caller gets ESP_ERR_INVALID_STATE.
+ */
+esp_err_t ota_update_start(const ota_update_config_t *config);
+
+/**
+ * @brief HTTP handler that flashes the POST body as a firmware image
+ * Accepts the same raw/header/compressed/delta formats as the pull path,
+ * streamed into flash without buffering the image. The update runs in its
+ * own task (async request), so the server keeps answering /ota/status and
+ * /ota/cancel. Reboots on success.
+ */
+esp_err_t ota_upload_handler(httpd_req_t *req);
+
 
 #endif
\ No newline at end of file
@@ -0,0 +1,293 @@
+#include "ota_peer.h"
+#include "ota_arena.h"
+#include "ota_header.h"
+#include "esp_ota_ops.h"
+#include "esp_image_format.h"
+#include "esp_app_desc.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "mbedtls/sha256.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "OTA_PEER";
+
+// What a peer downloads: header + the running image, exactly as image_len bytes
+typedef struct {
+    const esp_partition_t *partition;
+    uint32_t image_len;
+    ota_header_t header;
+    char etag[67];              // Quoted hex SHA-256
+} ota_peer_image_t;
+
+// One per concurrent download; the chunk buffer is pinned in the OTA arena
+typedef struct {
+    httpd_req_t *req;
+    uint8_t *buf;               // OTA_PEER_CHUNK_SIZE
+    bool busy;
+} ota_peer_client_t;
+
+static portMUX_TYPE peer_lock = portMUX_INITIALIZER_UNLOCKED;
+static ota_peer_client_t peer_clients[OTA_PEER_MAX_CLIENTS];
+static SemaphoreHandle_t image_mutex = NULL;
+static ota_peer_image_t image;
+static bool image_ready = false;
+
+// Caller holds image_mutex. Hashes the image once, later calls only check state.
+static esp_err_t ota_peer_describe(uint8_t *buf)
+{
+    const esp_partition_t *running = esp_ota_get_running_partition();
+
+    // Never spread an image that may still roll back; factory has no OTA state
+    esp_ota_img_states_t state;
+    if (esp_ota_get_state_partition(running, &state) == ESP_OK &&
+        state != ESP_OTA_IMG_VALID && state != ESP_OTA_IMG_UNDEFINED) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (image_ready) {
+        return ESP_OK;
+    }
+
+    esp_partition_pos_t pos = { .offset = running->address, .size = running->size };
+    esp_image_metadata_t metadata;
+    esp_err_t err = esp_image_get_metadata(&pos, &metadata);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to read image metadata: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    // Same digest prepare-firmware.py writes: the whole .bin, appended hash included
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    for (uint32_t offset = 0; offset < metadata.image_len && err == ESP_OK; offset += OTA_PEER_CHUNK_SIZE) {
+        uint32_t n = metadata.image_len - offset;
+        if (n > OTA_PEER_CHUNK_SIZE) {
+            n = OTA_PEER_CHUNK_SIZE;
+        }
+        err = esp_partition_read(running, offset, buf, n);
+        if (err == ESP_OK) {
+            mbedtls_sha256_update(&sha, buf, n);
+        }
+    }
+    mbedtls_sha256_finish(&sha, image.header.sha256);
+    mbedtls_sha256_free(&sha);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to hash running image: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    image.partition = running;
+    image.image_len = metadata.image_len;
+    image.header.magic = OTA_HEADER_MAGIC;
+    image.header.version = ota_header_version_from_string(esp_app_get_description()->version);
+    image.header.size = metadata.image_len;
+
+    char *p = image.etag;
+    *p++ = '"';
+    for (int i = 0; i < sizeof(image.header.sha256); i++) {
+        p += sprintf(p, "%02x", image.header.sha256[i]);
+    }
+    *p++ = '"';
+    *p = '\0';
+
+    image_ready = true;
+    ESP_LOGI(TAG, "Serving %s (%lu bytes) as %s", running->label,
+             (unsigned long)image.image_len, image.etag);
+    return ESP_OK;
+}
+
+/**
+ * Single range only: "bytes=first-" or "bytes=first-last".
+ * Returns 0 without a Range header, 1 for a valid range, -1 if unsatisfiable.
+ */
+static int ota_peer_parse_range(httpd_req_t *req, uint32_t total, uint32_t *first, uint32_t *last)
+{
+    char range[48];
+    if (httpd_req_get_hdr_value_str(req, "Range", range, sizeof(range)) != ESP_OK) {
+        return 0;
+    }
+
+    unsigned long a, b;
+    int fields = sscanf(range, "bytes=%lu-%lu", &a, &b);
+    if (fields < 1) {
+        return 0;   // Unsupported form, serve the whole body
+    }
+    if (fields == 1 || b >= total) {
+        b = total - 1;
+    }
+    if (a >= total || a > b) {
+        return -1;
+    }
+    *first = a;
+    *last = b;
+    return 1;
+}
+
+static esp_err_t ota_peer_send_all(httpd_req_t *req, const char *buf, size_t len)
+{
+    while (len > 0) {
+        int sent = httpd_send(req, buf, len);
+        if (sent <= 0) {
+            // The peer resumes with a Range request
+            return ESP_FAIL;
+        }
+        buf += sent;
+        len -= sent;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t ota_peer_serve(ota_peer_client_t *client)
+{
+    httpd_req_t *req = client->req;
+    uint8_t *buf = client->buf;
+
+    xSemaphoreTake(image_mutex, portMAX_DELAY);
+    esp_err_t err = ota_peer_describe(buf);
+    xSemaphoreGive(image_mutex);
+    if (err != ESP_OK) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_sendstr(req, "Running image not validated");
+    }
+
+    char if_none_match[sizeof(image.etag)];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+        strcmp(if_none_match, image.etag) == 0) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        httpd_resp_set_hdr(req, "ETag", image.etag);
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    uint32_t total = OTA_HEADER_SIZE + image.image_len;
+    uint32_t first = 0, last = total - 1;
+    int ranged = ota_peer_parse_range(req, total, &first, &last);
+    if (ranged < 0) {
+        httpd_resp_set_status(req, "416 Range Not Satisfiable");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    // Raw response: httpd_resp_* would switch to chunked encoding, and the
+    // OTA client needs a Content-Length to resume
+    char head[320];
+    int head_len = snprintf(head, sizeof(head),
+                            "HTTP/1.1 %s\r\n"
+                            "Content-Type: application/octet-stream\r\n"
+                            "Content-Length: %lu\r\n"
+                            "Accept-Ranges: bytes\r\n"
+                            "ETag: %s\r\n",
+                            ranged ? "206 Partial Content" : "200 OK",
+                            (unsigned long)(last - first + 1), image.etag);
+    if (ranged) {
+        head_len += snprintf(head + head_len, sizeof(head) - head_len,
+                             "Content-Range: bytes %lu-%lu/%lu\r\n",
+                             (unsigned long)first, (unsigned long)last, (unsigned long)total);
+    }
+    head_len += snprintf(head + head_len, sizeof(head) - head_len, "\r\n");
+    err = ota_peer_send_all(req, head, head_len);
+
+    // Reconstructed header first, then the image straight from flash
+    uint32_t offset = first;
+    if (err == ESP_OK && offset < OTA_HEADER_SIZE) {
+        uint32_t end = last < OTA_HEADER_SIZE ? last + 1 : OTA_HEADER_SIZE;
+        err = ota_peer_send_all(req, (const char *)&image.header + offset, end - offset);
+        offset = end;
+    }
+
+    while (err == ESP_OK && offset <= last) {
+        uint32_t n = last + 1 - offset;
+        if (n > OTA_PEER_CHUNK_SIZE) {
+            n = OTA_PEER_CHUNK_SIZE;
+        }
+        err = esp_partition_read(image.partition, offset - OTA_HEADER_SIZE, buf, n);
+        if (err == ESP_OK) {
+            err = ota_peer_send_all(req, (const char *)buf, n);
+        }
+        offset += n;
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Peer download aborted at %lu: %s", (unsigned long)offset, esp_err_to_name(err));
+    }
+    return err;
+}
+
+static void ota_peer_release(ota_peer_client_t *client)
+{
+    taskENTER_CRITICAL(&peer_lock);
+    client->req = NULL;
+    client->busy = false;
+    taskEXIT_CRITICAL(&peer_lock);
+}
+
+static void ota_peer_task(void *pvParameter)
+{
+    ota_peer_client_t *client = (ota_peer_client_t *)pvParameter;
+
+    ota_peer_serve(client);
+    httpd_req_async_handler_complete(client->req);
+    ota_peer_release(client);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t ota_peer_handler(httpd_req_t *req)
+{
+    ota_peer_client_t *client = NULL;
+    taskENTER_CRITICAL(&peer_lock);
+    for (int i = 0; i < OTA_PEER_MAX_CLIENTS; i++) {
+        if (!peer_clients[i].busy && peer_clients[i].buf != NULL) {
+            client = &peer_clients[i];
+            client->busy = true;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&peer_lock);
+
+    if (client == NULL) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "30");
+        return httpd_resp_sendstr(req, "Busy serving other peers");
+    }
+
+    // Stream from a separate task, the server task stays free
+    httpd_req_t *async_req = NULL;
+    esp_err_t err = httpd_req_async_handler_begin(req, &async_req);
+    client->req = async_req;
+    if (err == ESP_OK && xTaskCreate(ota_peer_task, "ota_peer", 4096, client, 4, NULL) != pdPASS) {
+        httpd_resp_send_err(async_req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        httpd_req_async_handler_complete(async_req);
+        err = ESP_ERR_NO_MEM;
+    }
+    if (err != ESP_OK) {
+        ota_peer_release(client);
+    }
+    return err;
+}
+
+esp_err_t ota_peer_register_handlers(httpd_handle_t server)
+{
+    if (image_mutex == NULL) {
+        image_mutex = xSemaphoreCreateMutex();
+        if (image_mutex == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    // Before the first update allocates, so the buffers stay pinned
+    for (int i = 0; i < OTA_PEER_MAX_CLIENTS; i++) {
+        if (peer_clients[i].buf == NULL) {
+            peer_clients[i].buf = ota_arena_alloc_pinned(OTA_PEER_CHUNK_SIZE);
+            if (peer_clients[i].buf == NULL) {
+                return ESP_ERR_NO_MEM;
+            }
+        }
+    }
+
+    httpd_uri_t firmware_uri = {
+        .uri       = "/firmware.bin",
+        .method    = HTTP_GET,
+        .handler   = ota_peer_handler,
+    };
+    return httpd_register_uri_handler(server, &firmware_uri);
+}
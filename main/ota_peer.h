@@ -0,0 +1,33 @@
+#ifndef OTA_PEER_H
+#define OTA_PEER_H
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+/**
+ * Peer distribution: a device that runs a validated image serves it at
+ * GET /firmware.bin in the prepare-firmware.py container format, so
+ * neighbours can update from it (POST /update with url=http://<peer>/firmware.bin)
+ * instead of all pulling from the central server. Supports Range (resume and
+ * segmented downloads) and If-None-Match against an ETag of the image hash.
+ */
+
+#ifndef OTA_PEER_SERVE
+#define OTA_PEER_SERVE        0       // Register GET /firmware.bin on the OTA server
+#endif
+#ifndef OTA_PEER_MAX_CLIENTS
+#define OTA_PEER_MAX_CLIENTS  2       // Concurrent downloads served, others get 503
+#endif
+#define OTA_PEER_CHUNK_SIZE   4096    // Partition read / socket send granularity
+
+// One chunk buffer per client, pinned in the OTA arena (ota_arena.h)
+#define OTA_PEER_ARENA_SIZE   (OTA_PEER_SERVE ? OTA_PEER_MAX_CLIENTS * OTA_PEER_CHUNK_SIZE : 0)
+
+/**
+ * @brief Register GET /firmware.bin on server
+ * Each download is handed to its own task so the server keeps answering
+ * other requests while an image is streamed.
+ */
+esp_err_t ota_peer_register_handlers(httpd_handle_t server);
+
+#endif
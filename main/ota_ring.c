@@ -0,0 +1,92 @@
+#include "ota_ring.h"
+#include "ota_arena.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+} ota_slot_t;
+
+struct ota_ring {
+    ota_slot_t *slots;
+    size_t slot_size;
+    size_t slot_count;
+    size_t head;                // Next slot the producer fills
+    size_t tail;                // Next slot the consumer drains
+    SemaphoreHandle_t free_slots;
+    SemaphoreHandle_t filled_slots;
+};
+
+ota_ring_t *ota_ring_create(size_t slot_size, size_t slot_count)
+{
+    ota_ring_t *ring = ota_arena_alloc(sizeof(*ring));
+    if (ring == NULL) {
+        return NULL;
+    }
+
+    ring->slot_size = slot_size;
+    ring->slot_count = slot_count;
+    ring->slots = ota_arena_alloc(slot_count * sizeof(ota_slot_t));
+    ring->free_slots = xSemaphoreCreateCounting(slot_count, slot_count);
+    ring->filled_slots = xSemaphoreCreateCounting(slot_count, 0);
+    if (ring->slots == NULL || ring->free_slots == NULL || ring->filled_slots == NULL) {
+        ota_ring_delete(ring);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < slot_count; i++) {
+        ring->slots[i].buf = ota_arena_alloc(slot_size);
+        if (ring->slots[i].buf == NULL) {
+            ota_ring_delete(ring);
+            return NULL;
+        }
+    }
+
+    return ring;
+}
+
+void ota_ring_delete(ota_ring_t *ring)
+{
+    if (ring == NULL) {
+        return;
+    }
+    if (ring->free_slots) {
+        vSemaphoreDelete(ring->free_slots);
+    }
+    if (ring->filled_slots) {
+        vSemaphoreDelete(ring->filled_slots);
+    }
+    // Buffers go back with the arena
+}
+
+size_t ota_ring_slot_size(const ota_ring_t *ring)
+{
+    return ring->slot_size;
+}
+
+uint8_t *ota_ring_acquire(ota_ring_t *ring)
+{
+    xSemaphoreTake(ring->free_slots, portMAX_DELAY);
+    return ring->slots[ring->head].buf;
+}
+
+void ota_ring_commit(ota_ring_t *ring, size_t len)
+{
+    ring->slots[ring->head].len = len;
+    ring->head = (ring->head + 1) % ring->slot_count;
+    xSemaphoreGive(ring->filled_slots);
+}
+
+const uint8_t *ota_ring_peek(ota_ring_t *ring, size_t *len)
+{
+    xSemaphoreTake(ring->filled_slots, portMAX_DELAY);
+    *len = ring->slots[ring->tail].len;
+    return ring->slots[ring->tail].buf;
+}
+
+void ota_ring_release(ota_ring_t *ring)
+{
+    ring->tail = (ring->tail + 1) % ring->slot_count;
+    xSemaphoreGive(ring->free_slots);
+}
@@ -0,0 +1,52 @@
+#ifndef OTA_RING_H
+#define OTA_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Bounded single-producer / single-consumer ring of fixed-size slots.
+ * The network task fills slots while the flash task drains them, so
+ * TCP reads and flash erase/program overlap instead of alternating.
+ */
+typedef struct ota_ring ota_ring_t;
+
+/**
+ * @brief Allocate a ring of slot_count buffers, slot_size bytes each
+ * @return NULL on allocation failure
+ */
+ota_ring_t *ota_ring_create(size_t slot_size, size_t slot_count);
+
+/**
+ * @brief Free the ring and all slot buffers
+ */
+void ota_ring_delete(ota_ring_t *ring);
+
+/**
+ * @brief Size in bytes of every slot
+ */
+size_t ota_ring_slot_size(const ota_ring_t *ring);
+
+/**
+ * @brief Producer: wait for an empty slot and return its buffer
+ */
+uint8_t *ota_ring_acquire(ota_ring_t *ring);
+
+/**
+ * @brief Producer: publish the acquired slot holding len bytes
+ * A zero-length commit marks end of stream.
+ */
+void ota_ring_commit(ota_ring_t *ring, size_t len);
+
+/**
+ * @brief Consumer: wait for a filled slot
+ * @param len Number of valid bytes (0 = end of stream)
+ */
+const uint8_t *ota_ring_peek(ota_ring_t *ring, size_t *len);
+
+/**
+ * @brief Consumer: hand the peeked slot back to the producer
+ */
+void ota_ring_release(ota_ring_t *ring);
+
+#endif
@@ -0,0 +1,220 @@
+#include "ota_segfetch.h"
+#include "ota_arena.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "OTA_SEGFETCH";
+
+#define SEGMENT_RETRIES 3
+
+typedef struct {
+    ota_segfetch_t *fetch;
+    esp_http_client_handle_t client;    // Created with the worker, reconnects as needed
+    int index;                  // First segment this worker owns
+    uint8_t *buf;               // One segment, the worker's whole reorder budget
+    int len;                    // Bytes in buf, <0 if the segment failed
+    SemaphoreHandle_t ready;    // Worker -> consumer: buf holds the next owned segment
+    SemaphoreHandle_t free;     // Consumer -> worker: buf may be refilled
+} segfetch_worker_t;
+
+struct ota_segfetch {
+    const char *url;
+    int offset;
+    int end;
+    size_t segment_size;
+    int segment_count;
+    int next_segment;           // Next segment handed to the consumer
+    int stride;                 // Planned worker count, segment i belongs to worker i % stride
+    int connections;            // Workers running
+    int worker_count;           // Entries allocated in workers
+    volatile bool abort;
+    SemaphoreHandle_t exited;   // Given once by every worker on exit
+    segfetch_worker_t *workers;
+};
+
+// Fetch [start, start + len) on an open keep-alive connection
+static int fetch_range(esp_http_client_handle_t client, int start, int len, uint8_t *buf)
+{
+    char range[48];
+    snprintf(range, sizeof(range), "bytes=%d-%d", start, start + len - 1);
+    esp_http_client_set_header(client, "Range", range);
+
+    if (esp_http_client_open(client, 0) != ESP_OK) {
+        return -1;
+    }
+    int content_length = esp_http_client_fetch_headers(client);
+    if (esp_http_client_get_status_code(client) != 206 || content_length != len) {
+        ESP_LOGE(TAG, "Range %s rejected (status %d, length %d)", range,
+                 esp_http_client_get_status_code(client), content_length);
+        return -1;
+    }
+
+    int total = 0;
+    while (total < len) {
+        int data_read = esp_http_client_read(client, (char *)buf + total, len - total);
+        if (data_read <= 0) {
+            break;
+        }
+        total += data_read;
+    }
+    return total;
+}
+
+static void segfetch_worker_task(void *pvParameter)
+{
+    segfetch_worker_t *w = (segfetch_worker_t *)pvParameter;
+    ota_segfetch_t *fetch = w->fetch;
+    esp_http_client_handle_t client = w->client;
+
+    // Parked until ota_segfetch_start() hands out the range; after that each
+    // free buffer is the go-ahead for the next owned segment
+    for (int seg = w->index; ; seg += fetch->stride) {
+        xSemaphoreTake(w->free, portMAX_DELAY);
+        if (fetch->abort || seg >= fetch->segment_count) {
+            break;
+        }
+
+        int start = fetch->offset + seg * fetch->segment_size;
+        int len = fetch->end - start < (int)fetch->segment_size ? fetch->end - start
+                                                                 : (int)fetch->segment_size;
+        int got = 0;
+        for (int attempt = 0; attempt < SEGMENT_RETRIES && got < len && !fetch->abort; attempt++) {
+            int n = fetch_range(client, start + got, len - got, w->buf + got);
+            if (n > 0) {
+                got += n;
+            }
+            if (got < len) {
+                // Drop the broken connection, the next attempt reconnects
+                esp_http_client_close(client);
+            }
+        }
+
+        w->len = (got == len) ? len : -1;
+        xSemaphoreGive(w->ready);
+        if (w->len < 0) {
+            ESP_LOGE(TAG, "Segment %d failed", seg);
+            break;
+        }
+    }
+
+    esp_http_client_close(client);
+    xSemaphoreGive(fetch->exited);
+    vTaskDelete(NULL);
+}
+
+ota_segfetch_t *ota_segfetch_create(const char *url, int connections, size_t segment_size)
+{
+    ota_segfetch_t *fetch = ota_arena_alloc(sizeof(*fetch));
+    if (fetch == NULL) {
+        return NULL;
+    }
+    fetch->url = url;
+    fetch->segment_size = segment_size;
+    fetch->workers = ota_arena_alloc(connections * sizeof(segfetch_worker_t));
+    fetch->worker_count = fetch->workers ? connections : 0;
+    fetch->stride = connections;
+    fetch->exited = xSemaphoreCreateCounting(connections, 0);
+    if (fetch->workers == NULL || fetch->exited == NULL) {
+        ota_segfetch_stop(fetch);
+        return NULL;
+    }
+
+    // Clients are only initialised here, connections open once segments are fetched
+    esp_http_client_config_t config = {
+        .url = url,
+        .timeout_ms = 10000,
+        .keep_alive_enable = true,
+        .buffer_size = 1024,
+    };
+    for (int i = 0; i < connections; i++) {
+        segfetch_worker_t *w = &fetch->workers[i];
+        w->fetch = fetch;
+        w->index = i;
+        w->buf = ota_arena_alloc(segment_size);
+        w->ready = xSemaphoreCreateBinary();
+        w->free = xSemaphoreCreateBinary();
+        w->client = esp_http_client_init(&config);
+        if (w->buf == NULL || w->ready == NULL || w->free == NULL || w->client == NULL) {
+            ota_segfetch_stop(fetch);
+            return NULL;
+        }
+        if (xTaskCreate(segfetch_worker_task, "ota_seg", 4096, w, 5, NULL) != pdPASS) {
+            ota_segfetch_stop(fetch);
+            return NULL;
+        }
+        fetch->connections++;
+    }
+    return fetch;
+}
+
+void ota_segfetch_start(ota_segfetch_t *fetch, int offset, int end)
+{
+    fetch->offset = offset;
+    fetch->end = end;
+    fetch->segment_count = (end - offset + fetch->segment_size - 1) / fetch->segment_size;
+    ESP_LOGI(TAG, "%d segments of %u bytes over %d connections (%u bytes buffered)",
+             fetch->segment_count, (unsigned)fetch->segment_size, fetch->connections,
+             (unsigned)(fetch->segment_size * fetch->connections));
+    for (int i = 0; i < fetch->connections; i++) {
+        xSemaphoreGive(fetch->workers[i].free);
+    }
+}
+
+int ota_segfetch_next(ota_segfetch_t *fetch, const uint8_t **data)
+{
+    if (fetch->next_segment >= fetch->segment_count) {
+        return 0;
+    }
+    segfetch_worker_t *w = &fetch->workers[fetch->next_segment % fetch->stride];
+    xSemaphoreTake(w->ready, portMAX_DELAY);
+    if (w->len < 0) {
+        return -1;
+    }
+    *data = w->buf;
+    return w->len;
+}
+
+void ota_segfetch_release(ota_segfetch_t *fetch)
+{
+    segfetch_worker_t *w = &fetch->workers[fetch->next_segment % fetch->stride];
+    fetch->next_segment++;
+    xSemaphoreGive(w->free);
+}
+
+void ota_segfetch_stop(ota_segfetch_t *fetch)
+{
+    if (fetch == NULL) {
+        return;
+    }
+
+    // Wake workers waiting for a free buffer and wait until all have exited
+    fetch->abort = true;
+    for (int i = 0; i < fetch->connections; i++) {
+        xSemaphoreGive(fetch->workers[i].free);
+    }
+    for (int i = 0; i < fetch->connections; i++) {
+        xSemaphoreTake(fetch->exited, portMAX_DELAY);
+    }
+
+    for (int i = 0; fetch->workers && i < fetch->worker_count; i++) {
+        segfetch_worker_t *w = &fetch->workers[i];
+        if (w->ready) {
+            vSemaphoreDelete(w->ready);
+        }
+        if (w->free) {
+            vSemaphoreDelete(w->free);
+        }
+        if (w->client) {
+            esp_http_client_cleanup(w->client);
+        }
+    }
+    if (fetch->exited) {
+        vSemaphoreDelete(fetch->exited);
+    }
+    // Buffers go back with the arena
+}
@@ -0,0 +1,47 @@
+#ifndef OTA_SEGFETCH_H
+#define OTA_SEGFETCH_H
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Segmented download over several concurrent HTTP connections.
+ *
+ * The byte range [offset, end) is cut into fixed-size segments. Worker i
+ * fetches segments i, i+N, i+2N, ... with Range requests into its own
+ * buffer, and ota_segfetch_next() hands them out strictly in order.
+ * Reorder memory is therefore bounded to connections * segment_size.
+ */
+typedef struct ota_segfetch ota_segfetch_t;
+
+/**
+ * @brief Set up workers, buffers and HTTP clients for url, nothing is fetched yet
+ * Called during update setup, so nothing is allocated once data streams.
+ * @return NULL if workers, buffers or clients could not be allocated
+ */
+ota_segfetch_t *ota_segfetch_create(const char *url, int connections, size_t segment_size);
+
+/**
+ * @brief Let the workers fetch url[offset, end)
+ */
+void ota_segfetch_start(ota_segfetch_t *fetch, int offset, int end);
+
+/**
+ * @brief Wait for the next segment in stream order
+ * @param data Set to the segment bytes, valid until ota_segfetch_release()
+ * @return Segment length, 0 when all segments were delivered, <0 on failure
+ */
+int ota_segfetch_next(ota_segfetch_t *fetch, const uint8_t **data);
+
+/**
+ * @brief Return the buffer of the last segment to its worker
+ */
+void ota_segfetch_release(ota_segfetch_t *fetch);
+
+/**
+ * @brief Stop all workers and free the fetcher
+ */
+void ota_segfetch_stop(ota_segfetch_t *fetch);
+
+#endif
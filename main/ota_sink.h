@@ -0,0 +1,19 @@
+#ifndef OTA_SINK_H
+#define OTA_SINK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * Destination of decoded firmware bytes. The flash writer task only calls
+ * through this, so the pipeline can drain into something other than an
+ * OTA partition (ota_flash provides the on-device implementation).
+ */
+typedef struct {
+    esp_err_t (*write)(void *ctx, const uint8_t *data, size_t len);
+    esp_err_t (*finish)(void *ctx);     // Flush buffered bytes after the last write
+    void *ctx;
+} ota_sink_t;
+
+#endif
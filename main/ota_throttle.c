@@ -0,0 +1,27 @@
+#include "ota_throttle.h"
+
+void ota_throttle_init(ota_throttle_t *throttle, uint32_t rate, uint32_t burst, int64_t now_us)
+{
+    throttle->rate = rate;
+    throttle->capacity = (int64_t)burst * 1000000;
+    throttle->tokens = throttle->capacity;
+    throttle->last_us = now_us;
+}
+
+int64_t ota_throttle_take(ota_throttle_t *throttle, size_t len, int64_t now_us)
+{
+    if (throttle->rate == 0) {
+        return 0;
+    }
+
+    if (now_us > throttle->last_us) {
+        throttle->tokens += (now_us - throttle->last_us) * throttle->rate;
+        if (throttle->tokens > throttle->capacity) {
+            throttle->tokens = throttle->capacity;
+        }
+        throttle->last_us = now_us;
+    }
+    throttle->tokens -= (int64_t)len * 1000000;
+
+    return throttle->tokens < 0 ? (-throttle->tokens + throttle->rate - 1) / throttle->rate : 0;
+}
@@ -0,0 +1,31 @@
+#ifndef OTA_THROTTLE_H
+#define OTA_THROTTLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Token bucket for background downloads. Pure arithmetic on a caller-supplied
+ * clock: the network loop takes what it just read and sleeps for the returned
+ * time, so the average stays at rate with bursts of at most burst bytes.
+ * Tokens are kept in byte-microseconds, so slow rates lose nothing to rounding.
+ */
+typedef struct {
+    uint32_t rate;              // Bytes/s, 0 = unlimited
+    int64_t capacity;           // burst in byte-microseconds
+    int64_t tokens;             // May go negative: debt paid by waiting
+    int64_t last_us;
+} ota_throttle_t;
+
+/**
+ * @brief Start with a full bucket
+ */
+void ota_throttle_init(ota_throttle_t *throttle, uint32_t rate, uint32_t burst, int64_t now_us);
+
+/**
+ * @brief Account for len bytes received at now_us
+ * @return Microseconds to wait before reading more, 0 if within budget
+ */
+int64_t ota_throttle_take(ota_throttle_t *throttle, size_t len, int64_t now_us);
+
+#endif
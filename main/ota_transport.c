@@ -0,0 +1,174 @@
+#include "ota_transport.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include <stdio.h>
+
+static const char *TAG = "OTA_XPORT";
+
+#define UPLOAD_RECV_RETRIES 5   // Socket timeouts tolerated per read on an upload
+
+esp_err_t ota_transport_open(ota_transport_t *transport, int offset, int *content_length)
+{
+    return transport->ops->open(transport->ctx, offset, content_length);
+}
+
+int ota_transport_read_full(ota_transport_t *transport, char *buf, int len)
+{
+    int total = 0;
+    while (total < len) {
+        int data_read = transport->ops->read(transport->ctx, buf + total, len - total);
+        if (data_read < 0) {
+            // Keep what already arrived, the caller resumes after it
+            return total > 0 ? total : data_read;
+        }
+        if (data_read == 0) {
+            break;
+        }
+        total += data_read;
+    }
+    return total;
+}
+
+esp_err_t ota_transport_resume(ota_transport_t *transport, int offset, int stream_size)
+{
+    transport->ops->close(transport->ctx);
+
+    int remaining;
+    esp_err_t err = transport->ops->open(transport->ctx, offset, &remaining);
+    if (err == ESP_OK && offset + remaining != stream_size) {
+        ESP_LOGE(TAG, "Server returned a different file (%d + %d != %d)",
+                 offset, remaining, stream_size);
+        transport->ops->close(transport->ctx);
+        err = ESP_ERR_INVALID_RESPONSE;
+    }
+    return err;
+}
+
+void ota_transport_close(ota_transport_t *transport)
+{
+    transport->ops->close(transport->ctx);
+}
+
+// (Re)open the download at offset with a Range request; 0 fetches the whole file
+static esp_err_t http_open(void *ctx, int offset, int *content_length)
+{
+    esp_http_client_handle_t client = (esp_http_client_handle_t)ctx;
+
+    if (offset > 0) {
+        char range[32];
+        snprintf(range, sizeof(range), "bytes=%d-", offset);
+        esp_http_client_set_header(client, "Range", range);
+    } else {
+        esp_http_client_delete_header(client, "Range");
+    }
+
+    esp_err_t err = esp_http_client_open(client, 0);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open connection: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    *content_length = esp_http_client_fetch_headers(client);
+    int status_code = esp_http_client_get_status_code(client);
+    ESP_LOGI(TAG, "HTTP Status: %d, Content Length: %d", status_code, *content_length);
+
+    if (status_code != (offset > 0 ? 206 : 200) || *content_length <= 0) {
+        ESP_LOGE(TAG, "Invalid HTTP response");
+        esp_http_client_close(client);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static int http_read(void *ctx, char *buf, int len)
+{
+    return esp_http_client_read((esp_http_client_handle_t)ctx, buf, len);
+}
+
+static void http_close(void *ctx)
+{
+    esp_http_client_close((esp_http_client_handle_t)ctx);
+}
+
+static const ota_transport_ops_t http_ops = {
+    .open = http_open,
+    .read = http_read,
+    .close = http_close,
+};
+
+esp_err_t ota_transport_http_init(ota_transport_t *transport, const char *url)
+{
+    esp_http_client_config_t config = {
+        .url = url,
+        .timeout_ms = 10000,
+        .keep_alive_enable = true,
+        .buffer_size = 1024,
+    };
+
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (client == NULL) {
+        ESP_LOGE(TAG, "Failed to initialize HTTP client");
+        return ESP_FAIL;
+    }
+
+    transport->ops = &http_ops;
+    transport->ctx = client;
+    transport->url = url;
+    return ESP_OK;
+}
+
+void ota_transport_http_deinit(ota_transport_t *transport)
+{
+    if (transport->ctx == NULL) {
+        return;
+    }
+    esp_http_client_close((esp_http_client_handle_t)transport->ctx);
+    esp_http_client_cleanup((esp_http_client_handle_t)transport->ctx);
+    transport->ctx = NULL;
+}
+
+static esp_err_t upload_open(void *ctx, int offset, int *content_length)
+{
+    httpd_req_t *req = (httpd_req_t *)ctx;
+
+    // A request body is consumed as it is read, there is nothing to seek back to
+    if (offset > 0) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (req->content_len == 0) {
+        ESP_LOGE(TAG, "Upload without Content-Length");
+        return ESP_ERR_INVALID_SIZE;
+    }
+    *content_length = req->content_len;
+    return ESP_OK;
+}
+
+static int upload_read(void *ctx, char *buf, int len)
+{
+    for (int retry = 0; ; retry++) {
+        int ret = httpd_req_recv((httpd_req_t *)ctx, buf, len);
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT && retry < UPLOAD_RECV_RETRIES) {
+            continue;
+        }
+        return ret;
+    }
+}
+
+static void upload_close(void *ctx)
+{
+    // The server owns the socket
+}
+
+static const ota_transport_ops_t upload_ops = {
+    .open = upload_open,
+    .read = upload_read,
+    .close = upload_close,
+};
+
+esp_err_t ota_transport_upload_init(ota_transport_t *transport, httpd_req_t *req)
+{
+    transport->ops = &upload_ops;
+    transport->ctx = req;
+    transport->url = NULL;
+    return ESP_OK;
+}
@@ -0,0 +1,68 @@
+#ifndef OTA_TRANSPORT_H
+#define OTA_TRANSPORT_H
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+/**
+ * Byte source for the update engine. ota_manager only talks to this
+ * interface, so the download/decode/flash path does not depend on where
+ * the image comes from (HTTP pull or a POST upload).
+ */
+typedef struct {
+    /**
+     * Start the stream at offset and report the bytes that will follow.
+     * offset > 0 continues an earlier stream; return ESP_ERR_NOT_SUPPORTED
+     * if the source cannot seek.
+     */
+    esp_err_t (*open)(void *ctx, int offset, int *content_length);
+    int (*read)(void *ctx, char *buf, int len);     // >0 bytes, 0 end, <0 error
+    void (*close)(void *ctx);
+} ota_transport_ops_t;
+
+typedef struct {
+    const ota_transport_ops_t *ops;
+    void *ctx;
+    const char *url;            // Set when the source can be re-fetched by URL (resume, segments)
+} ota_transport_t;
+
+/**
+ * @brief Open the stream at offset
+ */
+esp_err_t ota_transport_open(ota_transport_t *transport, int offset, int *content_length);
+
+/**
+ * @brief Read until len bytes arrived or the stream ended
+ * @return Bytes read; data that arrived before an error is returned first
+ */
+int ota_transport_read_full(ota_transport_t *transport, char *buf, int len);
+
+/**
+ * @brief Drop the connection and continue the same stream from offset
+ * @param stream_size Total stream length, used to detect a changed source
+ */
+esp_err_t ota_transport_resume(ota_transport_t *transport, int offset, int stream_size);
+
+/**
+ * @brief Close the current stream, the transport can be opened again
+ */
+void ota_transport_close(ota_transport_t *transport);
+
+/**
+ * @brief HTTP(S) transport with Range support over esp_http_client
+ */
+esp_err_t ota_transport_http_init(ota_transport_t *transport, const char *url);
+
+/**
+ * @brief Release the HTTP client created by ota_transport_http_init()
+ */
+void ota_transport_http_deinit(ota_transport_t *transport);
+
+/**
+ * @brief Request body of an esp_http_server POST as the image source
+ * Single pass only: the body cannot be re-read, so url stays NULL.
+ */
+esp_err_t ota_transport_upload_init(ota_transport_t *transport, httpd_req_t *req);
+
+#endif
@@ -0,0 +1,62 @@
+#include "ota_window.h"
+#include "esp_log.h"
+#include "esp_netif_sntp.h"
+#include <stdlib.h>
+#include <time.h>
+
+static const char *TAG = "OTA_WINDOW";
+
+#define OTA_WINDOW_VALID_TIME  1700000000  // Anything earlier means SNTP has not synced yet
+
+// A window needs both ends inside the day, and start == end would never open
+_Static_assert(OTA_WINDOW_START_MIN < 0 ||
+               (OTA_WINDOW_START_MIN < 24 * 60 && OTA_WINDOW_END_MIN >= 0 && OTA_WINDOW_END_MIN < 24 * 60),
+               "OTA_WINDOW_START_MIN and OTA_WINDOW_END_MIN must both be 0..1439");
+_Static_assert(OTA_WINDOW_START_MIN < 0 || OTA_WINDOW_START_MIN != OTA_WINDOW_END_MIN,
+               "OTA_WINDOW_START_MIN == OTA_WINDOW_END_MIN is an empty window");
+
+void ota_window_init(void)
+{
+    if (OTA_WINDOW_START_MIN < 0) {
+        return;
+    }
+    setenv("TZ", OTA_WINDOW_TZ, 1);
+    tzset();
+
+    esp_sntp_config_t config = ESP_NETIF_SNTP_DEFAULT_CONFIG(OTA_WINDOW_NTP_SERVER);
+    esp_err_t err = esp_netif_sntp_init(&config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "SNTP start failed: %s", esp_err_to_name(err));
+        return;
+    }
+    ESP_LOGI(TAG, "Updates activate between %02d:%02d and %02d:%02d (%s)",
+             OTA_WINDOW_START_MIN / 60, OTA_WINDOW_START_MIN % 60,
+             OTA_WINDOW_END_MIN / 60, OTA_WINDOW_END_MIN % 60, OTA_WINDOW_TZ);
+}
+
+bool ota_window_contains(int start_min, int end_min, int now_min)
+{
+    if (start_min < 0) {
+        return true;
+    }
+    if (start_min <= end_min) {
+        return now_min >= start_min && now_min < end_min;
+    }
+    return now_min >= start_min || now_min < end_min;
+}
+
+bool ota_window_open(void)
+{
+    if (OTA_WINDOW_START_MIN < 0) {
+        return true;
+    }
+
+    time_t now = time(NULL);
+    if (now < OTA_WINDOW_VALID_TIME) {
+        return false;
+    }
+    struct tm local;
+    localtime_r(&now, &local);
+    return ota_window_contains(OTA_WINDOW_START_MIN, OTA_WINDOW_END_MIN,
+                               local.tm_hour * 60 + local.tm_min);
+}
@@ -0,0 +1,45 @@
+#ifndef OTA_WINDOW_H
+#define OTA_WINDOW_H
+
+#include <stdbool.h>
+
+/**
+ * Maintenance window for background updates: the image downloads whenever it
+ * is offered, but the switch to it (and the reboot) waits until local time is
+ * inside [OTA_WINDOW_START_MIN, OTA_WINDOW_END_MIN). The window may wrap past
+ * midnight; both ends must be set and differ (checked at build time).
+ * Wall-clock time comes from SNTP, started only when a window is configured;
+ * until the clock is set the window counts as closed.
+ */
+
+#ifndef OTA_WINDOW_START_MIN
+#define OTA_WINDOW_START_MIN   -1      // Minutes after local midnight, -1 = no window
+#endif
+#ifndef OTA_WINDOW_END_MIN
+#define OTA_WINDOW_END_MIN     -1
+#endif
+#ifndef OTA_WINDOW_TZ
+#define OTA_WINDOW_TZ          "UTC0"  // POSIX TZ string the window is expressed in
+#endif
+#ifndef OTA_WINDOW_NTP_SERVER
+#define OTA_WINDOW_NTP_SERVER  "pool.ntp.org"
+#endif
+
+/**
+ * @brief Set the time zone and start SNTP if a window is configured
+ */
+void ota_window_init(void);
+
+/**
+ * @brief True if minute-of-day now_min falls in [start_min, end_min)
+ * start_min > end_min wraps past midnight, start_min == end_min is empty;
+ * start_min < 0 means always.
+ */
+bool ota_window_contains(int start_min, int end_min, int now_min);
+
+/**
+ * @brief True if activation may happen now
+ */
+bool ota_window_open(void);
+
+#endif
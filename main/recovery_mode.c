@@ -1,38 +1,55 @@
 #include "recovery_mode.h"
-#include "esp_wifi.h"
-#include "esp_event.h"
 #include "esp_log.h"
 #include "esp_http_server.h"
 #include "nvs_flash.h"
 #include "wifi_manager.h"
 #include "ota_manager.h"
+#include "ota_job.h"
+#include "web_assets.h"
+#include "boot_trace.h"
+#include "esp_ota_ops.h"
+#include "esp_app_desc.h"
+#include <stdio.h>
 
 static const char *TAG = "RECOVERY";
 
 #define RECOVERY_AP_SSID "IoT_M2M"
 #define RECOVERY_AP_PASS "Mj02miat"
 
-// HTML page untuk config
-static const char *html_page = 
-    "<!DOCTYPE html><html><body>"
-    "<h1>ESP32 Recovery Mode</h1>"
-    "<form action='/config' method='post'>"
-    "WiFi SSID: <input name='ssid' type='text'><br>"
-    "Password: <input name='pass' type='password'><br>"
-    "<input type='submit' value='Save'>"
-    "</form>"
-    "<hr>"
-    "<form action='/ota' method='post'>"
-    "Firmware URL: <input name='url' type='text' size='50'><br>"
-    "<input type='submit' value='Update'>"
-    "</form>"
-    "</body></html>";
+WEB_ASSET_DECLARE(recovery_html_gz);
 
 // Handler untuk halaman utama
 static esp_err_t root_handler(httpd_req_t *req)
 {
-    httpd_resp_send(req, html_page, strlen(html_page));
-    return ESP_OK;
+    return web_asset_send(req, _binary_recovery_html_gz_start, _binary_recovery_html_gz_end, "text/html");
+}
+
+// Version info and saved networks for the page script
+static esp_err_t info_handler(httpd_req_t *req)
+{
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    const esp_app_desc_t *app_desc = esp_app_get_description();
+    char ssids[WIFI_MAX_PROFILES][33];
+    int count = wifi_get_saved_ssids(ssids, WIFI_MAX_PROFILES);
+
+    char json[160 + WIFI_MAX_PROFILES * 36];
+    int len = snprintf(json, sizeof(json),
+                       "{\"partition\":\"%s\",\"version\":\"%s\",\"upstream\":%s,\"networks\":[",
+                       running->label, app_desc->version, wifi_is_connected() ? "true" : "false");
+    for (int i = 0; i < count; i++) {
+        // SSIDs are arbitrary bytes, keep the JSON well-formed
+        for (char *p = ssids[i]; *p; p++) {
+            if (*p == '"' || *p == '\\' || (unsigned char)*p < 0x20) {
+                *p = '_';
+            }
+        }
+        len += snprintf(json + len, sizeof(json) - len, "%s\"%s\"", i ? "," : "", ssids[i]);
+    }
+    snprintf(json + len, sizeof(json) - len, "]}");
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_sendstr(req, json);
 }
 
 // Handler untuk save WiFi config
@@ -45,13 +62,33 @@ static esp_err_t config_handler(httpd_req_t *req)
     }
     buf[ret] = '\0';
     
-    // Parse form data: ssid=XXX&pass=YYY
+    // Parse form data: ssid=XXX&pass=YYY, or ssid=XXX&action=remove
     char ssid[33] = {0};
     char pass[64] = {0};
     
     // Simple parser
     char *ssid_start = strstr(buf, "ssid=");
     char *pass_start = strstr(buf, "pass=");
+
+    if (ssid_start && strstr(buf, "action=remove")) {
+        ssid_start += 5;
+        char *ssid_end = strchr(ssid_start, '&');
+        int len = ssid_end ? (ssid_end - ssid_start) : strlen(ssid_start);
+        if (len < sizeof(ssid)) {
+            strncpy(ssid, ssid_start, len);
+        }
+        for (int i = 0; ssid[i]; i++) {
+            if (ssid[i] == '+') ssid[i] = ' ';
+        }
+
+        if (wifi_remove_credentials(ssid) != ESP_OK) {
+            httpd_resp_sendstr(req, "Unknown network");
+            return ESP_FAIL;
+        }
+        ESP_LOGI(TAG, "WiFi config removed: SSID=%s", ssid);
+        httpd_resp_sendstr(req, "Network removed.");
+        return ESP_OK;
+    }
     
     if (ssid_start && pass_start) {
         ssid_start += 5; // skip "ssid="
@@ -79,10 +116,16 @@ static esp_err_t config_handler(httpd_req_t *req)
         }
         
         // Save to NVS
-        wifi_save_credentials(ssid, pass);
+        if (wifi_save_credentials(ssid, pass) != ESP_OK) {
+            httpd_resp_sendstr(req, "Invalid data");
+            return ESP_FAIL;
+        }
         
         ESP_LOGI(TAG, "WiFi config saved: SSID=%s", ssid);
-        httpd_resp_send(req, "Config saved! Please reboot device.", 36);
+        wifi_reconnect();
+        httpd_resp_sendstr(req, wifi_is_connected()
+                           ? "Config saved! Used from the next reboot."
+                           : "Config saved! Connecting, check the upstream status.");
         return ESP_OK;
     }
     
@@ -113,10 +156,13 @@ static esp_err_t ota_handler(httpd_req_t *req)
         }
         
         ESP_LOGI(TAG, "OTA URL: %s", url);
-        httpd_resp_send(req, "OTA started! Device will reboot after update.", 47);
         
-        // Trigger OTA (dari ota_manager)
-        ota_update_from_url(url);
+        // Runs on the OTA worker, the server stays responsive
+        if (ota_job_submit(url) != ESP_OK) {
+            httpd_resp_send(req, "OTA queue full", 14);
+            return ESP_FAIL;
+        }
+        httpd_resp_sendstr(req, "OTA queued! Progress at /ota/status, device reboots when done.");
         return ESP_OK;
     }
     
@@ -128,31 +174,14 @@ void recovery_mode_start(void)
 {
     ESP_LOGI(TAG, "Starting Recovery Mode AP...");
     
-    // Init WiFi dalam mode AP
-    ESP_ERROR_CHECK(esp_netif_init());
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_ap();
-    
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
-    
-    wifi_config_t wifi_config = {
-        .ap = {
-            .ssid = RECOVERY_AP_SSID,
-            .password = RECOVERY_AP_PASS,
-            .max_connection = 4,
-            .authmode = WIFI_AUTH_WPA2_PSK
-        },
-    };
-    
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_AP));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &wifi_config));
-    ESP_ERROR_CHECK(esp_wifi_start());
-    
-    ESP_LOGI(TAG, "AP started: SSID=%s, Pass=%s", RECOVERY_AP_SSID, RECOVERY_AP_PASS);
+    // AP for the technician, station keeps trying the saved networks
+    ESP_ERROR_CHECK(wifi_start_recovery(RECOVERY_AP_SSID, RECOVERY_AP_PASS));
     
+    ota_job_init();
+
     // Start HTTP server
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.max_uri_handlers = 12;
     httpd_handle_t server = NULL;
     
     if (httpd_start(&server, &config) == ESP_OK) {
@@ -162,6 +191,13 @@ void recovery_mode_start(void)
             .handler = root_handler
         };
         httpd_register_uri_handler(server, &root);
+
+        httpd_uri_t info_uri = {
+            .uri = "/info",
+            .method = HTTP_GET,
+            .handler = info_handler
+        };
+        httpd_register_uri_handler(server, &info_uri);
         
         httpd_uri_t config_uri = {
             .uri = "/config",
@@ -176,6 +212,17 @@ void recovery_mode_start(void)
             .handler = ota_handler
         };
         httpd_register_uri_handler(server, &ota_uri);
+
+        httpd_uri_t upload_uri = {
+            .uri = "/upload",
+            .method = HTTP_POST,
+            .handler = ota_upload_handler
+        };
+        httpd_register_uri_handler(server, &upload_uri);
+
+        ota_job_register_handlers(server);
+        boot_trace_register_handlers(server);
+        boot_trace_mark(BOOT_TRACE_RECOVERY, 0);
         
         ESP_LOGI(TAG, "HTTP server started on http://192.168.4.1");
     }
@@ -0,0 +1,36 @@
+#include "web_assets.h"
+#include "esp_app_desc.h"
+#include <stdio.h>
+#include <string.h>
+
+static char etag[20];   // Quoted, first 16 hex digits of the ELF hash
+
+static const char *web_asset_etag(void)
+{
+    if (etag[0] == '\0') {
+        char sha[17];
+        esp_app_get_elf_sha256(sha, sizeof(sha));
+        snprintf(etag, sizeof(etag), "\"%s\"", sha);
+    }
+    return etag;
+}
+
+esp_err_t web_asset_send(httpd_req_t *req, const uint8_t *start, const uint8_t *end,
+                         const char *content_type)
+{
+    const char *tag = web_asset_etag();
+    httpd_resp_set_hdr(req, "ETag", tag);
+    httpd_resp_set_hdr(req, "Cache-Control", WEB_ASSET_CACHE_CONTROL);
+
+    char if_none_match[sizeof(etag)];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+        strcmp(if_none_match, tag) == 0) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    // Every browser accepts gzip; the page is never stored uncompressed
+    httpd_resp_set_type(req, content_type);
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    return httpd_resp_send(req, (const char *)start, end - start);
+}
@@ -0,0 +1,28 @@
+#ifndef WEB_ASSETS_H
+#define WEB_ASSETS_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+/**
+ * Portal pages live in main/www/, are gzipped at build time by
+ * tools/gzip-asset.py and linked into the image as <name>.gz. They can only
+ * change with the firmware, so the app ELF hash serves as their ETag.
+ */
+
+#define WEB_ASSET_CACHE_CONTROL "no-cache"  // Revalidate; a 304 until the next update
+
+// Symbols generated by target_add_binary_data() in main/CMakeLists.txt
+#define WEB_ASSET_DECLARE(sym) \
+    extern const uint8_t _binary_##sym##_start[]; \
+    extern const uint8_t _binary_##sym##_end[]
+
+/**
+ * @brief Send an embedded gzipped asset with ETag/Cache-Control
+ * Answers 304 when the client already has this build's copy.
+ */
+esp_err_t web_asset_send(httpd_req_t *req, const uint8_t *start, const uint8_t *end,
+                         const char *content_type);
+
+#endif
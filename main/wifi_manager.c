@@ -1,141 +1,613 @@
 #include "wifi_manager.h"
+#include "wifi_policy.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "ping/ping_sock.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+#include "boot_trace.h"
+#include <stdlib.h>
 #include <string.h>        // ← TAMBAH INI
 #include <stdbool.h>       // ← TAMBAH INI
 
 static const char *TAG = "WIFI_MGR";
 
 #define WIFI_CONNECTED_BIT BIT0
-#define WIFI_FAIL_BIT      BIT1
-#define MAX_RETRY          5
 
 #define NVS_NAMESPACE "wifi_config"
-#define NVS_SSID_KEY  "IoT_M2M"
+#define NVS_SSID_KEY  "IoT_M2M"     // Single-network layout, migrated on first load
 #define NVS_PASS_KEY  "Mj02miat"
+#define NVS_FAST_KEY  "fast"
+#define NVS_PROFILES_KEY "profiles"
+
+#define WIFI_FAST_CACHE_VERSION 2
+#define WIFI_PROFILES_VERSION   1
+#define WIFI_SCAN_MAX           16  // AP records considered per scan
+
+#define WIFI_DEFAULT_SSID "IoT_M2M"
+#define WIFI_DEFAULT_PASS "Mj02miat"
+
+// All saved networks, one versioned blob loaded into RAM once
+typedef struct {
+    uint8_t version;
+    uint8_t count;
+    uint32_t sequence;          // Bumped on every successful connect
+    wifi_profile_t profiles[WIFI_MAX_PROFILES];
+} wifi_profile_store_t;
+
+// Last good association, lets the next boot skip the scan (and DHCP)
+typedef struct {
+    uint8_t version;
+    char ssid[33];              // Profile the cache belongs to
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint32_t ip;
+    uint32_t netmask;
+    uint32_t gw;
+    uint32_t dns;
+} wifi_fast_cache_t;
 
 static EventGroupHandle_t s_wifi_event_group;
-static int s_retry_num = 0;
+// Everything below is shared by the event loop, the esp_timer task (retries)
+// and the portal's httpd task (profile edits, reconnect); hold s_lock for it
+static SemaphoreHandle_t s_lock = NULL;
+static esp_netif_t *s_sta_netif = NULL;
+static wifi_profile_store_t s_store;
+static bool s_store_loaded = false;
+static uint8_t s_order[WIFI_MAX_PROFILES];  // Ranked candidates from the last scan
+static wifi_retry_t s_retry;
+static int s_current = -1;                  // Profile being tried
+static wifi_config_t s_sta_config;
+static wifi_scan_ap_t s_scan[WIFI_SCAN_MAX];
+static wifi_fast_cache_t s_cache;
+static bool s_pinned_ip = false;        // Fast attempt uses the cached lease as a static IP
+static esp_timer_handle_t s_ip_timer = NULL;    // Fast attempt: association without IP
 static bool s_is_connected = false;
+static bool s_upstream_absent = false;  // Last search found none of the saved networks
+static esp_timer_handle_t s_retry_timer = NULL;
+static int64_t s_cycle_start_us;        // Connection lost (or Wi-Fi started)
+static int64_t s_attempt_start_us;
+static int64_t s_assoc_us;
+static wifi_timings_t s_timings;
 
-static void event_handler(void* arg, esp_event_base_t event_base,
-                         int32_t event_id, void* event_data)
+static esp_err_t wifi_store_save(void)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(err));
+        return err;
+    }
+    err = nvs_set_blob(nvs_handle, NVS_PROFILES_KEY, &s_store, sizeof(s_store));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save WiFi profiles: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+// Read the single SSID/password pair older firmware stored
+static bool wifi_store_migrate(void)
+{
+    nvs_handle_t nvs_handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle) != ESP_OK) {
+        return false;
+    }
+    wifi_profile_t *profile = &s_store.profiles[0];
+    size_t ssid_len = sizeof(profile->ssid);
+    size_t pass_len = sizeof(profile->password);
+    bool found = nvs_get_str(nvs_handle, NVS_SSID_KEY, profile->ssid, &ssid_len) == ESP_OK &&
+                 nvs_get_str(nvs_handle, NVS_PASS_KEY, profile->password, &pass_len) == ESP_OK;
+    if (found) {
+        nvs_erase_key(nvs_handle, NVS_SSID_KEY);
+        nvs_erase_key(nvs_handle, NVS_PASS_KEY);
+        nvs_commit(nvs_handle);
+        s_store.count = 1;
+        ESP_LOGI(TAG, "Migrated saved network %s to profiles", profile->ssid);
+    } else {
+        memset(profile, 0, sizeof(*profile));
+    }
+    nvs_close(nvs_handle);
+    return found;
+}
+
+static void wifi_store_load(void)
+{
+    if (s_store_loaded) {
+        return;
+    }
+
+    nvs_handle_t nvs_handle;
+    size_t len = sizeof(s_store);
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle) == ESP_OK) {
+        err = nvs_get_blob(nvs_handle, NVS_PROFILES_KEY, &s_store, &len);
+        nvs_close(nvs_handle);
+    }
+    if (err != ESP_OK || len != sizeof(s_store) || s_store.version != WIFI_PROFILES_VERSION ||
+        s_store.count > WIFI_MAX_PROFILES) {
+        memset(&s_store, 0, sizeof(s_store));
+        s_store.version = WIFI_PROFILES_VERSION;
+        if (wifi_store_migrate()) {
+            wifi_store_save();
+        }
+    }
+    s_store_loaded = true;
+    ESP_LOGI(TAG, "%d saved network(s)", s_store.count);
+}
+
+static int wifi_store_find(const char *ssid)
+{
+    for (int i = 0; i < s_store.count; i++) {
+        if (strcmp(s_store.profiles[i].ssid, ssid) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void wifi_lock(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+}
+
+static void wifi_unlock(void)
+{
+    xSemaphoreGive(s_lock);
+}
+
+static void wifi_use_profile(int index)
+{
+    const wifi_profile_t *profile = &s_store.profiles[index];
+    s_current = index;
+    memset(s_sta_config.sta.ssid, 0, sizeof(s_sta_config.sta.ssid));
+    memset(s_sta_config.sta.password, 0, sizeof(s_sta_config.sta.password));
+    strncpy((char *)s_sta_config.sta.ssid, profile->ssid, sizeof(s_sta_config.sta.ssid));
+    strncpy((char *)s_sta_config.sta.password, profile->password, sizeof(s_sta_config.sta.password));
+}
+
+static void wifi_connect_now(void)
+{
+    s_attempt_start_us = esp_timer_get_time();
+    esp_wifi_connect();
+}
+
+static void wifi_schedule_retry(uint32_t delay_ms)
+{
+    ESP_LOGI(TAG, "Retry %lu in %lu ms", (unsigned long)s_retry.attempt, (unsigned long)delay_ms);
+    esp_timer_start_once(s_retry_timer, (uint64_t)delay_ms * 1000);
+}
+
+// Connect to the current candidate, or scan once the ranked list is used up
+static void wifi_start_attempt(void)
+{
+    if (!s_retry.fast) {
+        if (s_store.count == 1) {
+            s_order[0] = 0;
+            wifi_retry_set_candidates(&s_retry, 1);
+        } else if (s_retry.order_pos >= s_retry.order_count) {
+            if (esp_wifi_scan_start(NULL, false) != ESP_OK) {
+                wifi_schedule_retry(wifi_retry_backoff(&s_retry, esp_random()));
+            }
+            return;
+        }
+        wifi_use_profile(s_order[s_retry.order_pos]);
+        esp_wifi_set_config(WIFI_IF_STA, &s_sta_config);
+        ESP_LOGI(TAG, "Connecting to SSID:%s", s_store.profiles[s_current].ssid);
+    }
+    wifi_connect_now();
+}
+
+static void wifi_scan_done(void)
+{
+    uint16_t count = WIFI_SCAN_MAX;
+    wifi_ap_record_t *aps = calloc(WIFI_SCAN_MAX, sizeof(wifi_ap_record_t));
+    if (aps == NULL || esp_wifi_scan_get_ap_records(&count, aps) != ESP_OK) {
+        count = 0;
+    }
+    for (int i = 0; i < count; i++) {
+        memcpy(s_scan[i].ssid, aps[i].ssid, sizeof(s_scan[i].ssid));
+        s_scan[i].ssid[sizeof(s_scan[i].ssid) - 1] = '\0';
+        s_scan[i].rssi = aps[i].rssi;
+    }
+    free(aps);
+    wifi_retry_set_candidates(&s_retry, wifi_rank_profiles(s_store.profiles, s_store.count,
+                                                           s_scan, count, s_order));
+    if (s_retry.order_count == 0) {
+        ESP_LOGW(TAG, "No saved network in range");
+        s_upstream_absent = true;
+        wifi_schedule_retry(wifi_retry_backoff(&s_retry, esp_random()));
+        return;
+    }
+    wifi_start_attempt();
+}
+
+static void wifi_retry_cb(void *arg)
+{
+    wifi_lock();
+    wifi_start_attempt();
+    wifi_unlock();
+}
+
+static void wifi_clear_cache(void)
+{
+    nvs_handle_t nvs_handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle) == ESP_OK) {
+        nvs_erase_key(nvs_handle, NVS_FAST_KEY);
+        nvs_commit(nvs_handle);
+        nvs_close(nvs_handle);
+    }
+    memset(&s_cache, 0, sizeof(s_cache));
+}
+
+static void wifi_save_cache(const ip_event_got_ip_t *event)
+{
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK) {
+        return;
+    }
+
+    if (s_current < 0) {
+        return;
+    }
+    wifi_fast_cache_t cache = {
+        .version = WIFI_FAST_CACHE_VERSION,
+        .channel = ap.primary,
+        .ip = event->ip_info.ip.addr,
+        .netmask = event->ip_info.netmask.addr,
+        .gw = event->ip_info.gw.addr,
+    };
+    strncpy(cache.ssid, s_store.profiles[s_current].ssid, sizeof(cache.ssid) - 1);
+    memcpy(cache.bssid, ap.bssid, sizeof(cache.bssid));
+    esp_netif_dns_info_t dns;
+    if (esp_netif_get_dns_info(s_sta_netif, ESP_NETIF_DNS_MAIN, &dns) == ESP_OK) {
+        cache.dns = dns.ip.u_addr.ip4.addr;
+    }
+
+    // Only touch flash when something changed
+    if (memcmp(&cache, &s_cache, sizeof(cache)) == 0) {
+        return;
+    }
+    nvs_handle_t nvs_handle;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle) == ESP_OK) {
+        if (nvs_set_blob(nvs_handle, NVS_FAST_KEY, &cache, sizeof(cache)) == ESP_OK &&
+            nvs_commit(nvs_handle) == ESP_OK) {
+            s_cache = cache;
+            ESP_LOGI(TAG, "Fast-connect cache updated (channel %d)", cache.channel);
+        }
+        nvs_close(nvs_handle);
+    }
+}
+
+static bool wifi_load_cache(void)
+{
+    nvs_handle_t nvs_handle;
+    size_t len = sizeof(s_cache);
+
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return false;
+    }
+    esp_err_t err = nvs_get_blob(nvs_handle, NVS_FAST_KEY, &s_cache, &len);
+    nvs_close(nvs_handle);
+
+    if (err != ESP_OK || len != sizeof(s_cache) || s_cache.version != WIFI_FAST_CACHE_VERSION) {
+        memset(&s_cache, 0, sizeof(s_cache));
+        return false;
+    }
+    return true;
+}
+
+// Point the station at the cached AP, and optionally reuse the cached lease
+static bool wifi_apply_cache(void)
+{
+    int index = wifi_store_find(s_cache.ssid);
+    if (index < 0) {
+        return false;
+    }
+    wifi_use_profile(index);
+    s_sta_config.sta.bssid_set = true;
+    memcpy(s_sta_config.sta.bssid, s_cache.bssid, sizeof(s_cache.bssid));
+    s_sta_config.sta.channel = s_cache.channel;
+
+#if WIFI_FAST_CONNECT_IP
+    if (s_cache.ip != 0) {
+        esp_netif_ip_info_t ip_info = {
+            .ip.addr = s_cache.ip,
+            .netmask.addr = s_cache.netmask,
+            .gw.addr = s_cache.gw,
+        };
+        esp_netif_dhcpc_stop(s_sta_netif);
+        esp_netif_set_ip_info(s_sta_netif, &ip_info);
+        s_pinned_ip = true;
+        if (s_cache.dns != 0) {
+            esp_netif_dns_info_t dns = { .ip.type = ESP_IPADDR_TYPE_V4, .ip.u_addr.ip4.addr = s_cache.dns };
+            esp_netif_set_dns_info(s_sta_netif, ESP_NETIF_DNS_MAIN, &dns);
+        }
+    }
+#endif
+    s_retry.fast = true;
+    return true;
+}
+
+// Back to a normal scan + DHCP; forget the cache if the cached AP never answered
+static void wifi_unpin_ap(bool forget)
+{
+    s_pinned_ip = false;
+    s_sta_config.sta.bssid_set = false;
+    s_sta_config.sta.channel = 0;
+    esp_wifi_set_config(WIFI_IF_STA, &s_sta_config);
+    esp_netif_dhcpc_start(s_sta_netif);
+    if (forget) {
+        ESP_LOGW(TAG, "Fast connect failed, falling back to scan + DHCP");
+        wifi_clear_cache();
+    }
+}
+
+// Associated on the cached BSSID but DHCP never finished: treat it like a
+// failed fast attempt, the disconnect drops the cache and scans
+static void wifi_ip_timeout_cb(void *arg)
+{
+    ESP_LOGW(TAG, "Fast connect got no IP within %d ms", WIFI_FAST_IP_TIMEOUT_MS);
+    esp_wifi_disconnect();
+}
+
+#if WIFI_FAST_CONNECT_IP
+static void wifi_probe_end(esp_ping_handle_t ping, void *arg)
+{
+    uint32_t replies = 0;
+    esp_ping_get_profile(ping, ESP_PING_PROF_REPLY, &replies, sizeof(replies));
+    esp_ping_delete_session(ping);
+    if (replies == 0) {
+        // Stale lease or someone else holds the address: the gateway's
+        // replies never reach us. DHCP takes over, GOT_IP follows again.
+        ESP_LOGW(TAG, "Gateway does not answer on the cached IP, switching to DHCP");
+        wifi_lock();
+        wifi_clear_cache();
+        wifi_unlock();
+        esp_netif_dhcpc_start(s_sta_netif);
+    }
+}
+
+// A pinned address reports GOT_IP as soon as the link is up, whether or not
+// it still works on this network; ping the gateway to find out
+static void wifi_probe_pinned_ip(uint32_t gw)
+{
+    esp_ping_config_t config = ESP_PING_DEFAULT_CONFIG();
+    config.target_addr.type = IPADDR_TYPE_V4;
+    config.target_addr.u_addr.ip4.addr = gw;
+    config.count = 3;
+    config.interval_ms = 300;
+    config.interface = esp_netif_get_netif_impl_index(s_sta_netif);
+    esp_ping_callbacks_t callbacks = { .on_ping_end = wifi_probe_end };
+
+    esp_ping_handle_t ping;
+    if (esp_ping_new_session(&config, &callbacks, &ping) == ESP_OK) {
+        esp_ping_start(ping);
+    }
+}
+#endif
+
+static void wifi_handle_event(esp_event_base_t event_base, int32_t event_id, void *event_data)
 {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        esp_wifi_connect();
+        s_cycle_start_us = esp_timer_get_time();
+        wifi_start_attempt();
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_SCAN_DONE) {
+        wifi_scan_done();
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_AP_STACONNECTED) {
+        ESP_LOGI(TAG, "Portal client joined the AP");
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        s_assoc_us = esp_timer_get_time();
+        s_upstream_absent = false;
+        if (s_retry.fast) {
+            esp_timer_start_once(s_ip_timer, (uint64_t)WIFI_FAST_IP_TIMEOUT_MS * 1000);
+        }
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        if (s_retry_num < MAX_RETRY) {
-            esp_wifi_connect();
-            s_retry_num++;
-            ESP_LOGI(TAG, "Retrying connection... (%d/%d)", s_retry_num, MAX_RETRY);
-        } else {
-            xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
+        if (s_is_connected) {
+            s_cycle_start_us = esp_timer_get_time();
         }
         s_is_connected = false;
+        xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+        esp_timer_stop(s_ip_timer);
+
+        // A pinned attempt only looked on one channel, that proves nothing
+        const wifi_event_sta_disconnected_t *event = event_data;
+        if (event->reason == WIFI_REASON_NO_AP_FOUND && !s_sta_config.sta.bssid_set) {
+            s_upstream_absent = true;
+        }
+
+        // Reconnects scan again, the AP may have moved since the fast connect.
+        // Never give up; back off so a missing AP does not keep the radio
+        // busy, and fail over to the next ranked network without a reboot.
+        wifi_retry_action_t action = wifi_retry_on_disconnect(&s_retry, s_store.count, esp_random());
+        if (s_sta_config.sta.bssid_set) {
+            wifi_unpin_ap(action.forget_cache);
+        }
+        if (action.forget_cache) {
+            wifi_start_attempt();
+            return;
+        }
+        if (action.failover) {
+            ESP_LOGW(TAG, "Giving up on SSID:%.32s for now", (const char *)s_sta_config.sta.ssid);
+        }
         ESP_LOGI(TAG, "Connection failed");
+        wifi_schedule_retry(action.delay_ms);
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
+        int64_t now = esp_timer_get_time();
         ESP_LOGI(TAG, "Got IP: " IPSTR, IP2STR(&event->ip_info.ip));
-        s_retry_num = 0;
+        esp_timer_stop(s_ip_timer);
+#if WIFI_FAST_CONNECT_IP
+        if (s_pinned_ip) {
+            s_pinned_ip = false;
+            wifi_probe_pinned_ip(event->ip_info.gw.addr);
+        }
+#endif
+        boot_trace_mark(BOOT_TRACE_WIFI_IP, s_retry.fast);
+
+        s_timings.assoc_ms = (s_assoc_us - s_attempt_start_us) / 1000;
+        s_timings.ip_ms = (now - s_assoc_us) / 1000;
+        s_timings.total_ms = (now - s_cycle_start_us) / 1000;
+        s_timings.attempts = s_retry.attempt + 1;
+        s_timings.fast_connect = s_retry.fast;
+        ESP_LOGI(TAG, "Connected in %lu ms (assoc %lu ms, IP %lu ms, %lu attempts%s)",
+                 (unsigned long)s_timings.total_ms, (unsigned long)s_timings.assoc_ms,
+                 (unsigned long)s_timings.ip_ms, (unsigned long)s_timings.attempts,
+                 s_retry.fast ? ", fast" : "");
+
+        wifi_retry_on_connected(&s_retry);
         s_is_connected = true;
+        wifi_save_cache(event);
+
+        // Recency feeds the ranking; skip the write if nothing changed.
+        // The profile may have been removed while this attempt ran.
+        wifi_profile_t *profile = s_current >= 0 ? &s_store.profiles[s_current] : NULL;
+        if (profile && (profile->last_success == 0 || profile->last_success != s_store.sequence)) {
+            profile->last_success = ++s_store.sequence;
+            wifi_store_save();
+        }
         xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
     }
 }
 
-esp_err_t wifi_save_credentials(const char *ssid, const char *password)
+static void event_handler(void* arg, esp_event_base_t event_base,
+                         int32_t event_id, void* event_data)
 {
-    nvs_handle_t nvs_handle;
-    esp_err_t err;
+    wifi_lock();
+    wifi_handle_event(event_base, event_id, event_data);
+    wifi_unlock();
+}
 
-    err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(err));
-        return err;
-    }
+// Profile indices moved or went away: find the network in use again by
+// name, and rank afresh on the next attempt
+static void wifi_store_reindex(void)
+{
+    char ssid[sizeof(s_sta_config.sta.ssid) + 1] = {0};
+    memcpy(ssid, s_sta_config.sta.ssid, sizeof(s_sta_config.sta.ssid));
+    s_current = s_current >= 0 ? wifi_store_find(ssid) : -1;
+    wifi_retry_set_candidates(&s_retry, 0);
+}
 
-    // Save SSID
-    err = nvs_set_str(nvs_handle, NVS_SSID_KEY, ssid);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to save SSID: %s", esp_err_to_name(err));
-        nvs_close(nvs_handle);
-        return err;
+esp_err_t wifi_save_credentials(const char *ssid, const char *password)
+{
+    if (ssid == NULL || password == NULL || ssid[0] == '\0' ||
+        strlen(ssid) >= sizeof(s_store.profiles[0].ssid) ||
+        strlen(password) >= sizeof(s_store.profiles[0].password)) {
+        return ESP_ERR_INVALID_ARG;
     }
+    wifi_lock();
+    wifi_store_load();
 
-    // Save password
-    err = nvs_set_str(nvs_handle, NVS_PASS_KEY, password);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to save password: %s", esp_err_to_name(err));
-        nvs_close(nvs_handle);
-        return err;
+    int index = wifi_store_find(ssid);
+    if (index < 0) {
+        if (s_store.count < WIFI_MAX_PROFILES) {
+            index = s_store.count++;
+        } else {
+            // Full: replace the network that has gone longest without connecting
+            index = 0;
+            for (int i = 1; i < s_store.count; i++) {
+                if (s_store.profiles[i].last_success < s_store.profiles[index].last_success) {
+                    index = i;
+                }
+            }
+            ESP_LOGW(TAG, "Profile store full, replacing SSID:%s", s_store.profiles[index].ssid);
+        }
+        memset(&s_store.profiles[index], 0, sizeof(s_store.profiles[index]));
+        strcpy(s_store.profiles[index].ssid, ssid);
     }
+    strcpy(s_store.profiles[index].password, password);
+    wifi_store_reindex();
 
-    // Commit changes
-    err = nvs_commit(nvs_handle);
-    nvs_close(nvs_handle);
-
+    esp_err_t err = wifi_store_save();
     if (err == ESP_OK) {
+        // The cached BSSID/lease may belong to a network that changed
+        wifi_clear_cache();
         ESP_LOGI(TAG, "WiFi credentials saved successfully");
     }
-
+    wifi_unlock();
     return err;
 }
 
-static esp_err_t wifi_load_credentials(char *ssid, size_t ssid_len, 
-                                       char *password, size_t pass_len)
+esp_err_t wifi_remove_credentials(const char *ssid)
 {
-    nvs_handle_t nvs_handle;
-    esp_err_t err;
+    wifi_lock();
+    wifi_store_load();
 
-    err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(err));
-        return err;
+    int index = wifi_store_find(ssid);
+    if (index < 0) {
+        wifi_unlock();
+        return ESP_ERR_NOT_FOUND;
     }
+    s_store.count--;
+    memmove(&s_store.profiles[index], &s_store.profiles[index + 1],
+            (s_store.count - index) * sizeof(wifi_profile_t));
+    memset(&s_store.profiles[s_store.count], 0, sizeof(wifi_profile_t));
+    wifi_store_reindex();
 
-    // Load SSID
-    err = nvs_get_str(nvs_handle, NVS_SSID_KEY, ssid, &ssid_len);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to load SSID: %s", esp_err_to_name(err));
-        nvs_close(nvs_handle);
-        return err;
+    esp_err_t err = wifi_store_save();
+    if (err == ESP_OK) {
+        wifi_clear_cache();
+        ESP_LOGI(TAG, "WiFi profile removed: SSID=%s", ssid);
     }
+    wifi_unlock();
+    return err;
+}
 
-    // Load password
-    err = nvs_get_str(nvs_handle, NVS_PASS_KEY, password, &pass_len);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to load password: %s", esp_err_to_name(err));
-        nvs_close(nvs_handle);
-        return err;
-    }
+int wifi_get_saved_ssids(char ssids[][33], int max)
+{
+    wifi_lock();
+    wifi_store_load();
 
-    nvs_close(nvs_handle);
-    ESP_LOGI(TAG, "WiFi credentials loaded: SSID=%s", ssid);
-    return ESP_OK;
+    int n = s_store.count < max ? s_store.count : max;
+    for (int i = 0; i < n; i++) {
+        strcpy(ssids[i], s_store.profiles[i].ssid);
+    }
+    wifi_unlock();
+    return n;
 }
 
-esp_err_t wifi_init(void)
+// Netif, event loop, driver and handlers; shared by station and recovery mode
+static void wifi_stack_init(bool with_ap)
 {
-    char ssid[33] = {0};
-    char password[64] = {0};
+    s_lock = xSemaphoreCreateMutex();
+    ESP_ERROR_CHECK(s_lock ? ESP_OK : ESP_ERR_NO_MEM);
 
     // Load credentials from NVS
-    esp_err_t err = wifi_load_credentials(ssid, sizeof(ssid), password, sizeof(password));
-    if (err != ESP_OK) {
+    wifi_lock();
+    wifi_store_load();
+    wifi_unlock();
+    if (s_store.count == 0) {
         ESP_LOGW(TAG, "No WiFi credentials found in NVS");
         // Set default credentials for first boot
-        strcpy(ssid, "IoT_M2M");
-        strcpy(password, "Mj02miat");
-        wifi_save_credentials(ssid, password);
+        wifi_save_credentials(WIFI_DEFAULT_SSID, WIFI_DEFAULT_PASS);
     }
 
     s_wifi_event_group = xEventGroupCreate();
 
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+    s_sta_netif = esp_netif_create_default_wifi_sta();
+    if (with_ap) {
+        esp_netif_create_default_wifi_ap();
+    }
+
+    esp_timer_create_args_t timer_args = {
+        .callback = wifi_retry_cb,
+        .name = "wifi_retry",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &s_retry_timer));
+    esp_timer_create_args_t ip_timer_args = {
+        .callback = wifi_ip_timeout_cb,
+        .name = "wifi_ip",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&ip_timer_args, &s_ip_timer));
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
@@ -153,7 +625,7 @@ esp_err_t wifi_init(void)
                                                         NULL,
                                                         &instance_got_ip));
 
-    wifi_config_t wifi_config = {
+    s_sta_config = (wifi_config_t){
         .sta = {
             .threshold.authmode = WIFI_AUTH_WPA2_PSK,
             .pmf_cfg = {
@@ -162,36 +634,92 @@ esp_err_t wifi_init(void)
             },
         },
     };
-    
-    // Copy credentials to wifi_config
-    strncpy((char *)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid));
-    strncpy((char *)wifi_config.sta.password, password, sizeof(wifi_config.sta.password));
+
+    // A cache hit skips the scan; otherwise STA_START scans and ranks profiles
+    if (wifi_load_cache() && wifi_apply_cache()) {
+        ESP_LOGI(TAG, "Fast connect: SSID:%s on channel %d", s_cache.ssid, s_cache.channel);
+    }
+}
+
+esp_err_t wifi_init(void)
+{
+    wifi_stack_init(false);
 
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &s_sta_config));
     ESP_ERROR_CHECK(esp_wifi_start());
 
-    ESP_LOGI(TAG, "WiFi initialization finished. Connecting to SSID:%s", ssid);
+    ESP_LOGI(TAG, "WiFi initialization finished");
 
-    // Wait for connection
+    // Wait for connection; retries continue in the background after a timeout
     EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
-            WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
+            WIFI_CONNECTED_BIT,
             pdFALSE,
             pdFALSE,
-            portMAX_DELAY);
+            pdMS_TO_TICKS(WIFI_CONNECT_TIMEOUT_MS));
 
     if (bits & WIFI_CONNECTED_BIT) {
-        ESP_LOGI(TAG, "Connected to AP SSID:%s", ssid);
+        ESP_LOGI(TAG, "Connected to AP SSID:%s", s_sta_config.sta.ssid);
         return ESP_OK;
-    } else if (bits & WIFI_FAIL_BIT) {
-        ESP_LOGI(TAG, "Failed to connect to SSID:%s", ssid);
-        return ESP_FAIL;
     }
 
+    ESP_LOGW(TAG, "Not connected yet, still retrying");
     return ESP_ERR_TIMEOUT;
 }
 
+esp_err_t wifi_start_recovery(const char *ap_ssid, const char *ap_password)
+{
+    if (strlen(ap_ssid) > 32 || strlen(ap_password) < 8 || strlen(ap_password) > 63) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    wifi_stack_init(true);
+
+    wifi_config_t ap_config = {
+        .ap = {
+            .max_connection = 4,
+            .authmode = WIFI_AUTH_WPA2_PSK,
+        },
+    };
+    strncpy((char *)ap_config.ap.ssid, ap_ssid, sizeof(ap_config.ap.ssid));
+    strncpy((char *)ap_config.ap.password, ap_password, sizeof(ap_config.ap.password));
+    ap_config.ap.ssid_len = strlen(ap_ssid);
+
+    // The AP follows the channel of the upstream network once it connects
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_APSTA));
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &ap_config));
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &s_sta_config));
+    ESP_ERROR_CHECK(esp_wifi_start());
+
+    ESP_LOGI(TAG, "AP started: SSID=%s, upstream connection in the background", ap_ssid);
+    return ESP_OK;
+}
+
+void wifi_reconnect(void)
+{
+    wifi_lock();
+    if (!s_is_connected) {
+        // Rank the saved profiles afresh, a new one may be in range; the attempt
+        // runs from the retry timer like every other one
+        esp_timer_stop(s_retry_timer);
+        wifi_retry_restart(&s_retry);
+        esp_timer_start_once(s_retry_timer, 0);
+    }
+    wifi_unlock();
+}
+
 bool wifi_is_connected(void)
 {
     return s_is_connected;
+}
+
+bool wifi_upstream_absent(void)
+{
+    return s_upstream_absent;
+}
+
+void wifi_get_timings(wifi_timings_t *timings)
+{
+    wifi_lock();
+    *timings = s_timings;
+    wifi_unlock();
 }
\ No newline at end of file
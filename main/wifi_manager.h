@@ -3,21 +3,97 @@
 
 #include "esp_err.h"
 #include <stdbool.h>
+#include <stdint.h>
+
+#ifndef WIFI_CONNECT_TIMEOUT_MS
+#define WIFI_CONNECT_TIMEOUT_MS 15000   // wifi_init() wait, retries go on afterwards
+#endif
+#ifndef WIFI_BACKOFF_MIN_MS
+#define WIFI_BACKOFF_MIN_MS     500
+#endif
+#ifndef WIFI_BACKOFF_MAX_MS
+#define WIFI_BACKOFF_MAX_MS     60000
+#endif
+#ifndef WIFI_MAX_PROFILES
+#define WIFI_MAX_PROFILES       4       // Saved networks
+#endif
+#ifndef WIFI_FAILOVER_ATTEMPTS
+#define WIFI_FAILOVER_ATTEMPTS  3       // Failures before trying the next network
+#endif
+#ifndef WIFI_RECENT_BONUS_DB
+#define WIFI_RECENT_BONUS_DB    10      // Ranking bonus for the last network that worked
+#endif
+// Reuse the cached IP lease on fast connect as a static address: skips DHCP,
+// but the address is never renewed; only for networks with fixed reservations
+#ifndef WIFI_FAST_CONNECT_IP
+#define WIFI_FAST_CONNECT_IP    0
+#endif
+#ifndef WIFI_FAST_IP_TIMEOUT_MS
+#define WIFI_FAST_IP_TIMEOUT_MS 5000    // Fast connect associated but no IP by then: drop the cache
+#endif
+
+typedef struct {
+    uint32_t assoc_ms;          // Connect attempt to association
+    uint32_t ip_ms;             // Association to IP
+    uint32_t total_ms;          // Wi-Fi start (or link loss) to IP, including retries
+    uint32_t attempts;          // Attempts it took
+    bool fast_connect;          // Used the cached BSSID/channel
+} wifi_timings_t;
 
 /**
  * @brief Initialize WiFi in Station mode
- * Reads WiFi credentials from NVS and connects
+ * Loads the saved networks, scans once and connects to the best ranked one
+ * (or directly to the last known AP when cached). Reconnects forever with
+ * exponential backoff, failing over between saved networks.
+ * @return ESP_ERR_TIMEOUT if not connected within WIFI_CONNECT_TIMEOUT_MS
  */
 esp_err_t wifi_init(void);
 
 /**
- * @brief Save WiFi credentials to NVS
+ * @brief Start the recovery portal AP next to the station (AP+STA)
+ * Same stack, profiles and reconnect logic as wifi_init(), so an update
+ * triggered from the portal can reach the real firmware server while the
+ * technician stays on the AP. Does not wait for the upstream connection.
+ */
+esp_err_t wifi_start_recovery(const char *ap_ssid, const char *ap_password);
+
+/**
+ * @brief Try the saved networks again now, e.g. after adding one
+ * Does nothing while connected.
+ */
+void wifi_reconnect(void);
+
+/**
+ * @brief Add a network profile, or update the password of an existing one
+ * The least recently used profile is replaced when all slots are taken.
  */
 esp_err_t wifi_save_credentials(const char *ssid, const char *password);
 
+/**
+ * @brief Delete the profile for ssid
+ * @return ESP_ERR_NOT_FOUND if no such profile
+ */
+esp_err_t wifi_remove_credentials(const char *ssid);
+
+/**
+ * @brief Copy up to max saved SSIDs, returns how many were written
+ */
+int wifi_get_saved_ssids(char ssids[][33], int max);
+
 /**
  * @brief Check if WiFi is connected
  */
 bool wifi_is_connected(void);
 
+/**
+ * @brief True when the station searched and none of the saved networks was on the air
+ * The radio works then, the network is just not there. Cleared on association.
+ */
+bool wifi_upstream_absent(void);
+
+/**
+ * @brief Phase timings of the most recent successful connection
+ */
+void wifi_get_timings(wifi_timings_t *timings);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,96 @@
+#include "wifi_policy.h"
+#include <string.h>
+
+int wifi_rank_profiles(const wifi_profile_t *profiles, int count,
+                       const wifi_scan_ap_t *aps, int ap_count, uint8_t *order)
+{
+    int score[WIFI_MAX_PROFILES];
+    int n = 0;
+
+    for (int i = 0; i < count; i++) {
+        const wifi_profile_t *profile = &profiles[i];
+        int best_rssi = INT8_MIN - 1;
+        for (int a = 0; a < ap_count; a++) {
+            if (strcmp(aps[a].ssid, profile->ssid) == 0 && aps[a].rssi > best_rssi) {
+                best_rssi = aps[a].rssi;
+            }
+        }
+        if (best_rssi < INT8_MIN) {
+            continue;   // Not in range
+        }
+
+        int newer = 0;
+        for (int j = 0; j < count; j++) {
+            if (profiles[j].last_success > profile->last_success) {
+                newer++;
+            }
+        }
+        int bonus = profile->last_success ? (WIFI_RECENT_BONUS_DB >> newer) : 0;
+
+        // Insertion sort, at most WIFI_MAX_PROFILES entries
+        int pos = n++;
+        while (pos > 0 && score[pos - 1] < best_rssi + bonus) {
+            score[pos] = score[pos - 1];
+            order[pos] = order[pos - 1];
+            pos--;
+        }
+        score[pos] = best_rssi + bonus;
+        order[pos] = i;
+    }
+    return n;
+}
+
+uint32_t wifi_backoff_ms(uint32_t attempt, uint32_t random)
+{
+    uint32_t shift = attempt < 16 ? attempt : 16;
+    uint32_t delay = WIFI_BACKOFF_MIN_MS << shift;
+    if (delay > WIFI_BACKOFF_MAX_MS) {
+        delay = WIFI_BACKOFF_MAX_MS;
+    }
+    return delay / 2 + random % (delay / 2 + 1);
+}
+
+uint32_t wifi_retry_backoff(wifi_retry_t *retry, uint32_t random)
+{
+    return wifi_backoff_ms(retry->attempt++, random);
+}
+
+void wifi_retry_set_candidates(wifi_retry_t *retry, int count)
+{
+    retry->order_count = count;
+    retry->order_pos = 0;
+}
+
+wifi_retry_action_t wifi_retry_on_disconnect(wifi_retry_t *retry, int profile_count, uint32_t random)
+{
+    wifi_retry_action_t action = { 0 };
+
+    // The cached AP may have moved or the lease expired; scan now instead
+    if (retry->fast) {
+        retry->fast = false;
+        action.forget_cache = true;
+        return action;
+    }
+
+    if (++retry->profile_failures >= WIFI_FAILOVER_ATTEMPTS && profile_count > 1) {
+        retry->profile_failures = 0;
+        retry->order_pos++;
+        action.failover = true;
+    }
+    action.delay_ms = wifi_retry_backoff(retry, random);
+    return action;
+}
+
+void wifi_retry_on_connected(wifi_retry_t *retry)
+{
+    retry->attempt = 0;
+    retry->profile_failures = 0;
+    retry->fast = false;
+}
+
+void wifi_retry_restart(wifi_retry_t *retry)
+{
+    retry->attempt = 0;
+    retry->profile_failures = 0;
+    retry->order_pos = retry->order_count;
+}
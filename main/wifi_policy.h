@@ -0,0 +1,89 @@
+#ifndef WIFI_POLICY_H
+#define WIFI_POLICY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "wifi_manager.h"
+
+/**
+ * Connection decisions of wifi_manager.c, internal to it. Pure functions of
+ * the saved profiles, scan results and connection events, without esp_wifi,
+ * timers or NVS, so they build and are tested on the host.
+ */
+
+typedef struct {
+    char ssid[33];
+    char password[65];
+    uint32_t last_success;      // Store sequence number of the last connect, 0 = never
+} wifi_profile_t;
+
+// What ranking needs from a scan record
+typedef struct {
+    char ssid[33];
+    int8_t rssi;
+} wifi_scan_ap_t;
+
+/**
+ * @brief Order the profiles visible in a scan, strongest first
+ * The network that connected most recently gets WIFI_RECENT_BONUS_DB, the one
+ * before it half of that, and so on. Equal scores keep the profile order.
+ * @param order Receives profile indices, at least WIFI_MAX_PROFILES entries
+ * @return Number of candidates written to order
+ */
+int wifi_rank_profiles(const wifi_profile_t *profiles, int count,
+                       const wifi_scan_ap_t *aps, int ap_count, uint8_t *order);
+
+// Retry state between connection events
+typedef struct {
+    uint32_t attempt;           // Failed attempts since the last success
+    uint32_t profile_failures;  // Failed attempts on the current candidate
+    int order_pos;              // Candidate being tried; order_count = scan again
+    int order_count;            // Ranked candidates from the last scan
+    bool fast;                  // Attempt uses the cached BSSID/channel/IP
+} wifi_retry_t;
+
+// What to do after a failed attempt
+typedef struct {
+    uint32_t delay_ms;          // Until the next attempt, 0 = right away
+    bool forget_cache;          // Fast attempt failed: drop the cached AP and lease
+    bool failover;              // Gave up on the current candidate, order_pos moved on
+} wifi_retry_action_t;
+
+/**
+ * @brief Exponential backoff with equal jitter: half fixed, half random
+ * WIFI_BACKOFF_MIN_MS doubling per attempt up to WIFI_BACKOFF_MAX_MS.
+ * @param random Any 32-bit random value (esp_random() on the device)
+ */
+uint32_t wifi_backoff_ms(uint32_t attempt, uint32_t random);
+
+/**
+ * @brief Delay before the next attempt, counting this one as failed
+ */
+uint32_t wifi_retry_backoff(wifi_retry_t *retry, uint32_t random);
+
+/**
+ * @brief Start on a freshly ranked candidate list
+ */
+void wifi_retry_set_candidates(wifi_retry_t *retry, int count);
+
+/**
+ * @brief Station disconnected before getting (or after losing) an IP
+ * A failed fast attempt drops the cache and retries at once with a scan,
+ * without counting against the backoff. Otherwise the attempt counts, and
+ * after WIFI_FAILOVER_ATTEMPTS on one of several profiles the next candidate
+ * is tried.
+ * @param profile_count Saved profiles; a single one never fails over
+ */
+wifi_retry_action_t wifi_retry_on_disconnect(wifi_retry_t *retry, int profile_count, uint32_t random);
+
+/**
+ * @brief Got an IP: the next loss starts from the shortest backoff
+ */
+void wifi_retry_on_connected(wifi_retry_t *retry);
+
+/**
+ * @brief Start over with a fresh scan and no backoff (profiles edited)
+ */
+void wifi_retry_restart(wifi_retry_t *retry);
+
+#endif
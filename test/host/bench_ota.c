@@ -0,0 +1,177 @@
+// Throughput of the OTA engine on the host, per network chunk size and
+// container format, with first-byte latency and memory use of each run.
+// Absolute numbers are the host's, the ratios between rows are what carry
+// over to the device; --flash-timing adds NOR-like erase/program delays.
+//
+//   ota_bench [--quick] [--size KB] [--latency-ms N] [--flash-timing]
+
+#include "host_image.h"
+#include "host_stubs.h"
+#include "host_transport.h"
+#include "esp_timer.h"
+#include "ota_arena.h"
+#include "ota_engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SLOT_SIZE   (2 * 1024 * 1024)
+
+static esp_partition_t *running;
+static esp_partition_t *next;
+
+typedef struct {
+    int64_t start_us;
+    int64_t first_byte_us;      // First decoded firmware byte, relative to start
+} bench_progress_t;
+
+static void bench_on_progress(ota_phase_t phase, int done, int total, void *arg)
+{
+    bench_progress_t *progress = arg;
+    if (phase == OTA_PHASE_DOWNLOADING && done > 0 && progress->first_byte_us < 0) {
+        progress->first_byte_us = esp_timer_get_time() - progress->start_us;
+    }
+}
+
+static int bench_run(const char *label, const uint8_t *data, size_t len, size_t chunk,
+                     uint32_t latency_us, size_t image_size)
+{
+    host_source_t source;
+    host_source_init(&source, data, len);
+    source.chunk = chunk;
+    source.first_byte_us = latency_us;
+    ota_transport_t transport;
+    host_transport_init(&transport, &source);
+
+    bench_progress_t progress = { .first_byte_us = -1 };
+    ota_update_config_t config = OTA_UPDATE_CONFIG_DEFAULT();
+    config.progress = bench_on_progress;
+    config.progress_arg = &progress;
+
+    esp_partition_erase_range(next, 0, SLOT_SIZE);
+    ota_arena_reset();
+    host_heap_stats_t heap_before, heap_after;
+    host_heap_get_stats(&heap_before);
+    progress.start_us = esp_timer_get_time();
+    esp_err_t err = ota_engine_run(&transport, &config, next);
+    int64_t elapsed_us = esp_timer_get_time() - progress.start_us;
+    host_heap_get_stats(&heap_after);
+
+    ota_arena_stats_t arena;
+    ota_arena_get_stats(&arena);
+    if (err != ESP_OK) {
+        printf("%-22s %7zu  FAILED: %s\n", label, chunk, esp_err_to_name(err));
+        return 1;
+    }
+    printf("%-22s %7zu %9zu %9.2f %9.2f %9.2f %8.2f %7zu %7u %8zu\n", label, chunk, len,
+           elapsed_us / 1000.0,
+           image_size / 1024.0 / 1024.0 / (elapsed_us / 1e6),
+           len / 1024.0 / 1024.0 / (elapsed_us / 1e6),
+           progress.first_byte_us / 1000.0,
+           arena.used,
+           (unsigned)(heap_after.allocs - heap_before.allocs),
+           heap_after.bytes - heap_before.bytes);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    size_t image_size = 1024 * 1024;
+    uint32_t latency_us = 20000;
+    bool quick = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+            image_size = 128 * 1024;
+            latency_us = 0;
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            image_size = (size_t)atoi(argv[++i]) * 1024;
+        } else if (strcmp(argv[i], "--latency-ms") == 0 && i + 1 < argc) {
+            latency_us = (uint32_t)atoi(argv[++i]) * 1000;
+        } else if (strcmp(argv[i], "--flash-timing") == 0) {
+            // Typical SPI NOR: ~45 ms per 4 KB erase, ~2.5 ms per KB programmed
+            host_flash_set_timing(45000, 2500);
+        } else {
+            fprintf(stderr, "usage: %s [--quick] [--size KB] [--latency-ms N] [--flash-timing]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (image_size < 8192 || image_size > SLOT_SIZE) {
+        fprintf(stderr, "image size must be between 8 KB and %d KB\n", SLOT_SIZE / 1024);
+        return 2;
+    }
+
+    running = host_partition_create("ota_0", 0x10000, SLOT_SIZE, NULL);
+    next = host_partition_create("ota_1", 0x10000 + SLOT_SIZE, SLOT_SIZE, NULL);
+    host_partition_set_slots(running, next);
+    ota_arena_init();
+
+    // Running image for the delta rows; the new one changes every 16th sector
+    uint8_t *base = host_image_app(image_size, "1.0.0", 1);
+    uint8_t *other = host_image_app(image_size, "1.1.0", 2);
+    uint8_t *image = malloc(image_size);
+    memcpy(image, base, image_size);
+    for (size_t offset = 0; offset < image_size; offset += 16 * 4096) {
+        size_t n = image_size - offset < 4096 ? image_size - offset : 4096;
+        memcpy(image + offset, other + offset, n);
+    }
+    esp_partition_write(running, 0, base, image_size);
+
+    size_t header_len, deflate_len, blocks_len, delta_len;
+    host_container_t opts = { .version = 0x010100 };
+    uint8_t *header = host_container_build(image, image_size, &opts, &header_len);
+    opts.compress = true;
+    uint8_t *deflate = host_container_build(image, image_size, &opts, &deflate_len);
+    opts.block_size = 4096;
+    uint8_t *blocks = host_container_build(image, image_size, &opts, &blocks_len);
+    opts.block_size = 0;
+    opts.base = base;
+    opts.base_len = image_size;
+    uint8_t *delta = host_container_build(image, image_size, &opts, &delta_len);
+
+    printf("image %zu KB, first-byte latency %u ms per response\n\n",
+           image_size / 1024, (unsigned)(latency_us / 1000));
+    printf("%-22s %7s %9s %9s %9s %9s %8s %7s %7s %8s\n", "format", "chunk", "stream", "ms",
+           "MB/s img", "MB/s net", "1st ms", "arena", "mallocs", "bytes");
+
+    static const size_t chunks[] = { 256, 1460, 4096, 16384 };
+    static const size_t quick_chunks[] = { 1460 };
+    const size_t *chunk_list = quick ? quick_chunks : chunks;
+    size_t chunk_count = quick ? 1 : sizeof(chunks) / sizeof(chunks[0]);
+
+    int failures = 0;
+    for (size_t i = 0; i < chunk_count; i++) {
+        failures += bench_run("raw", image, image_size, chunk_list[i], latency_us, image_size);
+    }
+    for (size_t i = 0; i < chunk_count; i++) {
+        failures += bench_run("header", header, header_len, chunk_list[i], latency_us, image_size);
+    }
+    for (size_t i = 0; i < chunk_count; i++) {
+        failures += bench_run("header+deflate", deflate, deflate_len, chunk_list[i], latency_us, image_size);
+    }
+    for (size_t i = 0; i < chunk_count; i++) {
+        failures += bench_run("header+deflate+blocks", blocks, blocks_len, chunk_list[i], latency_us, image_size);
+    }
+    for (size_t i = 0; i < chunk_count; i++) {
+        failures += bench_run("delta+deflate", delta, delta_len, chunk_list[i], latency_us, image_size);
+    }
+
+    ota_arena_stats_t arena;
+    ota_arena_get_stats(&arena);
+    host_flash_stats_t flash;
+    host_flash_get_stats(&flash);
+    printf("\narena high water %zu of %zu bytes; flash %u erases, %u unerased writes\n",
+           arena.high_water, arena.size, (unsigned)flash.erase_ops, (unsigned)flash.unerased_writes);
+
+    free(delta);
+    free(blocks);
+    free(deflate);
+    free(header);
+    free(image);
+    free(other);
+    free(base);
+    host_partition_delete(next);
+    host_partition_delete(running);
+    return failures || flash.unerased_writes ? 1 : 0;
+}
@@ -0,0 +1,181 @@
+// esp_err, esp_log, esp_timer, heap_caps, esp_random, app description and efuse stand-ins
+
+#include "esp_app_desc.h"
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_netif_sntp.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "hal/efuse_hal.h"
+#include "host_stubs.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+        case ESP_OK:                      return "ESP_OK";
+        case ESP_FAIL:                    return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:              return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:         return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE:       return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:        return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:           return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED:       return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT:             return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_INVALID_RESPONSE:    return "ESP_ERR_INVALID_RESPONSE";
+        case ESP_ERR_INVALID_CRC:         return "ESP_ERR_INVALID_CRC";
+        case ESP_ERR_INVALID_VERSION:     return "ESP_ERR_INVALID_VERSION";
+        case ESP_ERR_NOT_FINISHED:        return "ESP_ERR_NOT_FINISHED";
+        case ESP_ERR_NOT_ALLOWED:         return "ESP_ERR_NOT_ALLOWED";
+        case ESP_ERR_NVS_NOT_FOUND:       return "ESP_ERR_NVS_NOT_FOUND";
+        case ESP_ERR_OTA_VALIDATE_FAILED: return "ESP_ERR_OTA_VALIDATE_FAILED";
+        default:                          return "UNKNOWN ERROR";
+    }
+}
+
+static int log_level = -1;
+
+void host_log_set_level(esp_log_level_t level)
+{
+    log_level = level;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    if (log_level < 0) {
+        const char *env = getenv("OTA_HOST_LOG");
+        const char *levels = "-EWIDV";
+        const char *found = env && env[0] ? strchr(levels, env[0]) : NULL;
+        log_level = found ? (int)(found - levels) : ESP_LOG_WARN;
+    }
+    if ((int)level > log_level) {
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "%c (%lld) %s: ", "-EWIDV"[level], (long long)(esp_timer_get_time() / 1000), tag);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+int64_t esp_timer_get_time(void)
+{
+    static struct timespec start;
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (start.tv_sec == 0 && start.tv_nsec == 0) {
+        start = now;
+    }
+    return (int64_t)(now.tv_sec - start.tv_sec) * 1000000 + (now.tv_nsec - start.tv_nsec) / 1000;
+}
+
+// General heap accounting, see host_heap_stats_t
+static uint32_t heap_allocs;
+static size_t heap_bytes;
+
+void *__wrap_malloc(size_t size)
+{
+    __atomic_fetch_add(&heap_allocs, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&heap_bytes, size, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    __atomic_fetch_add(&heap_allocs, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&heap_bytes, count * size, __ATOMIC_RELAXED);
+    return __real_calloc(count, size);
+}
+
+void host_heap_get_stats(host_heap_stats_t *stats)
+{
+    stats->allocs = __atomic_load_n(&heap_allocs, __ATOMIC_RELAXED);
+    stats->bytes = __atomic_load_n(&heap_bytes, __ATOMIC_RELAXED);
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    return malloc(size);
+}
+
+void heap_caps_free(void *ptr)
+{
+    free(ptr);
+}
+
+static size_t heap_free = 1024 * 1024;
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    return __atomic_load_n(&heap_free, __ATOMIC_RELAXED);
+}
+
+void host_heap_set_free(size_t bytes)
+{
+    __atomic_store_n(&heap_free, bytes, __ATOMIC_RELAXED);
+}
+
+uint32_t esp_random(void)
+{
+    // xorshift32; the exact values never matter, only that runs repeat
+    static uint32_t state = 2463534242u;
+    uint32_t x = __atomic_load_n(&state, __ATOMIC_RELAXED);
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    __atomic_store_n(&state, x, __ATOMIC_RELAXED);
+    return x;
+}
+
+static esp_app_desc_t app_desc = {
+    .magic_word = ESP_APP_DESC_MAGIC_WORD,
+    .version = "1.0.0",
+    .project_name = "secure-ota-esp32",
+    .idf_ver = "v5.4-host",
+    .app_elf_sha256 = { 0x5e, 0xc0, 0x7a, 0x32, 0x9b, 0x01, 0xd4, 0x6f, 0x88, 0x2c, 0xe1, 0x47, 0x03, 0xba, 0x96, 0x1d },
+};
+
+const esp_app_desc_t *esp_app_get_description(void)
+{
+    return &app_desc;
+}
+
+esp_app_desc_t *host_app_desc(void)
+{
+    return &app_desc;
+}
+
+int esp_app_get_elf_sha256(char *dst, size_t size)
+{
+    size_t n = 0;
+    for (; n + 2 < size && n / 2 < sizeof(app_desc.app_elf_sha256); n += 2) {
+        sprintf(dst + n, "%02x", app_desc.app_elf_sha256[n / 2]);
+    }
+    dst[n] = '\0';
+    return n + 1;
+}
+
+static uint32_t chip_revision = 300;    // v3.0
+
+uint32_t efuse_hal_chip_revision(void)
+{
+    return chip_revision;
+}
+
+void host_set_chip_revision(uint32_t revision)
+{
+    chip_revision = revision;
+}
+
+esp_err_t esp_netif_sntp_init(const esp_sntp_config_t *config)
+{
+    return ESP_OK;
+}
@@ -0,0 +1,324 @@
+// esp_http_client over sockets: http://host:port/path GETs with extra
+// headers, Content-Length or chunked bodies, and ON_HEADER events
+
+#include "esp_http_client.h"
+#include "host_stubs.h"
+#include <errno.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define HOST_HTTP_MAX_HEADERS   8
+
+struct esp_http_client {
+    char host[64];
+    char port[8];
+    char path[256];
+    int timeout_ms;
+    bool keep_alive;
+    http_event_handle_cb event_handler;
+    void *user_data;
+    char hdr_key[HOST_HTTP_MAX_HEADERS][32];
+    char hdr_value[HOST_HTTP_MAX_HEADERS][96];
+
+    int fd;                     // -1 when not connected
+    bool reused;                // This request went out on a kept-alive connection
+    char buf[4096];             // Received, not yet consumed
+    size_t buf_pos;
+    size_t buf_len;
+
+    int status;
+    int64_t content_length;     // -1 for chunked
+    int64_t body_left;          // Content-Length bytes, or of the current chunk
+    bool chunked;
+    bool body_done;
+};
+
+static bool fill(esp_http_client_handle_t client)
+{
+    if (client->buf_pos == client->buf_len) {
+        client->buf_pos = client->buf_len = 0;
+    }
+    if (client->buf_len == sizeof(client->buf)) {
+        memmove(client->buf, client->buf + client->buf_pos, client->buf_len - client->buf_pos);
+        client->buf_len -= client->buf_pos;
+        client->buf_pos = 0;
+    }
+    ssize_t n;
+    do {
+        n = recv(client->fd, client->buf + client->buf_len, sizeof(client->buf) - client->buf_len, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        return false;
+    }
+    client->buf_len += n;
+    return true;
+}
+
+// One CRLF-terminated line without the CRLF, NULL if the connection ended
+static char *read_line(esp_http_client_handle_t client)
+{
+    char *end;
+    while ((end = memmem(client->buf + client->buf_pos, client->buf_len - client->buf_pos, "\r\n", 2)) == NULL) {
+        if (!fill(client)) {
+            return NULL;
+        }
+    }
+    char *line = client->buf + client->buf_pos;
+    *end = '\0';
+    client->buf_pos = end + 2 - client->buf;
+    return line;
+}
+
+static void disconnect(esp_http_client_handle_t client)
+{
+    if (client->fd >= 0) {
+        close(client->fd);
+        client->fd = -1;
+    }
+    client->buf_pos = client->buf_len = 0;
+}
+
+static bool connect_server(esp_http_client_handle_t client)
+{
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *res;
+    if (getaddrinfo(client->host, client->port, &hints, &res) != 0) {
+        return false;
+    }
+    client->fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    bool ok = client->fd >= 0 && connect(client->fd, res->ai_addr, res->ai_addrlen) == 0;
+    freeaddrinfo(res);
+    if (!ok) {
+        disconnect(client);
+        return false;
+    }
+    struct timeval tv = { .tv_sec = client->timeout_ms / 1000, .tv_usec = client->timeout_ms % 1000 * 1000 };
+    setsockopt(client->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(client->fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    return true;
+}
+
+static bool send_request(esp_http_client_handle_t client)
+{
+    char req[1024];
+    int len = snprintf(req, sizeof(req), "GET %s HTTP/1.1\r\nHost: %s:%s\r\nUser-Agent: ESP32 HTTP Client/1.0\r\n",
+                       client->path, client->host, client->port);
+    for (int i = 0; i < HOST_HTTP_MAX_HEADERS; i++) {
+        if (client->hdr_key[i][0] != '\0') {
+            len += snprintf(req + len, sizeof(req) - len, "%s: %s\r\n", client->hdr_key[i], client->hdr_value[i]);
+        }
+    }
+    len += snprintf(req + len, sizeof(req) - len, "%s\r\n", client->keep_alive ? "" : "Connection: close\r\n");
+    return send(client->fd, req, len, MSG_NOSIGNAL) == len;
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    esp_http_client_handle_t client = __real_calloc(1, sizeof(*client));
+    if (client == NULL) {
+        return NULL;
+    }
+    if (sscanf(config->url, "http://%63[^:/]:%7[0-9]%255s", client->host, client->port, client->path) < 2 &&
+        sscanf(config->url, "http://%63[^:/]%255s", client->host, client->path) < 1) {
+        free(client);
+        return NULL;
+    }
+    if (client->port[0] == '\0') {
+        strcpy(client->port, "80");
+    }
+    if (client->path[0] == '\0') {
+        strcpy(client->path, "/");
+    }
+    client->timeout_ms = config->timeout_ms > 0 ? config->timeout_ms : 5000;
+    client->keep_alive = config->keep_alive_enable;
+    client->event_handler = config->event_handler;
+    client->user_data = config->user_data;
+    client->fd = -1;
+    return client;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len)
+{
+    // Reuse the connection only if nothing of the last response is pending
+    client->reused = client->fd >= 0 && client->keep_alive && client->body_done;
+    if (!client->reused) {
+        disconnect(client);
+    }
+    client->status = 0;
+    client->body_done = false;
+    if (client->reused && send_request(client)) {
+        return ESP_OK;
+    }
+
+    client->reused = false;
+    disconnect(client);
+    if (!connect_server(client)) {
+        return ESP_ERR_HTTP_CONNECT;
+    }
+    if (!send_request(client)) {
+        disconnect(client);
+        return ESP_ERR_HTTP_WRITE_DATA;
+    }
+    return ESP_OK;
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client)
+{
+    if (client->fd < 0) {
+        return ESP_FAIL;
+    }
+    char *line = read_line(client);
+    if (line == NULL && client->reused) {
+        // The server closed the idle connection; ask again on a new one
+        client->reused = false;
+        disconnect(client);
+        if (!connect_server(client) || !send_request(client)) {
+            disconnect(client);
+            return ESP_FAIL;
+        }
+        line = read_line(client);
+    }
+    if (line == NULL || sscanf(line, "HTTP/1.%*d %d", &client->status) != 1) {
+        disconnect(client);
+        return ESP_FAIL;
+    }
+
+    client->content_length = 0;
+    client->chunked = false;
+    while ((line = read_line(client)) != NULL && line[0] != '\0') {
+        char *colon = strchr(line, ':');
+        if (colon == NULL) {
+            continue;
+        }
+        *colon = '\0';
+        char *value = colon + 1;
+        while (*value == ' ') {
+            value++;
+        }
+        if (strcasecmp(line, "Content-Length") == 0) {
+            client->content_length = strtoll(value, NULL, 10);
+        } else if (strcasecmp(line, "Transfer-Encoding") == 0 && strcasecmp(value, "chunked") == 0) {
+            client->chunked = true;
+        }
+        if (client->event_handler != NULL) {
+            esp_http_client_event_t evt = {
+                .event_id = HTTP_EVENT_ON_HEADER,
+                .client = client,
+                .user_data = client->user_data,
+                .header_key = line,
+                .header_value = value,
+            };
+            client->event_handler(&evt);
+        }
+    }
+    if (line == NULL) {
+        disconnect(client);
+        return ESP_FAIL;
+    }
+
+    if (client->status == 304 || client->status == 204) {
+        client->content_length = 0;
+    }
+    if (client->chunked) {
+        client->content_length = -1;
+        client->body_left = 0;
+    } else {
+        client->body_left = client->content_length;
+    }
+    client->body_done = !client->chunked && client->body_left == 0;
+    return client->content_length;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client)
+{
+    return client->status;
+}
+
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
+{
+    if (client->body_done) {
+        return 0;
+    }
+    if (client->fd < 0) {
+        return ESP_FAIL;
+    }
+    if (client->chunked && client->body_left == 0) {
+        char *line = read_line(client);
+        if (line != NULL && line[0] == '\0') {
+            line = read_line(client);   // CRLF closing the previous chunk
+        }
+        if (line == NULL) {
+            return ESP_FAIL;
+        }
+        client->body_left = strtoll(line, NULL, 16);
+        if (client->body_left == 0) {
+            read_line(client);          // Empty trailer
+            client->body_done = true;
+            return 0;
+        }
+    }
+
+    if (len > client->body_left) {
+        len = client->body_left;
+    }
+    if (client->buf_pos == client->buf_len && !fill(client)) {
+        return ESP_FAIL;
+    }
+    int n = client->buf_len - client->buf_pos;
+    if (n > len) {
+        n = len;
+    }
+    memcpy(buffer, client->buf + client->buf_pos, n);
+    client->buf_pos += n;
+    client->body_left -= n;
+    if (!client->chunked && client->body_left == 0) {
+        client->body_done = true;
+    }
+    return n;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value)
+{
+    int slot = -1;
+    for (int i = 0; i < HOST_HTTP_MAX_HEADERS; i++) {
+        if (strcasecmp(client->hdr_key[i], key) == 0 || (slot < 0 && client->hdr_key[i][0] == '\0')) {
+            slot = i;
+        }
+    }
+    if (slot < 0 || strlen(key) >= sizeof(client->hdr_key[0]) || strlen(value) >= sizeof(client->hdr_value[0])) {
+        return ESP_ERR_NO_MEM;
+    }
+    strcpy(client->hdr_key[slot], key);
+    strcpy(client->hdr_value[slot], value);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t client, const char *key)
+{
+    for (int i = 0; i < HOST_HTTP_MAX_HEADERS; i++) {
+        if (strcasecmp(client->hdr_key[i], key) == 0) {
+            client->hdr_key[i][0] = '\0';
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client)
+{
+    disconnect(client);
+    client->body_done = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
+{
+    disconnect(client);
+    free(client);
+    return ESP_OK;
+}
@@ -0,0 +1,490 @@
+// esp_http_server on 127.0.0.1: enough HTTP/1.1 for the portal handlers,
+// the peer server and the event stream, plus in-memory upload bodies
+
+#include "esp_http_server.h"
+#include "host_stubs.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define HOST_HTTPD_MAX_HANDLERS 16
+#define HOST_HTTPD_MAX_HEADERS  32
+#define HOST_HTTPD_MAX_RESP_HDR 8
+#define HOST_HTTPD_BUF_SIZE     4096    // Request head plus whatever followed it
+#define HOST_HTTPD_SNDBUF       8192    // Small, like lwIP, so a stalled reader blocks the sender
+#define HOST_HTTPD_SEND_TIMEOUT_MS 2000 // send_wait_timeout (5s on the device), then the send fails
+
+typedef struct {
+    int listen_fd;
+    pthread_mutex_t lock;
+    httpd_uri_t handlers[HOST_HTTPD_MAX_HANDLERS];
+    int handler_count;
+} host_httpd_t;
+
+typedef struct {
+    host_httpd_t *server;
+    int fd;
+    char buf[HOST_HTTPD_BUF_SIZE];      // Bytes read past the current request head
+    size_t buf_len;
+    char head[HOST_HTTPD_BUF_SIZE];     // Current request head, split into strings
+    const char *hdr_name[HOST_HTTPD_MAX_HEADERS];
+    const char *hdr_value[HOST_HTTPD_MAX_HEADERS];
+    int hdr_count;
+    size_t body_left;
+    bool keep_alive;
+
+    // Response of the current request
+    const char *status;
+    const char *type;
+    const char *resp_name[HOST_HTTPD_MAX_RESP_HDR];
+    const char *resp_value[HOST_HTTPD_MAX_RESP_HDR];
+    int resp_count;
+    bool head_sent;
+    bool chunked;
+    bool finished;              // Last chunk sent, or a sized response
+    bool failed;                // A send failed, the connection is closed
+
+    // Async handler hand-off
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool async;
+    bool async_done;
+} host_conn_t;
+
+static host_conn_t *conn_of(httpd_req_t *req)
+{
+    return req->handle != NULL ? (host_conn_t *)req->aux : NULL;
+}
+
+static bool send_all(host_conn_t *conn, const char *buf, size_t len)
+{
+    while (len > 0 && !conn->failed) {
+        ssize_t n = send(conn->fd, buf, len, MSG_NOSIGNAL);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            conn->failed = true;
+            break;
+        }
+        buf += n;
+        len -= n;
+    }
+    return !conn->failed;
+}
+
+// Reads the next request head into conn->head; false once the client is gone
+static bool read_head(host_conn_t *conn)
+{
+    char *end;
+    while ((end = memmem(conn->buf, conn->buf_len, "\r\n\r\n", 4)) == NULL) {
+        if (conn->buf_len == sizeof(conn->buf)) {
+            return false;
+        }
+        ssize_t n = recv(conn->fd, conn->buf + conn->buf_len, sizeof(conn->buf) - conn->buf_len, 0);
+        if (n <= 0) {
+            return false;
+        }
+        conn->buf_len += n;
+    }
+
+    size_t head_len = end + 4 - conn->buf;
+    memcpy(conn->head, conn->buf, head_len);
+    conn->head[head_len - 2] = '\0';
+    conn->buf_len -= head_len;
+    memmove(conn->buf, conn->buf + head_len, conn->buf_len);
+
+    conn->hdr_count = 0;
+    char *line = strstr(conn->head, "\r\n");
+    while (line != NULL && conn->hdr_count < HOST_HTTPD_MAX_HEADERS) {
+        *line = '\0';
+        line += 2;
+        char *next = strstr(line, "\r\n");
+        char *colon = strchr(line, ':');
+        if (colon != NULL && (next == NULL || colon < next)) {
+            *colon = '\0';
+            char *value = colon + 1;
+            while (*value == ' ') {
+                value++;
+            }
+            conn->hdr_name[conn->hdr_count] = line;
+            conn->hdr_value[conn->hdr_count] = value;
+            conn->hdr_count++;
+        }
+        line = next;
+    }
+    for (int i = 0; i < conn->hdr_count; i++) {
+        char *cr = strstr(conn->hdr_value[i], "\r\n");
+        if (cr != NULL) {
+            *cr = '\0';
+        }
+    }
+    return true;
+}
+
+static const char *header(host_conn_t *conn, const char *field)
+{
+    for (int i = 0; i < conn->hdr_count; i++) {
+        if (strcasecmp(conn->hdr_name[i], field) == 0) {
+            return conn->hdr_value[i];
+        }
+    }
+    return NULL;
+}
+
+static bool send_head(host_conn_t *conn, const char *length_line)
+{
+    char head[1024];
+    int len = snprintf(head, sizeof(head), "HTTP/1.1 %s\r\nContent-Type: %s\r\n%s",
+                       conn->status, conn->type, length_line);
+    for (int i = 0; i < conn->resp_count; i++) {
+        len += snprintf(head + len, sizeof(head) - len, "%s: %s\r\n", conn->resp_name[i], conn->resp_value[i]);
+    }
+    len += snprintf(head + len, sizeof(head) - len, "\r\n");
+    conn->head_sent = true;
+    return send_all(conn, head, len);
+}
+
+static void serve_request(host_conn_t *conn)
+{
+    char method[8], target[513];
+    if (sscanf(conn->head, "%7s %512s", method, target) != 2) {
+        conn->failed = true;
+        return;
+    }
+    char *query = strchr(target, '?');
+    size_t path_len = query ? (size_t)(query - target) : strlen(target);
+
+    const char *length = header(conn, "Content-Length");
+    const char *connection = header(conn, "Connection");
+    conn->body_left = length ? strtoul(length, NULL, 10) : 0;
+    conn->keep_alive = connection == NULL || strcasecmp(connection, "close") != 0;
+    conn->status = "200 OK";
+    conn->type = "text/html";
+    conn->resp_count = 0;
+    conn->head_sent = conn->chunked = conn->finished = false;
+    conn->async = conn->async_done = false;
+
+    httpd_req_t req = {
+        .handle = conn->server,
+        .method = strcmp(method, "POST") == 0 ? HTTP_POST : HTTP_GET,
+        .content_len = conn->body_left,
+        .aux = conn,
+    };
+    strcpy((char *)req.uri, target);
+
+    const httpd_uri_t *match = NULL;
+    pthread_mutex_lock(&conn->server->lock);
+    for (int i = 0; i < conn->server->handler_count; i++) {
+        const httpd_uri_t *h = &conn->server->handlers[i];
+        if ((int)h->method == req.method && strlen(h->uri) == path_len &&
+            strncmp(h->uri, target, path_len) == 0) {
+            match = h;
+        }
+    }
+    pthread_mutex_unlock(&conn->server->lock);
+
+    if (match == NULL) {
+        httpd_resp_send_err(&req, HTTPD_404_NOT_FOUND, "Nothing here");
+        return;
+    }
+    req.user_ctx = match->user_ctx;
+    esp_err_t err = match->handler(&req);
+
+    if (conn->async) {
+        pthread_mutex_lock(&conn->lock);
+        while (!conn->async_done) {
+            pthread_cond_wait(&conn->cond, &conn->lock);
+        }
+        pthread_mutex_unlock(&conn->lock);
+    }
+    // Like the device: a handler error closes the socket
+    if (err != ESP_OK || (conn->chunked && !conn->finished)) {
+        conn->failed = true;
+    }
+}
+
+static void *conn_thread(void *arg)
+{
+    host_conn_t *conn = arg;
+    while (!conn->failed && read_head(conn)) {
+        serve_request(conn);
+
+        // Drop whatever of the body the handler left unread
+        char scratch[512];
+        while (!conn->failed && conn->body_left > 0) {
+            size_t n = conn->body_left < sizeof(scratch) ? conn->body_left : sizeof(scratch);
+            httpd_req_t req = { .handle = conn->server, .aux = conn };
+            if (httpd_req_recv(&req, scratch, n) <= 0) {
+                conn->failed = true;
+            }
+        }
+        if (!conn->keep_alive) {
+            break;
+        }
+    }
+    close(conn->fd);
+    pthread_mutex_destroy(&conn->lock);
+    pthread_cond_destroy(&conn->cond);
+    free(conn);
+    return NULL;
+}
+
+static void *accept_thread(void *arg)
+{
+    host_httpd_t *server = arg;
+    while (1) {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            return NULL;
+        }
+        int sndbuf = HOST_HTTPD_SNDBUF;
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+        struct timeval send_timeout = { .tv_sec = HOST_HTTPD_SEND_TIMEOUT_MS / 1000,
+                                        .tv_usec = HOST_HTTPD_SEND_TIMEOUT_MS % 1000 * 1000 };
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+
+        host_conn_t *conn = __real_calloc(1, sizeof(*conn));
+        conn->server = server;
+        conn->fd = fd;
+        pthread_mutex_init(&conn->lock, NULL);
+        pthread_cond_init(&conn->cond, NULL);
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, conn_thread, conn) != 0) {
+            close(fd);
+            free(conn);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+}
+
+esp_err_t host_httpd_start(httpd_handle_t *handle, uint16_t *port)
+{
+    host_httpd_t *server = __real_calloc(1, sizeof(*server));
+    server->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    pthread_mutex_init(&server->lock, NULL);
+
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t addr_len = sizeof(addr);
+    if (server->listen_fd < 0 ||
+        bind(server->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(server->listen_fd, 16) != 0 ||
+        getsockname(server->listen_fd, (struct sockaddr *)&addr, &addr_len) != 0) {
+        if (server->listen_fd >= 0) {
+            close(server->listen_fd);
+        }
+        free(server);
+        return ESP_FAIL;
+    }
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, accept_thread, server);
+    pthread_detach(thread);
+    *port = ntohs(addr.sin_port);
+    *handle = server;
+    return ESP_OK;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri_handler)
+{
+    host_httpd_t *server = handle;
+    esp_err_t err = ESP_OK;
+    pthread_mutex_lock(&server->lock);
+    if (server->handler_count == HOST_HTTPD_MAX_HANDLERS) {
+        err = ESP_ERR_HTTPD_HANDLERS_FULL;
+    } else {
+        server->handlers[server->handler_count++] = *uri_handler;
+    }
+    pthread_mutex_unlock(&server->lock);
+    return err;
+}
+
+void host_upload_init(httpd_req_t *req, host_upload_t *body)
+{
+    body->pos = 0;
+    req->handle = NULL;
+    req->content_len = body->len;
+    req->aux = body;
+}
+
+int httpd_req_recv(httpd_req_t *req, char *buf, size_t buf_len)
+{
+    host_conn_t *conn = conn_of(req);
+    if (conn == NULL) {
+        host_upload_t *body = req->aux;
+        size_t n = body->len - body->pos;
+        if (n > buf_len) {
+            n = buf_len;
+        }
+        if (body->chunk && n > body->chunk) {
+            n = body->chunk;
+        }
+        memcpy(buf, body->data + body->pos, n);
+        body->pos += n;
+        return (int)n;
+    }
+
+    if (buf_len > conn->body_left) {
+        buf_len = conn->body_left;
+    }
+    if (buf_len == 0) {
+        return 0;
+    }
+    size_t n;
+    if (conn->buf_len > 0) {
+        n = conn->buf_len < buf_len ? conn->buf_len : buf_len;
+        memcpy(buf, conn->buf, n);
+        conn->buf_len -= n;
+        memmove(conn->buf, conn->buf + n, conn->buf_len);
+    } else {
+        ssize_t got = recv(conn->fd, buf, buf_len, 0);
+        if (got <= 0) {
+            conn->failed = true;
+            return HTTPD_SOCK_ERR_FAIL;
+        }
+        n = got;
+    }
+    conn->body_left -= n;
+    return (int)n;
+}
+
+size_t httpd_req_get_hdr_value_len(httpd_req_t *req, const char *field)
+{
+    host_conn_t *conn = conn_of(req);
+    const char *value = conn ? header(conn, field) : NULL;
+    return value ? strlen(value) : 0;
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *req, const char *field, char *val, size_t val_size)
+{
+    host_conn_t *conn = conn_of(req);
+    const char *value = conn ? header(conn, field) : NULL;
+    if (value == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    snprintf(val, val_size, "%s", value);
+    return strlen(value) < val_size ? ESP_OK : ESP_ERR_HTTPD_RESULT_TRUNC;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t *req, const char *status)
+{
+    conn_of(req)->status = status;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *req, const char *type)
+{
+    conn_of(req)->type = type;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *req, const char *field, const char *value)
+{
+    host_conn_t *conn = conn_of(req);
+    if (conn->resp_count == HOST_HTTPD_MAX_RESP_HDR) {
+        return ESP_ERR_NO_MEM;
+    }
+    conn->resp_name[conn->resp_count] = field;
+    conn->resp_value[conn->resp_count] = value;
+    conn->resp_count++;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *req, const char *buf, ssize_t buf_len)
+{
+    host_conn_t *conn = conn_of(req);
+    size_t len = buf == NULL ? 0 : buf_len == HTTPD_RESP_USE_STRLEN ? strlen(buf) : (size_t)buf_len;
+    char length_line[48];
+    snprintf(length_line, sizeof(length_line), "Content-Length: %zu\r\n", len);
+    conn->finished = true;
+    if (!send_head(conn, length_line) || !send_all(conn, buf, len)) {
+        return ESP_ERR_HTTPD_RESP_SEND;
+    }
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t *req, const char *buf, ssize_t buf_len)
+{
+    host_conn_t *conn = conn_of(req);
+    size_t len = buf == NULL ? 0 : buf_len == HTTPD_RESP_USE_STRLEN ? strlen(buf) : (size_t)buf_len;
+    if (!conn->head_sent) {
+        conn->chunked = true;
+        send_head(conn, "Transfer-Encoding: chunked\r\n");
+    }
+    char size_line[16];
+    int n = snprintf(size_line, sizeof(size_line), "%zx\r\n", len);
+    send_all(conn, size_line, n);
+    send_all(conn, buf, len);
+    send_all(conn, "\r\n", 2);
+    if (len == 0) {
+        conn->finished = true;
+    }
+    return conn->failed ? ESP_ERR_HTTPD_RESP_SEND : ESP_OK;
+}
+
+esp_err_t httpd_resp_sendstr(httpd_req_t *req, const char *str)
+{
+    return httpd_resp_send(req, str, str ? HTTPD_RESP_USE_STRLEN : 0);
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t error, const char *msg)
+{
+    static const char *status[] = {
+        [HTTPD_400_BAD_REQUEST]           = "400 Bad Request",
+        [HTTPD_404_NOT_FOUND]             = "404 Not Found",
+        [HTTPD_408_REQ_TIMEOUT]           = "408 Request Timeout",
+        [HTTPD_500_INTERNAL_SERVER_ERROR] = "500 Internal Server Error",
+    };
+    host_conn_t *conn = conn_of(req);
+    conn->status = status[error];
+    conn->type = "text/html";
+    return httpd_resp_sendstr(req, msg);
+}
+
+int httpd_send(httpd_req_t *req, const char *buf, size_t buf_len)
+{
+    host_conn_t *conn = conn_of(req);
+    conn->head_sent = conn->finished = true;
+    ssize_t n = send(conn->fd, buf, buf_len, MSG_NOSIGNAL);
+    if (n < 0) {
+        conn->failed = true;
+        return errno == EAGAIN || errno == EWOULDBLOCK ? HTTPD_SOCK_ERR_TIMEOUT : HTTPD_SOCK_ERR_FAIL;
+    }
+    return (int)n;
+}
+
+esp_err_t httpd_req_async_handler_begin(httpd_req_t *req, httpd_req_t **out)
+{
+    host_conn_t *conn = conn_of(req);
+    httpd_req_t *copy = __real_malloc(sizeof(*copy));
+    if (copy == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(copy, req, sizeof(*copy));   // uri is const
+    conn->async = true;
+    *out = copy;
+    return ESP_OK;
+}
+
+esp_err_t httpd_req_async_handler_complete(httpd_req_t *req)
+{
+    host_conn_t *conn = conn_of(req);
+    free(req);
+    pthread_mutex_lock(&conn->lock);
+    conn->async_done = true;
+    pthread_cond_signal(&conn->cond);
+    pthread_mutex_unlock(&conn->lock);
+    return ESP_OK;
+}
@@ -0,0 +1,17 @@
+#ifndef ESP_APP_DESC_H
+#define ESP_APP_DESC_H
+
+#include <stddef.h>
+#include "esp_app_format.h"
+
+/**
+ * @brief Description of the "running" app; tests edit it through host_app_desc() (host_stubs.h)
+ */
+const esp_app_desc_t *esp_app_get_description(void);
+
+/**
+ * @brief Hex of app_elf_sha256, truncated to size - 1 digits
+ */
+int esp_app_get_elf_sha256(char *dst, size_t size);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef ESP_IMAGE_FORMAT_H
+#define ESP_IMAGE_FORMAT_H
+
+// esp_image_get_metadata() on host partitions: walks the segment headers the
+// way the bootloader does to find the image length, nothing is verified
+
+#include <stdint.h>
+#include "esp_app_format.h"
+#include "esp_err.h"
+
+#define ESP_ERR_IMAGE_BASE      0x2000
+#define ESP_ERR_IMAGE_INVALID   (ESP_ERR_IMAGE_BASE + 2)
+
+#define ESP_IMAGE_MAX_SEGMENTS  16
+
+typedef struct {
+    uint32_t offset;
+    uint32_t size;
+} esp_partition_pos_t;
+
+typedef struct {
+    uint32_t start_addr;
+    esp_image_header_t image;
+    esp_image_segment_header_t segments[ESP_IMAGE_MAX_SEGMENTS];
+    uint32_t image_len;         // Segments, checksum padding and appended hash
+} esp_image_metadata_t;
+
+esp_err_t esp_image_get_metadata(const esp_partition_pos_t *part, esp_image_metadata_t *metadata);
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef ESP_NETIF_SNTP_H
+#define ESP_NETIF_SNTP_H
+
+#include "esp_err.h"
+
+typedef struct {
+    const char *servers[1];
+} esp_sntp_config_t;
+
+#define ESP_NETIF_SNTP_DEFAULT_CONFIG(server) { .servers = { server } }
+
+// Nothing to sync against; the wall clock is the host's
+esp_err_t esp_netif_sntp_init(const esp_sntp_config_t *config);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef ESP_OTA_OPS_H
+#define ESP_OTA_OPS_H
+
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "esp_app_desc.h"
+
+typedef enum {
+    ESP_OTA_IMG_NEW = 0x0,
+    ESP_OTA_IMG_PENDING_VERIFY = 0x1,
+    ESP_OTA_IMG_VALID = 0x2,
+    ESP_OTA_IMG_INVALID = 0x3,
+    ESP_OTA_IMG_ABORTED = 0x4,
+    ESP_OTA_IMG_UNDEFINED = 0xFFFFFFFF,
+} esp_ota_img_states_t;
+
+// Partitions come from host_partition_create() (host_stubs.h); the running one
+// is valid unless host_ota_set_running_state() says otherwise
+const esp_partition_t *esp_ota_get_running_partition(void);
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from);
+esp_err_t esp_ota_get_state_partition(const esp_partition_t *partition, esp_ota_img_states_t *ota_state);
+esp_err_t esp_ota_mark_app_valid_cancel_rollback(void);
+// Does not return: marks the image invalid and ends the calling task
+esp_err_t esp_ota_mark_app_invalid_rollback_and_reboot(void);
+// Set with host_ota_set_last_invalid(), NULL by default
+const esp_partition_t *esp_ota_get_last_invalid_partition(void);
+// Reads the app description of an image written by host_image_app()
+esp_err_t esp_ota_get_partition_description(const esp_partition_t *partition, esp_app_desc_t *app_desc);
+
+#endif
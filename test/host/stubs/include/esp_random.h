@@ -0,0 +1,11 @@
+#ifndef ESP_RANDOM_H
+#define ESP_RANDOM_H
+
+#include <stdint.h>
+
+/**
+ * @brief Pseudo-random, same sequence every run
+ */
+uint32_t esp_random(void);
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef ESP_TIMER_H
+#define ESP_TIMER_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * @brief Microseconds since the process started (CLOCK_MONOTONIC)
+ */
+int64_t esp_timer_get_time(void);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+// Host FreeRTOS on pthreads: tasks are threads, ticks are milliseconds,
+// critical sections are one process-wide recursive mutex
+
+#include <pthread.h>
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE   1
+#define pdFALSE  0
+#define pdPASS   pdTRUE
+#define pdFAIL   pdFALSE
+
+#define configTICK_RATE_HZ   1000
+#define portTICK_PERIOD_MS   (1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY        ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms)    ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+
+typedef pthread_mutex_t portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED  PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP
+
+#define taskENTER_CRITICAL(mux)  pthread_mutex_lock(mux)
+#define taskEXIT_CRITICAL(mux)   pthread_mutex_unlock(mux)
+
+#endif
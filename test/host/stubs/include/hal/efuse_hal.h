@@ -0,0 +1,11 @@
+#ifndef EFUSE_HAL_H
+#define EFUSE_HAL_H
+
+#include <stdint.h>
+
+/**
+ * @brief Chip revision as major * 100 + minor, set with host_set_chip_revision() (host_stubs.h)
+ */
+uint32_t efuse_hal_chip_revision(void);
+
+#endif
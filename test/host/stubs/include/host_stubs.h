@@ -0,0 +1,127 @@
+#ifndef HOST_STUBS_H
+#define HOST_STUBS_H
+
+// Test-side controls of the host ESP-IDF stand-ins
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_app_format.h"
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+
+/**
+ * Flash behaviour and counters across all host partitions. Programming
+ * follows NOR rules: a write may only clear bits, so a missing erase is
+ * reported (ESP_FAIL) instead of silently producing garbage.
+ */
+typedef struct {
+    uint32_t erase_ops;
+    uint32_t erased_bytes;
+    uint32_t write_ops;
+    uint32_t written_bytes;
+    uint32_t read_ops;
+    uint32_t read_bytes;
+    uint32_t unerased_writes;       // Writes refused because the target was not erased
+} host_flash_stats_t;
+
+/**
+ * @brief New app partition backed by an anonymous temporary file, all 0xFF
+ * @param path File to back it with, NULL for a temporary one
+ */
+esp_partition_t *host_partition_create(const char *label, uint32_t address, size_t size, const char *path);
+
+/**
+ * @brief Release the partition and its file
+ */
+void host_partition_delete(esp_partition_t *partition);
+
+/**
+ * @brief What esp_ota_get_running_partition() and _get_next_update_partition() return
+ */
+void host_partition_set_slots(const esp_partition_t *running, const esp_partition_t *next);
+
+/**
+ * @brief State reported for the running partition (default ESP_OTA_IMG_VALID)
+ * esp_ota_mark_app_valid_cancel_rollback() sets it to VALID,
+ * esp_ota_mark_app_invalid_rollback_and_reboot() to INVALID.
+ */
+void host_ota_set_running_state(esp_ota_img_states_t state);
+esp_ota_img_states_t host_ota_get_running_state(void);
+
+/**
+ * @brief Calls to esp_ota_mark_app_invalid_rollback_and_reboot() so far
+ */
+uint32_t host_ota_rollbacks(void);
+
+/**
+ * @brief What esp_ota_get_last_invalid_partition() returns, as after a rollback
+ */
+void host_ota_set_last_invalid(const esp_partition_t *partition);
+
+/**
+ * @brief Emulated flash timing, slept inside erase and program calls; 0 disables
+ */
+void host_flash_set_timing(uint32_t erase_us_per_sector, uint32_t program_us_per_kb);
+
+void host_flash_get_stats(host_flash_stats_t *stats);
+void host_flash_reset_stats(void);
+
+/**
+ * @brief Description returned by esp_app_get_description(), writable
+ */
+esp_app_desc_t *host_app_desc(void);
+
+void host_set_chip_revision(uint32_t revision);
+
+/**
+ * @brief Minimum level printed by ESP_LOGx (also set from OTA_HOST_LOG=E|W|I|D)
+ */
+void host_log_set_level(esp_log_level_t level);
+
+/**
+ * Request body for httpd_req_recv(): served in reads of at most chunk bytes
+ */
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+    size_t pos;
+    size_t chunk;               // 0 = whatever the caller asks for
+} host_upload_t;
+
+/**
+ * @brief Point req at body (sets content_len and aux)
+ */
+void host_upload_init(httpd_req_t *req, host_upload_t *body);
+
+/**
+ * @brief Start an HTTP server on 127.0.0.1 at a free port (stubs/httpd.c)
+ * Handlers registered on *handle are served until the process exits.
+ */
+esp_err_t host_httpd_start(httpd_handle_t *handle, uint16_t *port);
+
+/**
+ * Counters of the general heap as seen by the code under test. Built with
+ * -Wl,--wrap=malloc,--wrap=calloc, so only allocations made by main/ are
+ * counted: not those inside libc, nor those of the stubs that stand in for
+ * FreeRTOS and ESP-IDF internals (tasks, semaphores, HTTP client and server),
+ * which call __real_malloc()/__real_calloc() directly.
+ */
+typedef struct {
+    uint32_t allocs;            // malloc/calloc/heap_caps_malloc calls
+    size_t bytes;               // Bytes requested by them
+} host_heap_stats_t;
+
+void host_heap_get_stats(host_heap_stats_t *stats);
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+
+/**
+ * @brief What heap_caps_get_free_size() reports
+ */
+void host_heap_set_free(size_t bytes);
+
+#endif
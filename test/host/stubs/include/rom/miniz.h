@@ -0,0 +1,39 @@
+#ifndef ROM_MINIZ_H
+#define ROM_MINIZ_H
+
+// The slice of the ROM tinfl API that ota_inflate.c uses, on top of zlib.
+// Raw deflate only. As with tinfl in wrapping mode, the history is the size
+// of the caller's output buffer; zlib allocates from the embedded pool, so
+// the decompressor needs no heap, like the ROM one.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zlib.h>
+
+#define TINFL_FLAG_PARSE_ZLIB_HEADER              1
+#define TINFL_FLAG_HAS_MORE_INPUT                 2
+#define TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF  4
+
+typedef enum {
+    TINFL_STATUS_BAD_PARAM = -3,
+    TINFL_STATUS_ADLER32_MISMATCH = -2,
+    TINFL_STATUS_FAILED = -1,
+    TINFL_STATUS_DONE = 0,
+    TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+    TINFL_STATUS_HAS_MORE_OUTPUT = 2,
+} tinfl_status;
+
+typedef struct {
+    z_stream z;
+    int started;
+    size_t pool_used;
+    unsigned char pool[16 * 1024];  // inflate state plus a window of up to 8KB
+} tinfl_decompressor;
+
+#define tinfl_init(r) do { (r)->started = 0; (r)->pool_used = 0; } while (0)
+
+tinfl_status tinfl_decompress(tinfl_decompressor *r, const uint8_t *in_next, size_t *in_size,
+                              uint8_t *out_start, uint8_t *out_next, size_t *out_size,
+                              const uint32_t flags);
+
+#endif
@@ -0,0 +1,60 @@
+// tinfl_decompress() on zlib's raw inflate, see rom/miniz.h
+
+#include "rom/miniz.h"
+#include <string.h>
+
+static voidpf tinfl_pool_alloc(voidpf opaque, uInt items, uInt size)
+{
+    tinfl_decompressor *r = opaque;
+    size_t len = ((size_t)items * size + 15) & ~(size_t)15;
+    if (len > sizeof(r->pool) - r->pool_used) {
+        return Z_NULL;
+    }
+    void *p = r->pool + r->pool_used;
+    r->pool_used += len;
+    return p;
+}
+
+static void tinfl_pool_free(voidpf opaque, voidpf address)
+{
+    // Released with the decompressor
+}
+
+tinfl_status tinfl_decompress(tinfl_decompressor *r, const uint8_t *in_next, size_t *in_size,
+                              uint8_t *out_start, uint8_t *out_next, size_t *out_size,
+                              const uint32_t flags)
+{
+    if (!r->started) {
+        // History as large as the wrapping output buffer, as tinfl would keep
+        size_t window = (size_t)(out_next - out_start) + *out_size;
+        int bits = 8;
+        while (bits < 15 && ((size_t)1 << bits) < window) {
+            bits++;
+        }
+        memset(&r->z, 0, sizeof(r->z));
+        r->z.zalloc = tinfl_pool_alloc;
+        r->z.zfree = tinfl_pool_free;
+        r->z.opaque = r;
+        if ((flags & TINFL_FLAG_PARSE_ZLIB_HEADER) ||
+            inflateInit2(&r->z, -bits) != Z_OK) {
+            return TINFL_STATUS_BAD_PARAM;
+        }
+        r->started = 1;
+    }
+
+    r->z.next_in = (Bytef *)in_next;
+    r->z.avail_in = (uInt)*in_size;
+    r->z.next_out = out_next;
+    r->z.avail_out = (uInt)*out_size;
+    int ret = inflate(&r->z, Z_NO_FLUSH);
+    *in_size -= r->z.avail_in;
+    *out_size -= r->z.avail_out;
+
+    if (ret == Z_STREAM_END) {
+        return TINFL_STATUS_DONE;
+    }
+    if (ret != Z_OK && ret != Z_BUF_ERROR) {
+        return TINFL_STATUS_FAILED;
+    }
+    return r->z.avail_out == 0 ? TINFL_STATUS_HAS_MORE_OUTPUT : TINFL_STATUS_NEEDS_MORE_INPUT;
+}
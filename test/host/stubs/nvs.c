@@ -0,0 +1,146 @@
+// In-memory NVS: namespaces and blob keys only
+
+#include "nvs.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HOST_NVS_MAX_ENTRIES  32
+#define HOST_NVS_MAX_HANDLES  8
+
+typedef struct {
+    bool used;
+    char ns[16];
+    char key[16];
+    void *value;
+    size_t len;
+} host_nvs_entry_t;
+
+static pthread_mutex_t nvs_lock = PTHREAD_MUTEX_INITIALIZER;
+static host_nvs_entry_t entries[HOST_NVS_MAX_ENTRIES];
+static char handles[HOST_NVS_MAX_HANDLES][16];     // Namespace per open handle, 1-based
+
+static host_nvs_entry_t *host_nvs_find(nvs_handle_t handle, const char *key)
+{
+    for (int i = 0; i < HOST_NVS_MAX_ENTRIES; i++) {
+        if (entries[i].used && strcmp(entries[i].ns, handles[handle - 1]) == 0 &&
+            strcmp(entries[i].key, key) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    esp_err_t err = ESP_ERR_NO_MEM;
+
+    pthread_mutex_lock(&nvs_lock);
+    if (open_mode == NVS_READONLY) {
+        // Like the real NVS, a namespace that was never written does not exist
+        bool exists = false;
+        for (int i = 0; i < HOST_NVS_MAX_ENTRIES && !exists; i++) {
+            exists = entries[i].used && strcmp(entries[i].ns, name) == 0;
+        }
+        if (!exists) {
+            pthread_mutex_unlock(&nvs_lock);
+            return ESP_ERR_NVS_NOT_FOUND;
+        }
+    }
+    for (int i = 0; i < HOST_NVS_MAX_HANDLES; i++) {
+        if (handles[i][0] == '\0') {
+            strncpy(handles[i], name, sizeof(handles[i]) - 1);
+            *out_handle = i + 1;
+            err = ESP_OK;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return err;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    esp_err_t err = ESP_ERR_NVS_NOT_FOUND;
+
+    pthread_mutex_lock(&nvs_lock);
+    host_nvs_entry_t *entry = host_nvs_find(handle, key);
+    if (entry) {
+        if (out_value && *length < entry->len) {
+            err = ESP_ERR_INVALID_SIZE;
+        } else {
+            if (out_value) {
+                memcpy(out_value, entry->value, entry->len);
+            }
+            *length = entry->len;
+            err = ESP_OK;
+        }
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return err;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    esp_err_t err = ESP_OK;
+
+    pthread_mutex_lock(&nvs_lock);
+    host_nvs_entry_t *entry = host_nvs_find(handle, key);
+    for (int i = 0; i < HOST_NVS_MAX_ENTRIES && entry == NULL; i++) {
+        if (!entries[i].used) {
+            entry = &entries[i];
+            entry->used = true;
+            strncpy(entry->ns, handles[handle - 1], sizeof(entry->ns) - 1);
+            strncpy(entry->key, key, sizeof(entry->key) - 1);
+            entry->value = NULL;
+        }
+    }
+    if (entry == NULL) {
+        err = ESP_ERR_NO_MEM;
+    } else {
+        // realloc() is not counted by the heap wrapper, like NVS's own pages
+        entry->value = realloc(entry->value, length);
+        memcpy(entry->value, value, length);
+        entry->len = length;
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return err;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    esp_err_t err = ESP_ERR_NVS_NOT_FOUND;
+
+    pthread_mutex_lock(&nvs_lock);
+    host_nvs_entry_t *entry = host_nvs_find(handle, key);
+    if (entry) {
+        free(entry->value);
+        memset(entry, 0, sizeof(*entry));
+        err = ESP_OK;
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return err;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    pthread_mutex_lock(&nvs_lock);
+    handles[handle - 1][0] = '\0';
+    pthread_mutex_unlock(&nvs_lock);
+}
+
+void host_nvs_erase_all(void)
+{
+    pthread_mutex_lock(&nvs_lock);
+    for (int i = 0; i < HOST_NVS_MAX_ENTRIES; i++) {
+        free(entries[i].value);
+    }
+    memset(entries, 0, sizeof(entries));
+    pthread_mutex_unlock(&nvs_lock);
+}
@@ -0,0 +1,291 @@
+// File-backed flash partitions, the esp_ota_ops calls the engine and the
+// health check need, and image metadata for the peer server
+
+#include "esp_image_format.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "host_stubs.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct {
+    esp_partition_t part;       // First, so the public pointer maps back
+    FILE *file;
+} host_partition_t;
+
+static pthread_mutex_t flash_lock = PTHREAD_MUTEX_INITIALIZER;
+static host_flash_stats_t flash_stats;
+static uint32_t erase_us_per_sector;
+static uint32_t program_us_per_kb;
+static const esp_partition_t *running_slot;
+static const esp_partition_t *next_slot;
+static esp_ota_img_states_t running_state = ESP_OTA_IMG_VALID;
+static const esp_partition_t *last_invalid;
+static uint32_t rollbacks;
+
+esp_partition_t *host_partition_create(const char *label, uint32_t address, size_t size, const char *path)
+{
+    host_partition_t *hp = calloc(1, sizeof(*hp));
+    if (hp == NULL) {
+        return NULL;
+    }
+    hp->file = path ? fopen(path, "w+b") : tmpfile();
+    if (hp->file == NULL) {
+        free(hp);
+        return NULL;
+    }
+
+    uint8_t erased[SPI_FLASH_SEC_SIZE];
+    memset(erased, 0xFF, sizeof(erased));
+    for (size_t offset = 0; offset < size; offset += sizeof(erased)) {
+        fwrite(erased, 1, sizeof(erased), hp->file);
+    }
+    fflush(hp->file);
+
+    hp->part.type = ESP_PARTITION_TYPE_APP;
+    hp->part.subtype = ESP_PARTITION_SUBTYPE_APP_OTA_0;
+    hp->part.address = address;
+    hp->part.size = size;
+    hp->part.erase_size = SPI_FLASH_SEC_SIZE;
+    strncpy(hp->part.label, label, sizeof(hp->part.label) - 1);
+    return &hp->part;
+}
+
+void host_partition_delete(esp_partition_t *partition)
+{
+    host_partition_t *hp = (host_partition_t *)partition;
+    if (hp) {
+        fclose(hp->file);
+        free(hp);
+    }
+}
+
+void host_partition_set_slots(const esp_partition_t *running, const esp_partition_t *next)
+{
+    running_slot = running;
+    next_slot = next;
+}
+
+void host_flash_set_timing(uint32_t erase_us, uint32_t program_us)
+{
+    erase_us_per_sector = erase_us;
+    program_us_per_kb = program_us;
+}
+
+void host_flash_get_stats(host_flash_stats_t *stats)
+{
+    pthread_mutex_lock(&flash_lock);
+    *stats = flash_stats;
+    pthread_mutex_unlock(&flash_lock);
+}
+
+void host_flash_reset_stats(void)
+{
+    pthread_mutex_lock(&flash_lock);
+    memset(&flash_stats, 0, sizeof(flash_stats));
+    pthread_mutex_unlock(&flash_lock);
+}
+
+static bool host_range_ok(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    return partition != NULL && offset <= partition->size && size <= partition->size - offset;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    if (!host_range_ok(partition, src_offset, size)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    host_partition_t *hp = (host_partition_t *)partition;
+    if (pread(fileno(hp->file), dst, size, src_offset) != (ssize_t)size) {
+        return ESP_FAIL;
+    }
+
+    pthread_mutex_lock(&flash_lock);
+    flash_stats.read_ops++;
+    flash_stats.read_bytes += size;
+    pthread_mutex_unlock(&flash_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    if (!host_range_ok(partition, dst_offset, size)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    host_partition_t *hp = (host_partition_t *)partition;
+    const uint8_t *data = src;
+    uint8_t current[256];
+
+    // NOR flash can only clear bits; anything else means a missing erase
+    for (size_t pos = 0; pos < size; pos += sizeof(current)) {
+        size_t n = size - pos < sizeof(current) ? size - pos : sizeof(current);
+        if (pread(fileno(hp->file), current, n, dst_offset + pos) != (ssize_t)n) {
+            return ESP_FAIL;
+        }
+        for (size_t i = 0; i < n; i++) {
+            if ((current[i] & data[pos + i]) != data[pos + i]) {
+                fprintf(stderr, "flash: write to unerased byte at %s+0x%zx\n",
+                        partition->label, dst_offset + pos + i);
+                pthread_mutex_lock(&flash_lock);
+                flash_stats.unerased_writes++;
+                pthread_mutex_unlock(&flash_lock);
+                return ESP_FAIL;
+            }
+        }
+    }
+    if (pwrite(fileno(hp->file), src, size, dst_offset) != (ssize_t)size) {
+        return ESP_FAIL;
+    }
+
+    if (program_us_per_kb) {
+        usleep((useconds_t)((uint64_t)size * program_us_per_kb / 1024));
+    }
+    pthread_mutex_lock(&flash_lock);
+    flash_stats.write_ops++;
+    flash_stats.written_bytes += size;
+    pthread_mutex_unlock(&flash_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    if (!host_range_ok(partition, offset, size) ||
+        offset % SPI_FLASH_SEC_SIZE != 0 || size % SPI_FLASH_SEC_SIZE != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    host_partition_t *hp = (host_partition_t *)partition;
+    uint8_t erased[SPI_FLASH_SEC_SIZE];
+    memset(erased, 0xFF, sizeof(erased));
+    for (size_t pos = 0; pos < size; pos += sizeof(erased)) {
+        if (pwrite(fileno(hp->file), erased, sizeof(erased), offset + pos) != (ssize_t)sizeof(erased)) {
+            return ESP_FAIL;
+        }
+    }
+
+    if (erase_us_per_sector) {
+        usleep((useconds_t)((uint64_t)size / SPI_FLASH_SEC_SIZE * erase_us_per_sector));
+    }
+    pthread_mutex_lock(&flash_lock);
+    flash_stats.erase_ops++;
+    flash_stats.erased_bytes += size;
+    pthread_mutex_unlock(&flash_lock);
+    return ESP_OK;
+}
+
+const esp_partition_t *esp_ota_get_running_partition(void)
+{
+    return running_slot;
+}
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from)
+{
+    return next_slot;
+}
+
+esp_err_t esp_ota_get_state_partition(const esp_partition_t *partition, esp_ota_img_states_t *ota_state)
+{
+    *ota_state = partition == running_slot ? __atomic_load_n(&running_state, __ATOMIC_SEQ_CST)
+                                           : ESP_OTA_IMG_VALID;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_mark_app_valid_cancel_rollback(void)
+{
+    __atomic_store_n(&running_state, ESP_OTA_IMG_VALID, __ATOMIC_SEQ_CST);
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_mark_app_invalid_rollback_and_reboot(void)
+{
+    __atomic_store_n(&running_state, ESP_OTA_IMG_INVALID, __ATOMIC_SEQ_CST);
+    __atomic_fetch_add(&rollbacks, 1, __ATOMIC_SEQ_CST);
+    // The device reboots here; end the calling task the same way
+    pthread_exit(NULL);
+}
+
+void host_ota_set_running_state(esp_ota_img_states_t state)
+{
+    __atomic_store_n(&running_state, state, __ATOMIC_SEQ_CST);
+}
+
+esp_ota_img_states_t host_ota_get_running_state(void)
+{
+    return __atomic_load_n(&running_state, __ATOMIC_SEQ_CST);
+}
+
+uint32_t host_ota_rollbacks(void)
+{
+    return __atomic_load_n(&rollbacks, __ATOMIC_SEQ_CST);
+}
+
+const esp_partition_t *esp_ota_get_last_invalid_partition(void)
+{
+    return __atomic_load_n(&last_invalid, __ATOMIC_SEQ_CST);
+}
+
+void host_ota_set_last_invalid(const esp_partition_t *partition)
+{
+    __atomic_store_n(&last_invalid, partition, __ATOMIC_SEQ_CST);
+}
+
+esp_err_t esp_ota_get_partition_description(const esp_partition_t *partition, esp_app_desc_t *app_desc)
+{
+    // Where the build puts it: after the image header and the first segment header
+    esp_err_t err = esp_partition_read(partition, sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t),
+                                       app_desc, sizeof(*app_desc));
+    if (err != ESP_OK) {
+        return err;
+    }
+    return app_desc->magic_word == ESP_APP_DESC_MAGIC_WORD ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t esp_image_get_metadata(const esp_partition_pos_t *part, esp_image_metadata_t *metadata)
+{
+    const esp_partition_t *partition = NULL;
+    if (running_slot != NULL && running_slot->address == part->offset) {
+        partition = running_slot;
+    } else if (next_slot != NULL && next_slot->address == part->offset) {
+        partition = next_slot;
+    }
+    if (partition == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(metadata, 0, sizeof(*metadata));
+    metadata->start_addr = part->offset;
+    esp_err_t err = esp_partition_read(partition, 0, &metadata->image, sizeof(metadata->image));
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (metadata->image.magic != ESP_IMAGE_HEADER_MAGIC ||
+        metadata->image.segment_count > ESP_IMAGE_MAX_SEGMENTS) {
+        return ESP_ERR_IMAGE_INVALID;
+    }
+
+    uint32_t offset = sizeof(esp_image_header_t);
+    for (int i = 0; i < metadata->image.segment_count; i++) {
+        esp_image_segment_header_t *segment = &metadata->segments[i];
+        err = esp_partition_read(partition, offset, segment, sizeof(*segment));
+        if (err != ESP_OK) {
+            return err;
+        }
+        offset += sizeof(*segment) + segment->data_len;
+        if (offset > part->size) {
+            return ESP_ERR_IMAGE_INVALID;
+        }
+    }
+    // Checksum byte, padded to 16 bytes, then the optional SHA-256
+    offset = (offset + 1 + 15) & ~15u;
+    if (metadata->image.hash_appended) {
+        offset += 32;
+    }
+    if (offset > part->size) {
+        return ESP_ERR_IMAGE_INVALID;
+    }
+    metadata->image_len = offset;
+    return ESP_OK;
+}
@@ -0,0 +1,18 @@
+// Device-only neighbours of the engine and the health check: the LED and
+// the boot trace (RTC memory)
+
+#include "boot_trace.h"
+#include "led_indicator.h"
+#include <stddef.h>
+
+void led_set_mode(led_mode_t mode)
+{
+}
+
+void led_set_progress(int percent)
+{
+}
+
+void boot_trace_mark(boot_trace_stage_t stage, uint16_t arg)
+{
+}
@@ -0,0 +1,169 @@
+#include "host_image.h"
+#include "esp_app_format.h"
+#include "host_stubs.h"
+#include "mbedtls/sha256.h"
+#include "ota_delta.h"
+#include "ota_header.h"
+#include "ota_inflate.h"
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+static uint32_t xorshift(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+uint8_t *host_image_app(size_t size, const char *version, uint32_t seed)
+{
+    uint8_t *image = malloc(size);
+    uint32_t state = seed * 2654435761u + 1;
+
+    // Code-like body: runs of repeated words between random bytes
+    for (size_t i = 0; i < size; ) {
+        uint32_t r = xorshift(&state);
+        size_t run = 4 + r % 28;
+        for (size_t j = 0; j < run && i < size; j++, i++) {
+            image[i] = (r & 0x80) ? (uint8_t)(r >> (8 * (j % 4))) : (uint8_t)xorshift(&state);
+        }
+    }
+
+    esp_image_header_t header = {
+        .magic = ESP_IMAGE_HEADER_MAGIC,
+        .segment_count = 1,
+        .chip_id = ESP_CHIP_ID_ESP32,
+        .min_chip_rev_full = 0,
+        .max_chip_rev_full = 399,
+    };
+    esp_image_segment_header_t segment = { .load_addr = 0x3f400020, .data_len = (uint32_t)size };
+    esp_app_desc_t desc = *host_app_desc();
+    memset(desc.version, 0, sizeof(desc.version));
+    strncpy(desc.version, version, sizeof(desc.version) - 1);
+
+    memcpy(image, &header, sizeof(header));
+    memcpy(image + sizeof(header), &segment, sizeof(segment));
+    memcpy(image + sizeof(header) + sizeof(segment), &desc, sizeof(desc));
+    return image;
+}
+
+static void append(uint8_t **buf, size_t *len, const void *data, size_t n)
+{
+    *buf = realloc(*buf, *len + n);
+    memcpy(*buf + *len, data, n);
+    *len += n;
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+// Sector-granular patch: COPY where the base holds the same 4KB, ADD elsewhere
+static uint8_t *make_patch(const uint8_t *base, size_t base_len, const uint8_t *image, size_t len,
+                           size_t *out_len)
+{
+    uint8_t *patch = NULL;
+    *out_len = 0;
+    for (size_t pos = 0; pos < len; pos += 4096) {
+        size_t n = len - pos < 4096 ? len - pos : 4096;
+        uint8_t op[9];
+        if (pos + n <= base_len && memcmp(base + pos, image + pos, n) == 0) {
+            op[0] = OTA_DELTA_OP_COPY;
+            put_le32(op + 1, pos);
+            put_le32(op + 5, n);
+            append(&patch, out_len, op, 9);
+        } else {
+            op[0] = OTA_DELTA_OP_ADD;
+            put_le32(op + 1, n);
+            append(&patch, out_len, op, 5);
+            append(&patch, out_len, image + pos, n);
+        }
+    }
+    return patch;
+}
+
+static uint8_t *deflate_raw(const uint8_t *data, size_t len, size_t *out_len)
+{
+    z_stream z = {0};
+    deflateInit2(&z, 9, Z_DEFLATED, -OTA_INFLATE_WINDOW_BITS, 9, Z_DEFAULT_STRATEGY);
+    size_t cap = deflateBound(&z, len);
+    uint8_t *out = malloc(cap);
+    z.next_in = (Bytef *)data;
+    z.avail_in = len;
+    z.next_out = out;
+    z.avail_out = cap;
+    deflate(&z, Z_FINISH);
+    *out_len = cap - z.avail_out;
+    deflateEnd(&z);
+    return out;
+}
+
+uint8_t *host_container_build(const uint8_t *image, size_t len, const host_container_t *opts,
+                              size_t *out_len)
+{
+    uint8_t *payload;
+    size_t payload_len;
+    uint32_t flags = 0;
+
+    if (opts->base) {
+        flags |= OTA_HEADER_FLAG_DELTA;
+        payload = make_patch(opts->base, opts->base_len, image, len, &payload_len);
+    } else {
+        payload = malloc(len);
+        memcpy(payload, image, len);
+        payload_len = len;
+    }
+    if (opts->compress) {
+        flags |= OTA_HEADER_FLAG_DEFLATE;
+        size_t packed_len;
+        uint8_t *packed = deflate_raw(payload, payload_len, &packed_len);
+        free(payload);
+        payload = packed;
+        payload_len = packed_len;
+    }
+    if (opts->block_size) {
+        flags |= OTA_HEADER_FLAG_BLOCKS;
+    }
+
+    ota_header_t header = {
+        .magic = OTA_HEADER_MAGIC,
+        .version = flags << 24 | opts->version,
+        .size = (uint32_t)len,
+    };
+    mbedtls_sha256(image, len, header.sha256, 0);
+
+    uint8_t *out = NULL;
+    *out_len = 0;
+    append(&out, out_len, &header, sizeof(header));
+    if (opts->base) {
+        ota_delta_ext_t ext = { .base_size = (uint32_t)opts->base_len };
+        mbedtls_sha256(opts->base, opts->base_len, ext.base_sha256, 0);
+        append(&out, out_len, &ext, sizeof(ext));
+    }
+    if (opts->block_size) {
+        ota_blocks_ext_t ext = {
+            .block_size = opts->block_size,
+            .block_count = (uint32_t)((payload_len + opts->block_size - 1) / opts->block_size),
+        };
+        uint8_t *table = malloc(ext.block_count * OTA_BLOCK_DIGEST_SIZE);
+        for (uint32_t i = 0; i < ext.block_count; i++) {
+            size_t start = (size_t)i * opts->block_size;
+            size_t n = payload_len - start < opts->block_size ? payload_len - start : opts->block_size;
+            mbedtls_sha256(payload + start, n, table + i * OTA_BLOCK_DIGEST_SIZE, 0);
+        }
+        mbedtls_sha256(table, ext.block_count * OTA_BLOCK_DIGEST_SIZE, ext.table_sha256, 0);
+        append(&out, out_len, &ext, sizeof(ext));
+        append(&out, out_len, table, ext.block_count * OTA_BLOCK_DIGEST_SIZE);
+        free(table);
+    }
+    append(&out, out_len, payload, payload_len);
+    free(payload);
+    return out;
+}
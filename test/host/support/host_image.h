@@ -0,0 +1,32 @@
+#ifndef HOST_IMAGE_H
+#define HOST_IMAGE_H
+
+// Test images and containers in the formats of tools/prepare-firmware.py
+// and tools/make-delta.py
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief App image of size bytes: valid image header and app description
+ * for host_app_desc(), then a body that deflates to roughly half (malloc'd)
+ * @param seed Different seeds give different bodies
+ */
+uint8_t *host_image_app(size_t size, const char *version, uint32_t seed);
+
+typedef struct {
+    uint32_t version;           // major << 16 | minor << 8 | patch
+    bool compress;              // FLAG_DEFLATE, OTA_INFLATE_WINDOW_BITS window
+    const uint8_t *base;        // FLAG_DELTA against these bytes, NULL for a full image
+    size_t base_len;
+    uint32_t block_size;        // FLAG_BLOCKS with this block size, 0 = none
+} host_container_t;
+
+/**
+ * @brief Header + extensions + payload for image (malloc'd)
+ */
+uint8_t *host_container_build(const uint8_t *image, size_t len, const host_container_t *opts,
+                              size_t *out_len);
+
+#endif
@@ -0,0 +1,3 @@
+#include "host_test.h"
+
+int host_test_failures;
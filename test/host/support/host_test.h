@@ -0,0 +1,36 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+// Minimal assertions for the host tests: report and keep going, fail at exit
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_err.h"
+
+extern int host_test_failures;
+
+#define CHECK(cond) do {                                                        \
+        if (!(cond)) {                                                          \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            host_test_failures++;                                               \
+        }                                                                       \
+    } while (0)
+
+#define CHECK_ERR(expected, actual) do {                                        \
+        esp_err_t want_ = (expected), got_ = (actual);                          \
+        if (want_ != got_) {                                                    \
+            fprintf(stderr, "%s:%d: %s returned %s, expected %s\n", __FILE__, __LINE__, \
+                    #actual, esp_err_to_name(got_), esp_err_to_name(want_));    \
+            host_test_failures++;                                               \
+        }                                                                       \
+    } while (0)
+
+#define RUN_TEST(fn) do {                                                       \
+        int before_ = host_test_failures;                                       \
+        fn();                                                                   \
+        printf("%s %s\n", host_test_failures == before_ ? "PASS" : "FAIL", #fn); \
+    } while (0)
+
+#define TEST_EXIT() (host_test_failures == 0 ? 0 : 1)
+
+#endif
@@ -0,0 +1,97 @@
+#include "host_transport.h"
+#include <string.h>
+#include <unistd.h>
+
+void host_source_init(host_source_t *source, const uint8_t *data, size_t len)
+{
+    *source = (host_source_t){
+        .data = data,
+        .len = len,
+        .seekable = true,
+        .drop_at = -1,
+    };
+    for (int i = 0; i < HOST_CORRUPT_MAX; i++) {
+        source->corrupt_at[i] = -1;
+    }
+}
+
+static esp_err_t host_open(void *ctx, int offset, int *content_length)
+{
+    host_source_t *source = ctx;
+
+    if (offset > 0 && !source->seekable) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (offset < 0 || (size_t)offset >= source->len) {
+        return ESP_FAIL;        // 416 Range Not Satisfiable
+    }
+    source->opens++;
+    source->open = true;
+    source->pos = offset;
+    source->first_byte_pending = true;
+    *content_length = (int)(source->len - offset);
+    return ESP_OK;
+}
+
+static int host_read(void *ctx, char *buf, int len)
+{
+    host_source_t *source = ctx;
+
+    if (!source->open) {
+        return -1;
+    }
+    if (source->first_byte_pending) {
+        source->first_byte_pending = false;
+        if (source->first_byte_us) {
+            usleep(source->first_byte_us);
+        }
+    }
+    if (source->drop_at >= 0 && source->pos >= (size_t)source->drop_at) {
+        source->drop_at = -1;
+        source->open = false;
+        return -1;
+    }
+
+    size_t n = source->len - source->pos;
+    if (n > (size_t)len) {
+        n = len;
+    }
+    if (source->chunk && n > source->chunk) {
+        n = source->chunk;
+    }
+    // A break lands exactly at drop_at, the bytes before it arrive first
+    if (source->drop_at >= 0 && source->pos + n > (size_t)source->drop_at) {
+        n = source->drop_at - source->pos;
+    }
+    memcpy(buf, source->data + source->pos, n);
+    // One entry per response, a repeated offset corrupts the re-fetch too
+    for (int i = 0; i < HOST_CORRUPT_MAX; i++) {
+        int at = source->corrupt_at[i];
+        if (at >= 0 && (size_t)at >= source->pos && (size_t)at < source->pos + n) {
+            buf[at - source->pos] ^= 0x01;
+            source->corrupt_at[i] = -1;
+            break;
+        }
+    }
+    source->pos += n;
+    source->served += n;
+    return (int)n;
+}
+
+static void host_close(void *ctx)
+{
+    ((host_source_t *)ctx)->open = false;
+}
+
+static const ota_transport_ops_t host_ops = {
+    .open = host_open,
+    .read = host_read,
+    .close = host_close,
+};
+
+void host_transport_init(ota_transport_t *transport, host_source_t *source)
+{
+    transport->ops = &host_ops;
+    transport->ctx = source;
+    transport->url = source->seekable ? "http://host.test/firmware.bin" : NULL;
+}
@@ -0,0 +1,44 @@
+#ifndef HOST_TRANSPORT_H
+#define HOST_TRANSPORT_H
+
+// In-process stand-in for the firmware server behind ota_transport_t: serves
+// a buffer with Content-Length and Range semantics, and can add latency,
+// break the connection or corrupt a byte to exercise the engine's recovery
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ota_transport.h"
+
+#define HOST_CORRUPT_MAX 4
+
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+    size_t chunk;               // Largest read served at once, 0 = as requested
+    uint32_t first_byte_us;     // Delay before the first byte of every response
+    bool seekable;              // Honour Range opens (sets transport url), else upload-like
+    int drop_at;                // Stream offset where the connection breaks once, -1 = never
+    int corrupt_at[HOST_CORRUPT_MAX];   // Stream offsets served with one bit flipped once each, -1 = unused
+
+    // Counters
+    int opens;                  // Responses started, including Range resumes
+    size_t served;              // Bytes handed out over all responses
+
+    // Connection state
+    bool open;
+    size_t pos;
+    bool first_byte_pending;
+} host_source_t;
+
+/**
+ * @brief Serve len bytes of data, seekable, no faults
+ */
+void host_source_init(host_source_t *source, const uint8_t *data, size_t len);
+
+/**
+ * @brief Transport reading from source
+ */
+void host_transport_init(ota_transport_t *transport, host_source_t *source);
+
+#endif
@@ -0,0 +1,182 @@
+// health_check.c on a freshly updated image: valid once every check passes,
+// rolled back on a failing check or when one is still pending at the deadline.
+// The rollback stub ends the validation task the way the reboot would.
+
+#include "host_test.h"
+#include "host_stubs.h"
+#include "esp_timer.h"
+#include "health_check.h"
+#include <unistd.h>
+
+enum { CHECK_WIFI, CHECK_SERVER, CHECK_COUNT };
+
+static volatile health_status_t status[CHECK_COUNT];
+static volatile int pass_after[CHECK_COUNT];    // Polls answered PENDING before status applies
+static volatile int polls[CHECK_COUNT];
+static volatile int resumes;
+
+// The health check task hands the slot back to the journal resume
+void ota_manager_resume_interrupted(void)
+{
+    resumes++;
+}
+
+static health_status_t fake_check(void *arg)
+{
+    int i = (int)(uintptr_t)arg;
+    return ++polls[i] > pass_after[i] ? status[i] : HEALTH_PENDING;
+}
+
+static health_status_t filler_check(void *arg)
+{
+    return HEALTH_PASS;
+}
+
+static void arm(health_status_t wifi, int wifi_after, health_status_t server)
+{
+    status[CHECK_WIFI] = wifi;
+    pass_after[CHECK_WIFI] = wifi_after;
+    status[CHECK_SERVER] = server;
+    pass_after[CHECK_SERVER] = 0;
+    polls[CHECK_WIFI] = polls[CHECK_SERVER] = 0;
+    resumes = 0;
+    host_heap_set_free(HEALTH_CHECK_MIN_HEAP);
+    host_ota_set_running_state(ESP_OTA_IMG_PENDING_VERIFY);
+}
+
+// Wait until the validation task marked the image one way or the other
+static esp_ota_img_states_t wait_verdict(uint32_t timeout_ms)
+{
+    int64_t end_us = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    while (host_ota_get_running_state() == ESP_OTA_IMG_PENDING_VERIFY && esp_timer_get_time() < end_us) {
+        usleep(1000);
+    }
+    return host_ota_get_running_state();
+}
+
+static void wait_idle(void)
+{
+    for (int i = 0; i < 1000 && health_check_pending(); i++) {
+        usleep(1000);
+    }
+}
+
+static void test_register(void)
+{
+    CHECK_ERR(ESP_OK, health_check_register("wifi", fake_check, (void *)CHECK_WIFI));
+    CHECK_ERR(ESP_OK, health_check_register("ota_server", fake_check, (void *)CHECK_SERVER));
+    CHECK_ERR(ESP_OK, health_check_register("heap", health_check_heap, (void *)HEALTH_CHECK_MIN_HEAP));
+    for (int i = 3; i < HEALTH_CHECK_MAX; i++) {
+        CHECK_ERR(ESP_OK, health_check_register("filler", filler_check, NULL));
+    }
+    CHECK_ERR(ESP_ERR_NO_MEM, health_check_register("one_too_many", filler_check, NULL));
+}
+
+static void test_not_pending_verify(void)
+{
+    arm(HEALTH_FAIL, 0, HEALTH_FAIL);
+    host_ota_set_running_state(ESP_OTA_IMG_VALID);
+    CHECK_ERR(ESP_OK, health_check_start(1000));
+    CHECK(!health_check_pending());
+    usleep(20 * 1000);
+    CHECK(polls[CHECK_WIFI] == 0);
+    CHECK(host_ota_get_running_state() == ESP_OTA_IMG_VALID);
+}
+
+static void test_all_pass(void)
+{
+    uint32_t rollbacks = host_ota_rollbacks();
+    arm(HEALTH_PASS, 0, HEALTH_PASS);
+    CHECK_ERR(ESP_OK, health_check_start(5000));
+    CHECK(health_check_pending());
+    CHECK(wait_verdict(2000) == ESP_OTA_IMG_VALID);
+    wait_idle();
+    CHECK(!health_check_pending());
+    CHECK(resumes == 1);
+    CHECK(host_ota_rollbacks() == rollbacks);
+}
+
+static void test_pending_then_pass(void)
+{
+    // Wi-Fi comes up a few polls in, well before the deadline
+    arm(HEALTH_PASS, 10, HEALTH_PASS);
+    int64_t start_us = esp_timer_get_time();
+    CHECK_ERR(ESP_OK, health_check_start(5000));
+    CHECK(wait_verdict(2000) == ESP_OTA_IMG_VALID);
+    CHECK(esp_timer_get_time() - start_us >= 10LL * HEALTH_CHECK_POLL_MS * 1000);
+    CHECK(polls[CHECK_WIFI] == 11);
+    wait_idle();
+    CHECK(resumes == 1);
+}
+
+static void test_fail_rolls_back(void)
+{
+    uint32_t rollbacks = host_ota_rollbacks();
+    arm(HEALTH_PASS, 0, HEALTH_FAIL);
+    int64_t start_us = esp_timer_get_time();
+    CHECK_ERR(ESP_OK, health_check_start(5000));
+    CHECK(wait_verdict(2000) == ESP_OTA_IMG_INVALID);
+    CHECK(esp_timer_get_time() - start_us < 1000 * 1000);   // No waiting for the deadline
+    CHECK(host_ota_rollbacks() == rollbacks + 1);
+    CHECK(resumes == 0);
+}
+
+static void test_pending_until_deadline(void)
+{
+    // Wi-Fi never comes up: rolled back at the deadline, not before
+    const uint32_t deadline_ms = 200;
+    uint32_t rollbacks = host_ota_rollbacks();
+    arm(HEALTH_PENDING, 0, HEALTH_PASS);
+    int64_t start_us = esp_timer_get_time();
+    CHECK_ERR(ESP_OK, health_check_start(deadline_ms));
+    usleep(deadline_ms / 2 * 1000);
+    CHECK(host_ota_get_running_state() == ESP_OTA_IMG_PENDING_VERIFY);
+    CHECK(wait_verdict(2000) == ESP_OTA_IMG_INVALID);
+    int64_t elapsed_ms = (esp_timer_get_time() - start_us) / 1000;
+    CHECK(elapsed_ms >= deadline_ms);
+    CHECK(elapsed_ms < deadline_ms + 500);
+    CHECK(host_ota_rollbacks() == rollbacks + 1);
+    CHECK(resumes == 0);
+    CHECK(polls[CHECK_WIFI] > 1);
+}
+
+static void test_heap_floor(void)
+{
+    // Below the floor the heap check waits, and the deadline decides
+    uint32_t rollbacks = host_ota_rollbacks();
+    arm(HEALTH_PASS, 0, HEALTH_PASS);
+    host_heap_set_free(HEALTH_CHECK_MIN_HEAP - 1);
+    CHECK(health_check_heap((void *)HEALTH_CHECK_MIN_HEAP) == HEALTH_PENDING);
+    CHECK_ERR(ESP_OK, health_check_start(100));
+    CHECK(wait_verdict(2000) == ESP_OTA_IMG_INVALID);
+    CHECK(host_ota_rollbacks() == rollbacks + 1);
+
+    host_heap_set_free(HEALTH_CHECK_MIN_HEAP);
+    CHECK(health_check_heap((void *)HEALTH_CHECK_MIN_HEAP) == HEALTH_PASS);
+}
+
+static void test_register_while_validating(void)
+{
+    arm(HEALTH_PENDING, 0, HEALTH_PASS);
+    CHECK_ERR(ESP_OK, health_check_start(100));
+    CHECK_ERR(ESP_ERR_INVALID_STATE, health_check_register("late", filler_check, NULL));
+    wait_verdict(2000);
+}
+
+int main(void)
+{
+    esp_partition_t *running = host_partition_create("ota_0", 0x10000, 4096, NULL);
+    host_partition_set_slots(running, NULL);
+
+    RUN_TEST(test_register);
+    RUN_TEST(test_not_pending_verify);
+    RUN_TEST(test_all_pass);
+    RUN_TEST(test_pending_then_pass);
+    RUN_TEST(test_fail_rolls_back);
+    RUN_TEST(test_pending_until_deadline);
+    RUN_TEST(test_heap_floor);
+    RUN_TEST(test_register_while_validating);
+
+    host_partition_delete(running);
+    return TEST_EXIT();
+}
@@ -0,0 +1,74 @@
+// led_pattern_step() as the LED timer walks it: levels alternate from on,
+// durations repeat with the pattern, progress sets the OTA duty cycle
+
+#include "host_test.h"
+#include "led_pattern.h"
+
+static void test_normal_blink(void)
+{
+    int level;
+    for (uint32_t i = 0; i < 6; i++) {
+        CHECK(led_pattern_step(LED_MODE_NORMAL, -1, i, &level) == 1000);
+        CHECK(level == (i % 2 == 0));
+    }
+}
+
+static void test_recovery_double_blink(void)
+{
+    static const uint32_t expected[] = { 100, 100, 100, 900 };
+    int level;
+    for (uint32_t i = 0; i < 8; i++) {
+        CHECK(led_pattern_step(LED_MODE_RECOVERY, -1, i, &level) == expected[i % 4]);
+        CHECK(level == (i % 2 == 0));
+    }
+}
+
+static void test_off_holds_low(void)
+{
+    int level = 1;
+    CHECK(led_pattern_step(LED_MODE_OFF, -1, 0, &level) == 0);
+    CHECK(level == 0);
+    level = 1;
+    CHECK(led_pattern_step(LED_MODE_OFF, 50, 3, &level) == 0);
+    CHECK(level == 0);
+}
+
+static void test_ota_without_progress(void)
+{
+    int level;
+    CHECK(led_pattern_step(LED_MODE_OTA, -1, 0, &level) == 200);
+    CHECK(level == 1);
+    CHECK(led_pattern_step(LED_MODE_OTA, -1, 1, &level) == 200);
+    CHECK(level == 0);
+}
+
+static void test_ota_progress_duty(void)
+{
+    int level;
+    CHECK(led_pattern_step(LED_MODE_OTA, 0, 0, &level) == LED_PROGRESS_MIN_ON_MS);
+    CHECK(level == 1);
+    CHECK(led_pattern_step(LED_MODE_OTA, 100, 0, &level) ==
+          LED_PROGRESS_PERIOD_MS - LED_PROGRESS_MIN_ON_MS);
+
+    // On-time grows with progress, every period stays the same length
+    uint32_t last_on = 0;
+    for (int percent = 0; percent <= 100; percent++) {
+        uint32_t on = led_pattern_step(LED_MODE_OTA, percent, 0, &level);
+        uint32_t off = led_pattern_step(LED_MODE_OTA, percent, 1, &level);
+        CHECK(level == 0);
+        CHECK(on + off == LED_PROGRESS_PERIOD_MS);
+        CHECK(on >= last_on);
+        CHECK(off >= LED_PROGRESS_MIN_ON_MS);
+        last_on = on;
+    }
+}
+
+int main(void)
+{
+    RUN_TEST(test_normal_blink);
+    RUN_TEST(test_recovery_double_blink);
+    RUN_TEST(test_off_holds_low);
+    RUN_TEST(test_ota_without_progress);
+    RUN_TEST(test_ota_progress_duty);
+    return TEST_EXIT();
+}
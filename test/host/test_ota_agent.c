@@ -0,0 +1,283 @@
+// ota_agent.c polling a manifest served on 127.0.0.1: If-None-Match/304
+// between releases, only newer versions queued, and a version whose image
+// was rejected or rolled back skipped until the manifest changes. The job
+// worker, Wi-Fi and the health check are faked; OTA_AGENT_INTERVAL_MS is
+// short in the host build.
+
+#include "host_test.h"
+#include "host_image.h"
+#include "host_stubs.h"
+#include "esp_http_client.h"
+#include "esp_timer.h"
+#include "ota_agent.h"
+#include "health_check.h"
+#include "ota_job.h"
+#include "wifi_manager.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Manifest server
+static char manifest_etag[32];
+static char manifest_body[128];
+static int requests;
+static int not_modified;
+
+// Fakes
+static volatile bool connected = true;
+static volatile bool probation = false;
+static esp_partition_t *invalid_slot;          // Slot of a rolled-back image
+static ota_job_status_t job_status = { .phase = OTA_PHASE_IDLE };
+static int submitted;
+static int submitted_foreground;
+static char submitted_url[OTA_JOB_URL_MAX];
+static uint32_t submitted_version;
+
+esp_err_t ota_job_submit_background(const char *url, uint32_t min_version)
+{
+    pthread_mutex_lock(&lock);
+    submitted++;
+    snprintf(submitted_url, sizeof(submitted_url), "%s", url);
+    submitted_version = min_version;
+    pthread_mutex_unlock(&lock);
+    return ESP_OK;
+}
+
+esp_err_t ota_job_submit_versioned(const char *url, uint32_t min_version)
+{
+    pthread_mutex_lock(&lock);
+    submitted_foreground++;
+    pthread_mutex_unlock(&lock);
+    return ESP_OK;
+}
+
+void ota_job_get_status(ota_job_status_t *status)
+{
+    pthread_mutex_lock(&lock);
+    *status = job_status;
+    pthread_mutex_unlock(&lock);
+}
+
+bool wifi_is_connected(void)
+{
+    return connected;
+}
+
+bool health_check_pending(void)
+{
+    return probation;
+}
+
+static void job_finished(const char *url, esp_err_t err)
+{
+    pthread_mutex_lock(&lock);
+    job_status.phase = err == ESP_OK ? OTA_PHASE_IDLE : OTA_PHASE_FAILED;
+    job_status.last_error = err;
+    snprintf(job_status.url, sizeof(job_status.url), "%s", url);
+    pthread_mutex_unlock(&lock);
+}
+
+static esp_err_t manifest_handler(httpd_req_t *req)
+{
+    char etag[32], body[128], if_none_match[32];
+    pthread_mutex_lock(&lock);
+    requests++;
+    strcpy(etag, manifest_etag);
+    strcpy(body, manifest_body);
+    bool unchanged = httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+                     strcmp(if_none_match, etag) == 0;
+    if (unchanged) {
+        not_modified++;
+    }
+    pthread_mutex_unlock(&lock);
+
+    httpd_resp_set_hdr(req, "ETag", etag);
+    if (unchanged) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_sendstr(req, body);
+}
+
+static void publish(const char *etag, const char *version, const char *url)
+{
+    pthread_mutex_lock(&lock);
+    snprintf(manifest_etag, sizeof(manifest_etag), "\"%s\"", etag);
+    snprintf(manifest_body, sizeof(manifest_body), "{\"version\": \"%s\", \"url\": \"%s\"}", version, url);
+    pthread_mutex_unlock(&lock);
+}
+
+static int counter(int *value)
+{
+    pthread_mutex_lock(&lock);
+    int v = *value;
+    pthread_mutex_unlock(&lock);
+    return v;
+}
+
+// Until n more polls have been acted on: the agent sends the next request
+// only after deciding on the previous answer. False on timeout.
+static bool wait_polls(int n)
+{
+    int target = counter(&requests) + n + 1;
+    int64_t end_us = esp_timer_get_time() + 2000 * 1000;
+    while (counter(&requests) < target) {
+        if (esp_timer_get_time() > end_us) {
+            return false;
+        }
+        usleep(2000);
+    }
+    return true;
+}
+
+static void test_same_version_not_queued(void)
+{
+    CHECK(wait_polls(3));
+    CHECK(counter(&submitted) == 0);
+
+    // The first poll gets the manifest, the rest revalidate it
+    CHECK(counter(&not_modified) >= 2);
+}
+
+static void test_newer_version_queued(void)
+{
+    int before = counter(&not_modified);
+    publish("m2", "1.1.0", "http://fw.test/b.bin");
+    CHECK(wait_polls(2));
+    CHECK(counter(&submitted) >= 1);
+    pthread_mutex_lock(&lock);
+    CHECK(strcmp(submitted_url, "http://fw.test/b.bin") == 0);
+    CHECK(submitted_version == 0x010100);
+    pthread_mutex_unlock(&lock);
+    CHECK(counter(&submitted_foreground) == 0);     // OTA_AGENT_BACKGROUND
+
+    // Still cached across 304s, and still offered while it has not installed
+    int queued = counter(&submitted);
+    CHECK(wait_polls(3));
+    CHECK(counter(&not_modified) > before);
+    CHECK(counter(&submitted) > queued);
+}
+
+static void test_older_version_ignored(void)
+{
+    publish("m3", "0.9.0", "http://fw.test/old.bin");
+    CHECK(wait_polls(2));
+    int queued = counter(&submitted);
+    CHECK(wait_polls(3));
+    CHECK(counter(&submitted) == queued);
+}
+
+static void test_rejected_version_skipped(void)
+{
+    publish("m4", "1.3.0", "http://fw.test/c.bin");
+    CHECK(wait_polls(2));
+    CHECK(counter(&submitted) > 0);
+
+    // The download fails verification: not queued again...
+    job_finished("http://fw.test/c.bin", ESP_ERR_OTA_VALIDATE_FAILED);
+    CHECK(wait_polls(2));
+    int queued = counter(&submitted);
+    CHECK(wait_polls(3));
+    CHECK(counter(&submitted) == queued);
+
+    // ...even once another job has replaced the failed status
+    job_finished("http://other.test/x.bin", ESP_OK);
+    CHECK(wait_polls(3));
+    CHECK(counter(&submitted) == queued);
+
+    // The server republishes the version (new ETag): offered again
+    publish("m5", "1.3.0", "http://fw.test/c.bin");
+    CHECK(wait_polls(3));
+    CHECK(counter(&submitted) > queued);
+}
+
+static void test_network_failure_retried(void)
+{
+    publish("m6", "1.4.0", "http://fw.test/d.bin");
+    CHECK(wait_polls(2));
+    job_finished("http://fw.test/d.bin", ESP_ERR_HTTP_CONNECT);
+    CHECK(wait_polls(2));
+    int queued = counter(&submitted);
+    CHECK(wait_polls(3));
+    CHECK(counter(&submitted) > queued);
+    job_finished("http://fw.test/d.bin", ESP_OK);
+}
+
+static void test_rolled_back_version_skipped(void)
+{
+    // 1.5.0 booted and was rolled back
+    uint8_t *image = host_image_app(4096, "1.5.0", 1);
+    esp_partition_write(invalid_slot, 0, image, 4096);
+    free(image);
+    host_ota_set_last_invalid(invalid_slot);
+
+    publish("m7", "1.5.0", "http://fw.test/e.bin");
+    CHECK(wait_polls(3));
+    pthread_mutex_lock(&lock);
+    CHECK(strcmp(submitted_url, "http://fw.test/e.bin") != 0);
+    pthread_mutex_unlock(&lock);
+
+    // A later version is fine
+    publish("m8", "1.6.0", "http://fw.test/f.bin");
+    CHECK(wait_polls(2));
+    pthread_mutex_lock(&lock);
+    CHECK(strcmp(submitted_url, "http://fw.test/f.bin") == 0);
+    pthread_mutex_unlock(&lock);
+    host_ota_set_last_invalid(NULL);
+}
+
+// No poll while flag is set
+static void check_paused(volatile bool *flag, bool paused)
+{
+    *flag = paused;
+    usleep(5 * OTA_AGENT_INTERVAL_MS * 1000);      // A poll in flight finishes
+    int before = counter(&requests);
+    usleep(5 * OTA_AGENT_INTERVAL_MS * 1000);
+    CHECK(counter(&requests) == before);
+    *flag = !paused;
+    CHECK(wait_polls(1));
+}
+
+static void test_offline_no_poll(void)
+{
+    check_paused(&connected, false);
+}
+
+static void test_probation_no_poll(void)
+{
+    // Updating before this image is validated would lose the rollback
+    check_paused(&probation, true);
+}
+
+int main(void)
+{
+    invalid_slot = host_partition_create("ota_1", 0x110000, 64 * 1024, NULL);
+
+    httpd_handle_t server;
+    uint16_t port;
+    CHECK_ERR(ESP_OK, host_httpd_start(&server, &port));
+    httpd_uri_t uri = { .uri = "/manifest.json", .method = HTTP_GET, .handler = manifest_handler };
+    CHECK_ERR(ESP_OK, httpd_register_uri_handler(server, &uri));
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%u/manifest.json", port);
+
+    // The running image is host_app_desc()'s 1.0.0
+    publish("m1", "1.0.0", "http://fw.test/a.bin");
+    CHECK_ERR(ESP_OK, ota_agent_start(url));
+    CHECK_ERR(ESP_ERR_INVALID_STATE, ota_agent_start(url));
+
+    RUN_TEST(test_same_version_not_queued);
+    RUN_TEST(test_newer_version_queued);
+    RUN_TEST(test_older_version_ignored);
+    RUN_TEST(test_rejected_version_skipped);
+    RUN_TEST(test_network_failure_retried);
+    RUN_TEST(test_rolled_back_version_skipped);
+    RUN_TEST(test_offline_no_poll);
+    RUN_TEST(test_probation_no_poll);
+
+    host_partition_delete(invalid_slot);
+    return TEST_EXIT();
+}
@@ -0,0 +1,135 @@
+// ota_blocks: geometry checks, table check, per-block verification and rewind
+
+#include "host_test.h"
+#include "host_image.h"
+#include "ota_arena.h"
+#include "ota_blocks.h"
+#include "mbedtls/sha256.h"
+#include <stdlib.h>
+
+#define BLOCK_SIZE    8192
+#define PAYLOAD_SIZE  (3 * BLOCK_SIZE + 100)
+#define BLOCK_COUNT   4
+
+typedef struct {
+    uint8_t buf[PAYLOAD_SIZE];
+    size_t len;
+} sink_t;
+
+static esp_err_t collect(const uint8_t *data, size_t len, void *arg)
+{
+    sink_t *sink = arg;
+    memcpy(sink->buf + sink->len, data, len);
+    sink->len += len;
+    return ESP_OK;
+}
+
+static uint8_t *payload;
+static uint8_t table[BLOCK_COUNT * OTA_BLOCK_DIGEST_SIZE];
+static ota_blocks_ext_t ext;
+
+static ota_blocks_t *setup(sink_t *sink)
+{
+    ota_arena_reset();
+    memset(sink, 0, sizeof(*sink));
+    ota_blocks_t *blocks = ota_blocks_create(&ext, PAYLOAD_SIZE, collect, sink);
+    CHECK(blocks != NULL);
+    size_t len;
+    memcpy(ota_blocks_table(blocks, &len), table, sizeof(table));
+    CHECK(len == sizeof(table));
+    CHECK_ERR(ESP_OK, ota_blocks_check_table(blocks));
+    return blocks;
+}
+
+static void test_blocks_geometry(void)
+{
+    ota_blocks_ext_t bad = ext;
+    ota_arena_reset();
+    bad.block_size = 1000;
+    CHECK(ota_blocks_create(&bad, PAYLOAD_SIZE, collect, NULL) == NULL);
+    bad.block_size = OTA_BLOCK_MAX_SIZE + 4096;
+    CHECK(ota_blocks_create(&bad, PAYLOAD_SIZE, collect, NULL) == NULL);
+    bad = ext;
+    bad.block_count = BLOCK_COUNT + 1;
+    CHECK(ota_blocks_create(&bad, PAYLOAD_SIZE, collect, NULL) == NULL);
+}
+
+static void test_blocks_table_digest(void)
+{
+    sink_t sink;
+    ota_blocks_t *blocks = setup(&sink);
+    size_t len;
+    ota_blocks_table(blocks, &len)[5] ^= 1;
+    CHECK_ERR(ESP_ERR_INVALID_CRC, ota_blocks_check_table(blocks));
+}
+
+static void test_blocks_pass_verified_data(void)
+{
+    sink_t sink;
+    ota_blocks_t *blocks = setup(&sink);
+    for (size_t pos = 0; pos < PAYLOAD_SIZE; pos += 1000) {
+        size_t n = PAYLOAD_SIZE - pos < 1000 ? PAYLOAD_SIZE - pos : 1000;
+        CHECK_ERR(ESP_OK, ota_blocks_feed(blocks, payload + pos, n));
+        // Nothing of a block is passed on before all of it has been checked
+        CHECK(sink.len % BLOCK_SIZE == 0 || sink.len == PAYLOAD_SIZE);
+    }
+    CHECK(ota_blocks_done(blocks));
+    CHECK(sink.len == PAYLOAD_SIZE);
+    CHECK(memcmp(sink.buf, payload, PAYLOAD_SIZE) == 0);
+    const uint8_t extra = 0;
+    CHECK_ERR(ESP_ERR_INVALID_SIZE, ota_blocks_feed(blocks, &extra, 1));
+}
+
+static void test_blocks_corrupt_block_rewinds(void)
+{
+    sink_t sink;
+    ota_blocks_t *blocks = setup(&sink);
+    uint8_t *bad = malloc(PAYLOAD_SIZE);
+    memcpy(bad, payload, PAYLOAD_SIZE);
+    bad[BLOCK_SIZE + 17] ^= 0x40;
+
+    CHECK_ERR(ESP_OK, ota_blocks_feed(blocks, bad, BLOCK_SIZE));
+    CHECK_ERR(ESP_ERR_INVALID_CRC, ota_blocks_feed(blocks, bad + BLOCK_SIZE, BLOCK_SIZE));
+    CHECK(sink.len == BLOCK_SIZE);
+
+    // Refetch from the start of the failed block
+    CHECK(ota_blocks_rewind(blocks) == BLOCK_SIZE);
+    CHECK_ERR(ESP_OK, ota_blocks_feed(blocks, payload + BLOCK_SIZE, PAYLOAD_SIZE - BLOCK_SIZE));
+    CHECK(ota_blocks_done(blocks));
+    CHECK(memcmp(sink.buf, payload, PAYLOAD_SIZE) == 0);
+    free(bad);
+}
+
+static void test_blocks_seek(void)
+{
+    sink_t sink;
+    ota_blocks_t *blocks = setup(&sink);
+    CHECK_ERR(ESP_ERR_INVALID_ARG, ota_blocks_seek(blocks, BLOCK_SIZE + 1));
+    CHECK_ERR(ESP_OK, ota_blocks_seek(blocks, 2 * BLOCK_SIZE));
+    CHECK_ERR(ESP_OK, ota_blocks_feed(blocks, payload + 2 * BLOCK_SIZE, PAYLOAD_SIZE - 2 * BLOCK_SIZE));
+    CHECK(ota_blocks_done(blocks));
+    CHECK(sink.len == PAYLOAD_SIZE - 2 * BLOCK_SIZE);
+}
+
+int main(void)
+{
+    ota_arena_init();
+    payload = host_image_app(PAYLOAD_SIZE, "1.0.0", 3);
+    for (int i = 0; i < BLOCK_COUNT; i++) {
+        size_t start = (size_t)i * BLOCK_SIZE;
+        size_t n = PAYLOAD_SIZE - start < BLOCK_SIZE ? PAYLOAD_SIZE - start : BLOCK_SIZE;
+        mbedtls_sha256(payload + start, n, table + i * OTA_BLOCK_DIGEST_SIZE, 0);
+    }
+    ext.block_size = BLOCK_SIZE;
+    ext.block_count = BLOCK_COUNT;
+    mbedtls_sha256(table, sizeof(table), ext.table_sha256, 0);
+
+    RUN_TEST(test_blocks_geometry);
+    RUN_TEST(test_blocks_table_digest);
+    RUN_TEST(test_blocks_pass_verified_data);
+    RUN_TEST(test_blocks_corrupt_block_rewinds);
+    RUN_TEST(test_blocks_seek);
+
+    free(payload);
+    return TEST_EXIT();
+}
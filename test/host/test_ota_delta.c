@@ -0,0 +1,131 @@
+// ota_delta: patch application against a base partition
+
+#include "host_test.h"
+#include "host_image.h"
+#include "host_stubs.h"
+#include "ota_arena.h"
+#include "ota_delta.h"
+#include "ota_header.h"
+#include "mbedtls/sha256.h"
+#include <stdlib.h>
+
+#define IMAGE_SIZE  (40 * 1024 + 77)
+
+static esp_partition_t *base_part;
+static uint8_t *base;
+
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t cap;
+} sink_t;
+
+static esp_err_t collect(const uint8_t *data, size_t len, void *arg)
+{
+    sink_t *sink = arg;
+    if (sink->len + len > sink->cap) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(sink->buf + sink->len, data, len);
+    sink->len += len;
+    return ESP_OK;
+}
+
+// The patch part of a delta container built by host_container_build()
+static const uint8_t *patch_of(const uint8_t *container, size_t len, size_t *patch_len)
+{
+    size_t skip = OTA_HEADER_SIZE + OTA_DELTA_EXT_SIZE;
+    *patch_len = len - skip;
+    return container + skip;
+}
+
+static void apply(size_t piece)
+{
+    uint8_t *image = host_image_app(IMAGE_SIZE, "1.1.0", 1);
+    memcpy(image + 8192, base + 8192, 16384);       // Two sectors in common
+    host_container_t opts = { .version = 0x010100, .base = base, .base_len = IMAGE_SIZE };
+    size_t container_len, patch_len;
+    uint8_t *container = host_container_build(image, IMAGE_SIZE, &opts, &container_len);
+    const uint8_t *patch = patch_of(container, container_len, &patch_len);
+    CHECK(patch_len < IMAGE_SIZE);
+
+    ota_arena_reset();
+    sink_t sink = { .buf = malloc(IMAGE_SIZE), .cap = IMAGE_SIZE };
+    ota_delta_t *delta = ota_delta_create(base_part, IMAGE_SIZE, collect, &sink);
+    esp_err_t err = ESP_OK;
+    for (size_t pos = 0; pos < patch_len && err == ESP_OK; pos += piece) {
+        size_t n = patch_len - pos < piece ? patch_len - pos : piece;
+        err = ota_delta_feed(delta, patch + pos, n);
+    }
+    CHECK_ERR(ESP_OK, err);
+    CHECK_ERR(ESP_OK, ota_delta_finish(delta));
+    CHECK(sink.len == IMAGE_SIZE);
+    CHECK(memcmp(sink.buf, image, IMAGE_SIZE) == 0);
+
+    free(sink.buf);
+    free(container);
+    free(image);
+}
+
+static void test_delta_applies_whole_patch(void)
+{
+    apply(1 << 20);
+}
+
+static void test_delta_ops_straddle_feeds(void)
+{
+    apply(1);
+    apply(3);
+    apply(1000);
+}
+
+static void test_delta_checks_base(void)
+{
+    uint8_t digest[32];
+    mbedtls_sha256(base, IMAGE_SIZE, digest, 0);
+    ota_arena_reset();
+    CHECK_ERR(ESP_OK, ota_delta_check_base(base_part, IMAGE_SIZE, digest));
+    digest[0] ^= 1;
+    CHECK_ERR(ESP_ERR_INVALID_STATE, ota_delta_check_base(base_part, IMAGE_SIZE, digest));
+    CHECK_ERR(ESP_ERR_INVALID_STATE, ota_delta_check_base(base_part, base_part->size + 1, digest));
+}
+
+static void test_delta_rejects_bad_ops(void)
+{
+    uint8_t out[64];
+    sink_t sink = { .buf = out, .cap = sizeof(out) };
+
+    ota_arena_reset();
+    ota_delta_t *delta = ota_delta_create(base_part, IMAGE_SIZE, collect, &sink);
+    const uint8_t unknown[] = { 0x7f };
+    CHECK_ERR(ESP_ERR_INVALID_RESPONSE, ota_delta_feed(delta, unknown, sizeof(unknown)));
+
+    delta = ota_delta_create(base_part, IMAGE_SIZE, collect, &sink);
+    const uint8_t copy_past_base[] = { OTA_DELTA_OP_COPY, 0x00, 0xa0, 0, 0, 0x00, 0x01, 0, 0 };
+    CHECK_ERR(ESP_ERR_INVALID_RESPONSE, ota_delta_feed(delta, copy_past_base, sizeof(copy_past_base)));
+
+    delta = ota_delta_create(base_part, IMAGE_SIZE, collect, &sink);
+    const uint8_t truncated_add[] = { OTA_DELTA_OP_ADD, 4, 0, 0, 0, 'a', 'b' };
+    CHECK_ERR(ESP_OK, ota_delta_feed(delta, truncated_add, sizeof(truncated_add)));
+    CHECK_ERR(ESP_ERR_INVALID_SIZE, ota_delta_finish(delta));
+}
+
+int main(void)
+{
+    ota_arena_init();
+    base_part = host_partition_create("ota_0", 0x10000, 64 * 1024, NULL);
+    base = host_image_app(IMAGE_SIZE, "1.0.0", 99);
+    for (size_t pos = 0; pos < IMAGE_SIZE; pos += 4096) {
+        esp_partition_erase_range(base_part, pos, 4096);
+    }
+    CHECK_ERR(ESP_OK, esp_partition_write(base_part, 0, base, IMAGE_SIZE));
+
+    RUN_TEST(test_delta_applies_whole_patch);
+    RUN_TEST(test_delta_ops_straddle_feeds);
+    RUN_TEST(test_delta_checks_base);
+    RUN_TEST(test_delta_rejects_bad_ops);
+
+    host_partition_delete(base_part);
+    free(base);
+    return TEST_EXIT();
+}
@@ -0,0 +1,421 @@
+// End-to-end runs of ota_engine_run(): container in, image in the slot out
+
+#include "host_test.h"
+#include "host_image.h"
+#include "host_stubs.h"
+#include "host_transport.h"
+#include "ota_arena.h"
+#include "ota_blocks.h"
+#include "ota_engine.h"
+#include "ota_header.h"
+#include <stdlib.h>
+
+#define SLOT_SIZE   (512 * 1024)
+#define IMAGE_SIZE  (192 * 1024 + 100)     // Not a whole number of sectors
+
+static esp_partition_t *running;
+static esp_partition_t *next;
+static uint8_t *base;                      // What the running slot holds
+static uint8_t *image;                     // What the tests flash
+
+static esp_err_t run(ota_transport_t *transport, const ota_update_config_t *config)
+{
+    ota_arena_reset();
+    return ota_engine_run(transport, config, next);
+}
+
+static esp_err_t run_source(host_source_t *source)
+{
+    ota_transport_t transport;
+    ota_update_config_t config = OTA_UPDATE_CONFIG_DEFAULT();
+    host_transport_init(&transport, source);
+    return run(&transport, &config);
+}
+
+static bool slot_holds(const uint8_t *expected, size_t len)
+{
+    uint8_t *buf = malloc(len);
+    bool same = esp_partition_read(next, 0, buf, len) == ESP_OK && memcmp(buf, expected, len) == 0;
+    free(buf);
+    return same;
+}
+
+static void wipe_slot(void)
+{
+    esp_partition_erase_range(next, 0, SLOT_SIZE);
+}
+
+static uint8_t *build(const host_container_t *opts, size_t *len)
+{
+    return host_container_build(image, IMAGE_SIZE, opts, len);
+}
+
+static void test_raw(void)
+{
+    wipe_slot();
+    host_source_t source;
+    host_source_init(&source, image, IMAGE_SIZE);
+    CHECK_ERR(ESP_OK, run_source(&source));
+    CHECK(slot_holds(image, IMAGE_SIZE));
+}
+
+static void test_header(void)
+{
+    wipe_slot();
+    host_container_t opts = { .version = 0x010100 };
+    size_t len;
+    uint8_t *container = build(&opts, &len);
+    host_source_t source;
+    host_source_init(&source, container, len);
+    source.chunk = 700;
+    CHECK_ERR(ESP_OK, run_source(&source));
+    CHECK(slot_holds(image, IMAGE_SIZE));
+    free(container);
+}
+
+static void test_compressed(void)
+{
+    wipe_slot();
+    host_container_t opts = { .version = 0x010100, .compress = true };
+    size_t len;
+    uint8_t *container = build(&opts, &len);
+    CHECK(len < IMAGE_SIZE);
+    host_source_t source;
+    host_source_init(&source, container, len);
+    CHECK_ERR(ESP_OK, run_source(&source));
+    CHECK(slot_holds(image, IMAGE_SIZE));
+    free(container);
+}
+
+static void test_delta(void)
+{
+    wipe_slot();
+    host_container_t opts = { .version = 0x010100, .compress = true,
+                              .base = base, .base_len = IMAGE_SIZE };
+    size_t len;
+    uint8_t *container = build(&opts, &len);
+    host_source_t source;
+    host_source_init(&source, container, len);
+    CHECK_ERR(ESP_OK, run_source(&source));
+    CHECK(slot_holds(image, IMAGE_SIZE));
+    free(container);
+}
+
+static void test_delta_wrong_base(void)
+{
+    uint8_t *other = host_image_app(IMAGE_SIZE, "0.9.0", 99);
+    host_container_t opts = { .version = 0x010100, .base = other, .base_len = IMAGE_SIZE };
+    size_t len;
+    uint8_t *container = build(&opts, &len);
+    host_source_t source;
+    host_source_init(&source, container, len);
+    CHECK(run_source(&source) != ESP_OK);
+    free(container);
+    free(other);
+}
+
+static void test_blocks(void)
+{
+    wipe_slot();
+    host_container_t opts = { .version = 0x010100, .compress = true, .block_size = 4096 };
+    size_t len;
+    uint8_t *container = build(&opts, &len);
+    host_source_t source;
+    host_source_init(&source, container, len);
+    CHECK_ERR(ESP_OK, run_source(&source));
+    CHECK(slot_holds(image, IMAGE_SIZE));
+    CHECK(source.opens == 1);
+    free(container);
+}
+
+static void test_corrupt_block_refetched(void)
+{
+    wipe_slot();
+    host_container_t opts = { .version = 0x010100, .compress = true, .block_size = 4096 };
+    size_t len;
+    uint8_t *container = build(&opts, &len);
+    host_source_t source;
+    host_source_init(&source, container, len);
+    source.corrupt_at[0] = len / 2;
+    CHECK_ERR(ESP_OK, run_source(&source));
+    CHECK(slot_holds(image, IMAGE_SIZE));
+    CHECK(source.opens == 2);
+    free(container);
+}
+
+// The retry budget is per block: more corrupt blocks than OTA_BLOCK_RETRIES
+// in one image still succeed, one block failing every time does not
+static void test_corrupt_blocks_retried_separately(void)
+{
+    wipe_slot();
+    host_container_t opts = { .version = 0x010100, .compress = true, .block_size = 4096 };
+    size_t len;
+    uint8_t *container = build(&opts, &len);
+    host_source_t source;
+    host_source_init(&source, container, len);
+    for (int i = 0; i <= OTA_BLOCK_RETRIES; i++) {
+        source.corrupt_at[i] = len * (i + 1) / (OTA_BLOCK_RETRIES + 2);
+    }
+    CHECK_ERR(ESP_OK, run_source(&source));
+    CHECK(slot_holds(image, IMAGE_SIZE));
+    CHECK(source.opens == OTA_BLOCK_RETRIES + 2);
+
+    host_source_init(&source, container, len);
+    for (int i = 0; i <= OTA_BLOCK_RETRIES; i++) {
+        source.corrupt_at[i] = len / 2;
+    }
+    CHECK_ERR(ESP_ERR_INVALID_CRC, run_source(&source));
+    free(container);
+}
+
+static void test_corrupt_without_blocks(void)
+{
+    host_container_t opts = { .version = 0x010100 };
+    size_t len;
+    uint8_t *container = build(&opts, &len);
+    host_source_t source;
+    host_source_init(&source, container, len);
+    source.corrupt_at[0] = len / 2;
+    CHECK_ERR(ESP_ERR_INVALID_CRC, run_source(&source));
+    free(container);
+}
+
+static void test_connection_drop_resumes(void)
+{
+    wipe_slot();
+    host_container_t opts = { .version = 0x010100, .compress = true };
+    size_t len;
+    uint8_t *container = build(&opts, &len);
+    host_source_t source;
+    host_source_init(&source, container, len);
+    source.drop_at = len / 3;
+    CHECK_ERR(ESP_OK, run_source(&source));
+    CHECK(slot_holds(image, IMAGE_SIZE));
+    CHECK(source.opens == 2);
+    free(container);
+}
+
+static void test_drop_without_range_fails(void)
+{
+    host_source_t source;
+    host_source_init(&source, image, IMAGE_SIZE);
+    source.seekable = false;
+    source.drop_at = IMAGE_SIZE / 2;
+    CHECK_ERR(ESP_FAIL, run_source(&source));
+}
+
+static void test_truncated(void)
+{
+    host_container_t opts = { .version = 0x010100, .compress = true };
+    size_t len;
+    uint8_t *container = build(&opts, &len);
+    host_source_t source;
+    host_source_init(&source, container, len - 1000);
+    CHECK(run_source(&source) != ESP_OK);
+    free(container);
+}
+
+static void test_min_version(void)
+{
+    host_container_t opts = { .version = 0x010100 };
+    size_t len;
+    uint8_t *container = build(&opts, &len);
+    host_source_t source;
+    host_source_init(&source, container, len);
+    ota_transport_t transport;
+    host_transport_init(&transport, &source);
+    ota_update_config_t config = OTA_UPDATE_CONFIG_DEFAULT();
+    config.min_version = 0x010101;
+
+    host_flash_reset_stats();
+    CHECK_ERR(ESP_ERR_INVALID_VERSION, run(&transport, &config));
+    host_flash_stats_t stats;
+    host_flash_get_stats(&stats);
+    CHECK(stats.erase_ops == 0);            // Rejected before anything was erased
+    free(container);
+}
+
+static bool cancel_flag;
+
+static void cancel_on_progress(ota_phase_t phase, int done, int total, void *arg)
+{
+    if (phase == OTA_PHASE_DOWNLOADING && done > total / 2) {
+        cancel_flag = true;
+    }
+}
+
+static void test_cancel(void)
+{
+    host_source_t source;
+    host_source_init(&source, image, IMAGE_SIZE);
+    ota_transport_t transport;
+    host_transport_init(&transport, &source);
+    ota_update_config_t config = OTA_UPDATE_CONFIG_DEFAULT();
+    cancel_flag = false;
+    config.cancel = &cancel_flag;
+    config.progress = cancel_on_progress;
+    CHECK_ERR(ESP_ERR_INVALID_STATE, run(&transport, &config));
+    CHECK(source.served < IMAGE_SIZE);
+}
+
+static void test_skip_unchanged(void)
+{
+    host_container_t opts = { .version = 0x010100, .compress = true };
+    size_t len;
+    uint8_t *container = build(&opts, &len);
+    host_source_t source;
+    host_source_init(&source, container, len);
+    ota_transport_t transport;
+    host_transport_init(&transport, &source);
+    ota_update_result_t result;
+    ota_update_config_t config = OTA_UPDATE_CONFIG_DEFAULT();
+    config.skip_unchanged = true;
+    config.result = &result;
+
+    wipe_slot();
+    CHECK_ERR(ESP_OK, run(&transport, &config));
+    CHECK(result.image_bytes == IMAGE_SIZE);
+    CHECK(result.sectors_skipped == 0);
+
+    // Same image again: nothing to erase
+    host_source_init(&source, container, len);
+    host_flash_reset_stats();
+    CHECK_ERR(ESP_OK, run(&transport, &config));
+    CHECK(result.sectors_written == 0);
+    CHECK(result.sectors_skipped == (IMAGE_SIZE + 4095) / 4096);
+    host_flash_stats_t stats;
+    host_flash_get_stats(&stats);
+    CHECK(stats.erase_ops == 0);
+    CHECK(slot_holds(image, IMAGE_SIZE));
+    free(container);
+}
+
+static void test_upload(void)
+{
+    wipe_slot();
+    host_container_t opts = { .version = 0x010100, .compress = true };
+    size_t len;
+    uint8_t *container = build(&opts, &len);
+    httpd_req_t req;
+    host_upload_t body = { .data = container, .len = len, .chunk = 1460 };
+    host_upload_init(&req, &body);
+    ota_transport_t transport;
+    CHECK_ERR(ESP_OK, ota_transport_upload_init(&transport, &req));
+    CHECK(transport.url == NULL);
+    ota_update_config_t config = OTA_UPDATE_CONFIG_DEFAULT();
+    CHECK_ERR(ESP_OK, run(&transport, &config));
+    CHECK(slot_holds(image, IMAGE_SIZE));
+    free(container);
+}
+
+// Container served over 127.0.0.1 for the HTTP transport and segmented fetches
+static const uint8_t *served;
+static size_t served_len;
+
+static esp_err_t firmware_handler(httpd_req_t *req)
+{
+    char range[48], content_range[64];
+    unsigned long first = 0, last = served_len - 1;
+    if (httpd_req_get_hdr_value_str(req, "Range", range, sizeof(range)) == ESP_OK &&
+        sscanf(range, "bytes=%lu-%lu", &first, &last) >= 1) {
+        if (last >= served_len) {
+            last = served_len - 1;
+        }
+        snprintf(content_range, sizeof(content_range), "bytes %lu-%lu/%zu", first, last, served_len);
+        httpd_resp_set_status(req, "206 Partial Content");
+        httpd_resp_set_hdr(req, "Content-Range", content_range);
+    }
+    httpd_resp_set_type(req, "application/octet-stream");
+    return httpd_resp_send(req, (const char *)served + first, last - first + 1);
+}
+
+// The whole update, transport included, never calls malloc/calloc from main/
+static void run_without_heap(const char *url, int connections)
+{
+    wipe_slot();
+    host_heap_stats_t before, after;
+    host_heap_get_stats(&before);
+
+    ota_transport_t transport;
+    CHECK_ERR(ESP_OK, ota_transport_http_init(&transport, url));
+    ota_update_config_t config = OTA_UPDATE_CONFIG_DEFAULT();
+    config.connections = connections;
+    CHECK_ERR(ESP_OK, run(&transport, &config));
+    ota_transport_http_deinit(&transport);
+
+    host_heap_get_stats(&after);
+    CHECK(after.allocs == before.allocs);
+    CHECK(slot_holds(image, IMAGE_SIZE));
+}
+
+static void test_no_heap_allocations(void)
+{
+    host_container_t opts = { .version = 0x010100, .compress = true, .block_size = 16 * 1024 };
+    size_t len;
+    uint8_t *container = build(&opts, &len);
+    served = container;
+    served_len = len;
+
+    httpd_handle_t server;
+    uint16_t port;
+    CHECK_ERR(ESP_OK, host_httpd_start(&server, &port));
+    httpd_uri_t uri = { .uri = "/firmware.bin", .method = HTTP_GET, .handler = firmware_handler };
+    CHECK_ERR(ESP_OK, httpd_register_uri_handler(server, &uri));
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%u/firmware.bin", port);
+
+    run_without_heap(url, 1);
+    run_without_heap(url, 2);       // Segmented: workers and their clients too
+    free(container);
+}
+
+static void test_no_unerased_writes(void)
+{
+    host_flash_stats_t stats;
+    host_flash_get_stats(&stats);
+    CHECK(stats.unerased_writes == 0);
+}
+
+int main(void)
+{
+    running = host_partition_create("ota_0", 0x10000, SLOT_SIZE, NULL);
+    next = host_partition_create("ota_1", 0x10000 + SLOT_SIZE, SLOT_SIZE, NULL);
+    host_partition_set_slots(running, next);
+
+    // The new image differs from the running one in a few sectors only
+    base = host_image_app(IMAGE_SIZE, "1.0.0", 7);
+    image = malloc(IMAGE_SIZE);
+    memcpy(image, base, IMAGE_SIZE);
+    uint8_t *other = host_image_app(IMAGE_SIZE, "1.1.0", 8);
+    memcpy(image, other, 4096);             // Headers and app description
+    memcpy(image + 40 * 1024, other + 40 * 1024, 12 * 1024);
+    memcpy(image + IMAGE_SIZE - 3000, other + IMAGE_SIZE - 3000, 3000);
+    free(other);
+    esp_partition_write(running, 0, base, IMAGE_SIZE);
+    CHECK_ERR(ESP_OK, ota_arena_init());
+
+    RUN_TEST(test_raw);
+    RUN_TEST(test_header);
+    RUN_TEST(test_compressed);
+    RUN_TEST(test_delta);
+    RUN_TEST(test_delta_wrong_base);
+    RUN_TEST(test_blocks);
+    RUN_TEST(test_corrupt_block_refetched);
+    RUN_TEST(test_corrupt_blocks_retried_separately);
+    RUN_TEST(test_corrupt_without_blocks);
+    RUN_TEST(test_connection_drop_resumes);
+    RUN_TEST(test_drop_without_range_fails);
+    RUN_TEST(test_truncated);
+    RUN_TEST(test_min_version);
+    RUN_TEST(test_cancel);
+    RUN_TEST(test_skip_unchanged);
+    RUN_TEST(test_upload);
+    RUN_TEST(test_no_heap_allocations);
+    RUN_TEST(test_no_unerased_writes);
+
+    free(image);
+    free(base);
+    host_partition_delete(next);
+    host_partition_delete(running);
+    return TEST_EXIT();
+}
@@ -0,0 +1,272 @@
+// ota_events.c: snapshots coalesced within a phase, and GET /ota/events over
+// 127.0.0.1 delivering them in order, capped at OTA_EVENTS_MAX_SUBSCRIBERS,
+// with a client that stops reading dropped without ever blocking publish
+
+#include "host_test.h"
+#include "host_stubs.h"
+#include "esp_http_client.h"
+#include "esp_timer.h"
+#include "ota_events.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static char url[64];
+static uint16_t port;
+
+// One open GET /ota/events, read with the HTTP client
+typedef struct {
+    esp_http_client_handle_t client;
+    int status;
+    char buf[512];
+    int len;
+} stream_t;
+
+typedef struct {
+    uint32_t seq;
+    char phase[16];
+    int bytes;
+} received_t;
+
+static void publish(ota_phase_t phase, int bytes)
+{
+    ota_event_t event = { .phase = phase, .bytes = bytes, .total = 1000, .error = ESP_OK };
+    ota_events_publish(&event);
+}
+
+static void stream_open(stream_t *stream)
+{
+    memset(stream, 0, sizeof(*stream));
+    esp_http_client_config_t config = { .url = url, .timeout_ms = 3000 };
+    stream->client = esp_http_client_init(&config);
+    CHECK_ERR(ESP_OK, esp_http_client_open(stream->client, 0));
+    esp_http_client_fetch_headers(stream->client);
+    stream->status = esp_http_client_get_status_code(stream->client);
+}
+
+static void stream_close(stream_t *stream)
+{
+    esp_http_client_cleanup(stream->client);
+}
+
+// Next "data: {...}\n\n" event, skipping keepalive comments
+static bool stream_next(stream_t *stream, received_t *event)
+{
+    for (;;) {
+        char *end = memmem(stream->buf, stream->len, "\n\n", 2);
+        if (end != NULL) {
+            *end = '\0';
+            bool parsed = sscanf(stream->buf, "data: {\"seq\":%u,\"phase\":\"%15[^\"]\",\"bytes\":%d",
+                                 &event->seq, event->phase, &event->bytes) == 3;
+            stream->len -= end + 2 - stream->buf;
+            memmove(stream->buf, end + 2, stream->len);
+            if (parsed) {
+                return true;
+            }
+            continue;
+        }
+        int n = esp_http_client_read(stream->client, stream->buf + stream->len, sizeof(stream->buf) - stream->len);
+        if (n <= 0) {
+            return false;
+        }
+        stream->len += n;
+    }
+}
+
+// Reads the stream until seq, checking that sequence numbers only go up
+static bool stream_until(stream_t *stream, uint32_t seq, received_t *last)
+{
+    uint32_t prev = 0;
+    while (stream_next(stream, last)) {
+        if (last->seq <= prev) {
+            return false;
+        }
+        prev = last->seq;
+        if (last->seq == seq) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint32_t latest_seq(void)
+{
+    ota_event_t event;
+    ota_events_get(&event);
+    return event.seq;
+}
+
+// GET /ota/events on a raw socket that stops reading after the status line
+static int stalled_stream(void)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int rcvbuf = 2048;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    CHECK(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    const char *req = "GET /ota/events HTTP/1.1\r\nHost: portal\r\n\r\n";
+    CHECK(send(fd, req, strlen(req), 0) == (ssize_t)strlen(req));
+    char status[13] = "";
+    CHECK(recv(fd, status, sizeof(status) - 1, MSG_WAITALL) == sizeof(status) - 1);
+    CHECK(strcmp(status, "HTTP/1.1 200") == 0);
+    return fd;
+}
+
+// A subscriber only notices a closed client when a send fails; the first
+// send after the close still succeeds, the next one gets the reset
+static void drop_closed_streams(void)
+{
+    for (int i = 0; i < 3; i++) {
+        publish(i % 2 ? OTA_PHASE_IDLE : OTA_PHASE_QUEUED, 0);
+        usleep(20 * 1000);
+    }
+}
+
+static void test_coalescing(void)
+{
+    publish(OTA_PHASE_DOWNLOADING, 100);
+    uint32_t seq = latest_seq();
+
+    // Progress within the interval is dropped, a phase change never is
+    publish(OTA_PHASE_DOWNLOADING, 200);
+    ota_event_t event;
+    ota_events_get(&event);
+    CHECK(event.seq == seq && event.bytes == 100);
+    publish(OTA_PHASE_VERIFYING, 1000);
+    ota_events_get(&event);
+    CHECK(event.seq == seq + 1 && event.phase == OTA_PHASE_VERIFYING);
+
+    // So is a new error in the same phase
+    ota_event_t failed = { .phase = OTA_PHASE_VERIFYING, .error = ESP_FAIL };
+    ota_events_publish(&failed);
+    ota_events_get(&event);
+    CHECK(event.seq == seq + 2 && event.error == ESP_FAIL);
+
+    usleep((OTA_EVENTS_MIN_INTERVAL_MS + 20) * 1000);
+    ota_event_t progress = { .phase = OTA_PHASE_VERIFYING, .bytes = 500, .total = 1000, .rate = 100,
+                             .error = ESP_FAIL };
+    ota_events_publish(&progress);
+    ota_events_get(&event);
+    CHECK(event.seq == seq + 3 && event.bytes == 500);
+    CHECK(event.eta == 5);
+}
+
+static void test_stream_order(void)
+{
+    stream_t stream;
+    stream_open(&stream);
+    CHECK(stream.status == 200);
+
+    // The current state first
+    received_t event;
+    CHECK(stream_next(&stream, &event));
+    CHECK(event.seq == latest_seq());
+
+    // Each phase as it happens
+    const ota_phase_t phases[] = { OTA_PHASE_QUEUED, OTA_PHASE_CONNECTING, OTA_PHASE_DOWNLOADING,
+                                   OTA_PHASE_VERIFYING, OTA_PHASE_SCHEDULED };
+    for (int i = 0; i < sizeof(phases) / sizeof(phases[0]); i++) {
+        publish(phases[i], 0);
+        CHECK(stream_next(&stream, &event));
+        CHECK(event.seq == latest_seq());
+        CHECK(strcmp(event.phase, ota_phase_name(phases[i])) == 0);
+    }
+
+    // A burst may be coalesced but arrives in order and ends on the latest
+    for (int i = 0; i < 50; i++) {
+        publish(i % 2 ? OTA_PHASE_DOWNLOADING : OTA_PHASE_CONNECTING, i);
+    }
+    CHECK(stream_until(&stream, latest_seq(), &event));
+    CHECK(strcmp(event.phase, "downloading") == 0 && event.bytes == 49);
+    stream_close(&stream);
+}
+
+static void test_subscriber_limit(void)
+{
+    stream_t streams[OTA_EVENTS_MAX_SUBSCRIBERS];
+    received_t event;
+    for (int round = 0; round < 2; round++) {
+        // The second round only gets in if the first one's slots were released
+        drop_closed_streams();
+        for (int i = 0; i < OTA_EVENTS_MAX_SUBSCRIBERS; i++) {
+            stream_open(&streams[i]);
+            CHECK(streams[i].status == 200);
+            CHECK(stream_next(&streams[i], &event));
+        }
+
+        stream_t extra;
+        stream_open(&extra);
+        CHECK(extra.status == 503);
+        stream_close(&extra);
+
+        for (int i = 0; i < OTA_EVENTS_MAX_SUBSCRIBERS; i++) {
+            stream_close(&streams[i]);
+        }
+    }
+    drop_closed_streams();
+}
+
+static void test_slow_subscriber_dropped(void)
+{
+    stream_t live[OTA_EVENTS_MAX_SUBSCRIBERS];
+    int live_count = OTA_EVENTS_MAX_SUBSCRIBERS - 1;
+    received_t event;
+    for (int i = 0; i < live_count; i++) {
+        stream_open(&live[i]);
+        CHECK(stream_next(&live[i], &event));
+    }
+    int stalled = stalled_stream();
+
+    // Keep publishing into the stalled socket until its send times out and
+    // the slot is taken by a new stream; publish never waits for it
+    int64_t worst_us = 0;
+    int64_t end_us = esp_timer_get_time() + 10 * 1000 * 1000;
+    for (int i = 0; live_count < OTA_EVENTS_MAX_SUBSCRIBERS && esp_timer_get_time() < end_us; i++) {
+        int64_t start_us = esp_timer_get_time();
+        publish(i % 2 ? OTA_PHASE_DOWNLOADING : OTA_PHASE_CONNECTING, i);
+        int64_t took_us = esp_timer_get_time() - start_us;
+        if (took_us > worst_us) {
+            worst_us = took_us;
+        }
+
+        // The others keep up meanwhile
+        for (int j = 0; j < live_count; j++) {
+            CHECK(stream_until(&live[j], latest_seq(), &event));
+        }
+        if (i % 100 == 99) {
+            stream_open(&live[live_count]);
+            if (live[live_count].status == 200) {
+                live_count++;
+            } else {
+                stream_close(&live[live_count]);
+            }
+        }
+    }
+    CHECK(live_count == OTA_EVENTS_MAX_SUBSCRIBERS);
+    CHECK(worst_us < 50 * 1000);
+
+    close(stalled);
+    for (int i = 0; i < live_count; i++) {
+        stream_close(&live[i]);
+    }
+}
+
+int main(void)
+{
+    httpd_handle_t server;
+    CHECK_ERR(ESP_OK, host_httpd_start(&server, &port));
+    CHECK_ERR(ESP_OK, ota_events_register_handlers(server));
+    snprintf(url, sizeof(url), "http://127.0.0.1:%u/ota/events", port);
+
+    RUN_TEST(test_coalescing);
+    RUN_TEST(test_stream_order);
+    RUN_TEST(test_subscriber_limit);
+    RUN_TEST(test_slow_subscriber_dropped);
+    return TEST_EXIT();
+}
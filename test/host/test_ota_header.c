@@ -0,0 +1,109 @@
+// ota_header parsing and the ota_image checks on the first bytes of an image
+
+#include "host_test.h"
+#include "host_image.h"
+#include "host_stubs.h"
+#include "ota_header.h"
+#include "ota_image.h"
+#include <stdlib.h>
+
+#define IMAGE_SIZE 4096
+
+static esp_partition_t *running;
+
+static void test_header_parse(void)
+{
+    uint8_t *image = host_image_app(IMAGE_SIZE, "2.3.4", 1);
+    host_container_t opts = { .version = 0x020304, .compress = true, .block_size = 4096 };
+    size_t len;
+    uint8_t *container = host_container_build(image, IMAGE_SIZE, &opts, &len);
+
+    ota_header_t header;
+    CHECK(ota_header_parse(container, &header));
+    CHECK(header.size == IMAGE_SIZE);
+    CHECK(OTA_HEADER_VERSION(&header) == 0x020304);
+    CHECK(OTA_HEADER_FLAGS(&header) == (OTA_HEADER_FLAG_DEFLATE | OTA_HEADER_FLAG_BLOCKS));
+    CHECK(!ota_header_parse(image, &header));
+
+    free(container);
+    free(image);
+}
+
+static void test_version_from_string(void)
+{
+    CHECK(ota_header_version_from_string("1.2.3") == 0x010203);
+    CHECK(ota_header_version_from_string("v10.0.1") == 0x0a0001);
+    CHECK(ota_header_version_from_string("2.1") == 0x020100);
+    CHECK(ota_header_version_from_string("nightly") == 0);
+}
+
+static void test_image_accepted(void)
+{
+    uint8_t *image = host_image_app(IMAGE_SIZE, "1.2.0", 2);
+    CHECK_ERR(ESP_OK, ota_image_check(image, 0));
+    CHECK_ERR(ESP_OK, ota_image_check(image, 0x010200));
+    CHECK_ERR(ESP_ERR_INVALID_VERSION, ota_image_check(image, 0x010201));
+    free(image);
+}
+
+static void test_image_not_an_app(void)
+{
+    uint8_t *image = host_image_app(IMAGE_SIZE, "1.2.0", 2);
+    image[0] = 0;
+    CHECK_ERR(ESP_ERR_OTA_VALIDATE_FAILED, ota_image_check(image, 0));
+    free(image);
+}
+
+static void test_image_other_chip(void)
+{
+    uint8_t *image = host_image_app(IMAGE_SIZE, "1.2.0", 2);
+    esp_image_header_t *header = (esp_image_header_t *)image;
+    header->chip_id = ESP_CHIP_ID_ESP32S3;
+    CHECK_ERR(ESP_ERR_OTA_VALIDATE_FAILED, ota_image_check(image, 0));
+    free(image);
+}
+
+static void test_image_chip_revision(void)
+{
+    uint8_t *image = host_image_app(IMAGE_SIZE, "1.2.0", 2);
+    esp_image_header_t *header = (esp_image_header_t *)image;
+    header->min_chip_rev_full = 301;
+    CHECK_ERR(ESP_ERR_OTA_VALIDATE_FAILED, ota_image_check(image, 0));
+    header->min_chip_rev_full = 0;
+    header->max_chip_rev_full = 199;
+    CHECK_ERR(ESP_ERR_OTA_VALIDATE_FAILED, ota_image_check(image, 0));
+    header->max_chip_rev_full = 0;      // Older IDF: no upper bound
+    CHECK_ERR(ESP_OK, ota_image_check(image, 0));
+    free(image);
+}
+
+static void test_image_other_project(void)
+{
+    uint8_t *image = host_image_app(IMAGE_SIZE, "1.2.0", 2);
+    esp_app_desc_t *desc = (esp_app_desc_t *)(image + sizeof(esp_image_header_t) +
+                                              sizeof(esp_image_segment_header_t));
+    strcpy(desc->project_name, "someone-else");
+    CHECK_ERR(ESP_ERR_OTA_VALIDATE_FAILED, ota_image_check(image, 0));
+    free(image);
+}
+
+int main(void)
+{
+    // The chip id is compared with the running image's header
+    running = host_partition_create("factory", 0x10000, 64 * 1024, NULL);
+    uint8_t *image = host_image_app(IMAGE_SIZE, "1.0.0", 5);
+    esp_partition_write(running, 0, image, IMAGE_SIZE);
+    free(image);
+    host_partition_set_slots(running, NULL);
+
+    RUN_TEST(test_header_parse);
+    RUN_TEST(test_version_from_string);
+    RUN_TEST(test_image_accepted);
+    RUN_TEST(test_image_not_an_app);
+    RUN_TEST(test_image_other_chip);
+    RUN_TEST(test_image_chip_revision);
+    RUN_TEST(test_image_other_project);
+
+    host_partition_delete(running);
+    return TEST_EXIT();
+}
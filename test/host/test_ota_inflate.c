@@ -0,0 +1,129 @@
+// ota_inflate: raw deflate with the container's window, fed in arbitrary pieces
+
+#include "host_test.h"
+#include "host_image.h"
+#include "ota_arena.h"
+#include "ota_inflate.h"
+#include <stdlib.h>
+#include <zlib.h>
+
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t cap;
+    size_t max_piece;
+} sink_t;
+
+static esp_err_t collect(const uint8_t *data, size_t len, void *arg)
+{
+    sink_t *sink = arg;
+    if (sink->len + len > sink->cap) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(sink->buf + sink->len, data, len);
+    sink->len += len;
+    if (len > sink->max_piece) {
+        sink->max_piece = len;
+    }
+    return ESP_OK;
+}
+
+static uint8_t *deflate_raw(const uint8_t *data, size_t len, int window_bits, size_t *out_len)
+{
+    z_stream z = {0};
+    deflateInit2(&z, 9, Z_DEFLATED, -window_bits, 9, Z_DEFAULT_STRATEGY);
+    size_t cap = deflateBound(&z, len);
+    uint8_t *out = malloc(cap);
+    z.next_in = (Bytef *)data;
+    z.avail_in = len;
+    z.next_out = out;
+    z.avail_out = cap;
+    deflate(&z, Z_FINISH);
+    *out_len = cap - z.avail_out;
+    deflateEnd(&z);
+    return out;
+}
+
+static void roundtrip(size_t piece)
+{
+    const size_t size = 100 * 1024 + 123;
+    uint8_t *image = host_image_app(size, "1.0.0", 7);
+    size_t packed_len;
+    uint8_t *packed = deflate_raw(image, size, OTA_INFLATE_WINDOW_BITS, &packed_len);
+
+    ota_arena_reset();
+    sink_t sink = { .buf = malloc(size), .cap = size };
+    ota_inflate_t *inf = ota_inflate_create(collect, &sink);
+    CHECK(inf != NULL);
+
+    esp_err_t err = ESP_OK;
+    for (size_t pos = 0; pos < packed_len && err == ESP_OK; pos += piece) {
+        size_t n = packed_len - pos < piece ? packed_len - pos : piece;
+        err = ota_inflate_feed(inf, packed + pos, n);
+    }
+    CHECK_ERR(ESP_OK, err);
+    CHECK(ota_inflate_done(inf));
+    CHECK(sink.len == size);
+    CHECK(memcmp(sink.buf, image, size) == 0);
+    CHECK(sink.max_piece <= OTA_INFLATE_WINDOW_SIZE);
+
+    free(sink.buf);
+    free(packed);
+    free(image);
+}
+
+static void test_inflate_whole_buffer(void)
+{
+    roundtrip(1 << 20);
+}
+
+static void test_inflate_byte_by_byte(void)
+{
+    roundtrip(1);
+}
+
+static void test_inflate_network_sized_pieces(void)
+{
+    roundtrip(1024);
+    roundtrip(1460);
+}
+
+static void test_inflate_rejects_corrupt_stream(void)
+{
+    const uint8_t garbage[] = { 0xff, 0xff, 0xff, 0xff, 0x00, 0x12 };
+    uint8_t out[16];
+    sink_t sink = { .buf = out, .cap = sizeof(out) };
+
+    ota_arena_reset();
+    ota_inflate_t *inf = ota_inflate_create(collect, &sink);
+    CHECK_ERR(ESP_ERR_INVALID_RESPONSE, ota_inflate_feed(inf, garbage, sizeof(garbage)));
+    CHECK(!ota_inflate_done(inf));
+}
+
+static void test_inflate_stops_on_callback_error(void)
+{
+    const size_t size = 64 * 1024;
+    uint8_t *image = host_image_app(size, "1.0.0", 8);
+    size_t packed_len;
+    uint8_t *packed = deflate_raw(image, size, OTA_INFLATE_WINDOW_BITS, &packed_len);
+    sink_t sink = { .buf = malloc(1000), .cap = 1000 };
+
+    ota_arena_reset();
+    ota_inflate_t *inf = ota_inflate_create(collect, &sink);
+    CHECK_ERR(ESP_ERR_INVALID_SIZE, ota_inflate_feed(inf, packed, packed_len));
+
+    free(sink.buf);
+    free(packed);
+    free(image);
+}
+
+int main(void)
+{
+    ota_arena_init();
+    RUN_TEST(test_inflate_whole_buffer);
+    RUN_TEST(test_inflate_byte_by_byte);
+    RUN_TEST(test_inflate_network_sized_pieces);
+    RUN_TEST(test_inflate_rejects_corrupt_stream);
+    RUN_TEST(test_inflate_stops_on_callback_error);
+    return TEST_EXIT();
+}
@@ -0,0 +1,330 @@
+// ota_peer.c serving the running slot at /firmware.bin over 127.0.0.1, and
+// the engine updating the other slot from it through the HTTP transport:
+// raw header + image, Range, ETag / If-None-Match, and the 503 client cap
+
+#include "host_test.h"
+#include "host_image.h"
+#include "host_stubs.h"
+#include "esp_http_client.h"
+#include "esp_timer.h"
+#include "mbedtls/sha256.h"
+#include "ota_arena.h"
+#include "ota_engine.h"
+#include "ota_header.h"
+#include "ota_peer.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define SLOT_SIZE   (512 * 1024)
+#define IMAGE_SIZE  (192 * 1024)    // Multiple of 16: segments end where the checksum padding does
+#define TOTAL       (OTA_HEADER_SIZE + IMAGE_SIZE)
+
+static esp_partition_t *running;
+static esp_partition_t *next;
+static uint8_t *image;
+static uint8_t sha[32];
+static char url[64];
+static uint16_t port;
+
+typedef struct {
+    int status;
+    int64_t content_length;
+    uint8_t *body;
+    int body_len;
+    char etag[80];
+    char content_range[64];
+    char retry_after[16];
+} response_t;
+
+static esp_err_t on_header(esp_http_client_event_t *evt)
+{
+    response_t *resp = evt->user_data;
+    if (evt->event_id != HTTP_EVENT_ON_HEADER) {
+        return ESP_OK;
+    }
+    if (strcasecmp(evt->header_key, "ETag") == 0) {
+        snprintf(resp->etag, sizeof(resp->etag), "%s", evt->header_value);
+    } else if (strcasecmp(evt->header_key, "Content-Range") == 0) {
+        snprintf(resp->content_range, sizeof(resp->content_range), "%s", evt->header_value);
+    } else if (strcasecmp(evt->header_key, "Retry-After") == 0) {
+        snprintf(resp->retry_after, sizeof(resp->retry_after), "%s", evt->header_value);
+    }
+    return ESP_OK;
+}
+
+// GET /firmware.bin, whole body in resp->body (free it)
+static void fetch_once(const char *range, const char *if_none_match, response_t *resp)
+{
+    memset(resp, 0, sizeof(*resp));
+    esp_http_client_config_t config = {
+        .url = url,
+        .timeout_ms = 5000,
+        .event_handler = on_header,
+        .user_data = resp,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (range) {
+        esp_http_client_set_header(client, "Range", range);
+    }
+    if (if_none_match) {
+        esp_http_client_set_header(client, "If-None-Match", if_none_match);
+    }
+    CHECK_ERR(ESP_OK, esp_http_client_open(client, 0));
+    resp->content_length = esp_http_client_fetch_headers(client);
+    resp->status = esp_http_client_get_status_code(client);
+    resp->body = malloc(TOTAL + 1);
+    int n;
+    while ((n = esp_http_client_read(client, (char *)resp->body + resp->body_len, TOTAL + 1 - resp->body_len)) > 0) {
+        resp->body_len += n;
+    }
+    esp_http_client_cleanup(client);
+}
+
+// A download frees its slot just after the last byte went out, so a request
+// sent right behind it can still find every slot taken: retry the busy 503
+static void fetch(const char *range, const char *if_none_match, response_t *resp)
+{
+    int64_t end_us = esp_timer_get_time() + 2000 * 1000;
+    fetch_once(range, if_none_match, resp);
+    while (resp->status == 503 && resp->retry_after[0] != '\0' && esp_timer_get_time() < end_us) {
+        free(resp->body);
+        usleep(1000);
+        fetch_once(range, if_none_match, resp);
+    }
+}
+
+// What the peer should send: the container header, then the image
+static uint8_t expected_at(uint32_t offset)
+{
+    static ota_header_t header;
+    if (header.magic == 0) {
+        header.magic = OTA_HEADER_MAGIC;
+        header.version = ota_header_version_from_string(host_app_desc()->version);
+        header.size = IMAGE_SIZE;
+        memcpy(header.sha256, sha, sizeof(sha));
+    }
+    return offset < OTA_HEADER_SIZE ? ((uint8_t *)&header)[offset] : image[offset - OTA_HEADER_SIZE];
+}
+
+static bool body_is(const response_t *resp, uint32_t first, uint32_t len)
+{
+    if (resp->body_len != len) {
+        return false;
+    }
+    for (uint32_t i = 0; i < len; i++) {
+        if (resp->body[i] != expected_at(first + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool slot_holds_image(void)
+{
+    uint8_t *buf = malloc(IMAGE_SIZE);
+    bool same = esp_partition_read(next, 0, buf, IMAGE_SIZE) == ESP_OK && memcmp(buf, image, IMAGE_SIZE) == 0;
+    free(buf);
+    return same;
+}
+
+// A GET that takes a peer slot and then stops reading: the peer task blocks in
+// send once the socket buffers are full, until the socket is closed
+static int stalled_download(void)
+{
+    int64_t end_us = esp_timer_get_time() + 2000 * 1000;
+    char status[13] = "";
+    int fd;
+    do {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        int rcvbuf = 4096;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+        struct sockaddr_in addr = {
+            .sin_family = AF_INET,
+            .sin_port = htons(port),
+            .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+        };
+        CHECK(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+        const char *req = "GET /firmware.bin HTTP/1.1\r\nHost: peer\r\n\r\n";
+        CHECK(send(fd, req, strlen(req), 0) == (ssize_t)strlen(req));
+
+        // A slot freed late by the previous download answers 503; ask again
+        if (recv(fd, status, sizeof(status) - 1, MSG_WAITALL) == sizeof(status) - 1 &&
+            strcmp(status, "HTTP/1.1 200") == 0) {
+            return fd;
+        }
+        close(fd);
+        usleep(1000);
+    } while (esp_timer_get_time() < end_us);
+    CHECK(strcmp(status, "HTTP/1.1 200") == 0);
+    return -1;
+}
+
+static void test_not_validated(void)
+{
+    // An image on probation may still roll back, it is not handed out
+    host_ota_set_running_state(ESP_OTA_IMG_PENDING_VERIFY);
+    response_t resp;
+    fetch(NULL, NULL, &resp);
+    CHECK(resp.status == 503);
+    free(resp.body);
+    host_ota_set_running_state(ESP_OTA_IMG_VALID);
+}
+
+static void test_full_image(void)
+{
+    response_t resp;
+    fetch(NULL, NULL, &resp);
+    CHECK(resp.status == 200);
+    CHECK(resp.content_length == TOTAL);
+    CHECK(body_is(&resp, 0, TOTAL));
+
+    // ETag is the quoted hex digest that is also in the header
+    char etag[67] = "\"";
+    for (int i = 0; i < 32; i++) {
+        sprintf(etag + 1 + 2 * i, "%02x", sha[i]);
+    }
+    strcat(etag, "\"");
+    CHECK(strcmp(resp.etag, etag) == 0);
+    free(resp.body);
+}
+
+static void test_ranges(void)
+{
+    response_t resp;
+    fetch("bytes=1000-1999", NULL, &resp);
+    CHECK(resp.status == 206);
+    CHECK(resp.content_length == 1000);
+    CHECK(body_is(&resp, 1000, 1000));
+    char expected[64];
+    snprintf(expected, sizeof(expected), "bytes 1000-1999/%d", TOTAL);
+    CHECK(strcmp(resp.content_range, expected) == 0);
+    free(resp.body);
+
+    // Across the end of the reconstructed header
+    fetch("bytes=30-99", NULL, &resp);
+    CHECK(resp.status == 206);
+    CHECK(body_is(&resp, 30, 70));
+    free(resp.body);
+
+    // Open-ended, and a last byte past the end, both run to the end
+    fetch("bytes=150000-", NULL, &resp);
+    CHECK(resp.status == 206);
+    CHECK(body_is(&resp, 150000, TOTAL - 150000));
+    free(resp.body);
+    fetch("bytes=150000-999999", NULL, &resp);
+    CHECK(body_is(&resp, 150000, TOTAL - 150000));
+    free(resp.body);
+
+    char beyond[32];
+    snprintf(beyond, sizeof(beyond), "bytes=%d-", TOTAL);
+    fetch(beyond, NULL, &resp);
+    CHECK(resp.status == 416);
+    CHECK(resp.body_len == 0);
+    free(resp.body);
+}
+
+static void test_if_none_match(void)
+{
+    response_t first;
+    fetch(NULL, NULL, &first);
+
+    response_t resp;
+    fetch(NULL, first.etag, &resp);
+    CHECK(resp.status == 304);
+    CHECK(resp.body_len == 0);
+    CHECK(strcmp(resp.etag, first.etag) == 0);
+    free(resp.body);
+
+    fetch(NULL, "\"0000\"", &resp);
+    CHECK(resp.status == 200);
+    CHECK(resp.body_len == TOTAL);
+    free(resp.body);
+    free(first.body);
+}
+
+static void test_busy(void)
+{
+    int stalled[OTA_PEER_MAX_CLIENTS];
+    for (int i = 0; i < OTA_PEER_MAX_CLIENTS; i++) {
+        stalled[i] = stalled_download();
+    }
+
+    response_t resp;
+    fetch_once(NULL, NULL, &resp);
+    CHECK(resp.status == 503);
+    CHECK(strcmp(resp.retry_after, "30") == 0);
+    free(resp.body);
+
+    // The stalled downloads fail on the closed sockets and free their slots
+    for (int i = 0; i < OTA_PEER_MAX_CLIENTS; i++) {
+        close(stalled[i]);
+    }
+    fetch(NULL, NULL, &resp);
+    CHECK(resp.status == 200);
+    free(resp.body);
+}
+
+static void test_engine_update(void)
+{
+    ota_transport_t transport;
+    CHECK_ERR(ESP_OK, ota_transport_http_init(&transport, url));
+    ota_update_config_t config = OTA_UPDATE_CONFIG_DEFAULT();
+    config.connections = 1;
+    esp_partition_erase_range(next, 0, SLOT_SIZE);
+    ota_arena_reset();
+    CHECK_ERR(ESP_OK, ota_engine_run(&transport, &config, next));
+    ota_transport_http_deinit(&transport);
+    CHECK(slot_holds_image());
+}
+
+static void test_engine_update_segmented(void)
+{
+    // One Range connection per peer slot
+    ota_transport_t transport;
+    CHECK_ERR(ESP_OK, ota_transport_http_init(&transport, url));
+    ota_update_config_t config = OTA_UPDATE_CONFIG_DEFAULT();
+    config.connections = OTA_PEER_MAX_CLIENTS;
+    esp_partition_erase_range(next, 0, SLOT_SIZE);
+    ota_arena_reset();
+    CHECK_ERR(ESP_OK, ota_engine_run(&transport, &config, next));
+    ota_transport_http_deinit(&transport);
+    CHECK(slot_holds_image());
+}
+
+int main(void)
+{
+    running = host_partition_create("ota_0", 0x10000, SLOT_SIZE, NULL);
+    next = host_partition_create("ota_1", 0x10000 + SLOT_SIZE, SLOT_SIZE, NULL);
+    host_partition_set_slots(running, next);
+
+    // One segment that ends 16 bytes short: checksum byte + padding, no appended hash
+    image = host_image_app(IMAGE_SIZE, host_app_desc()->version, 3);
+    esp_image_segment_header_t segment = { .load_addr = 0x3f400020,
+                                           .data_len = IMAGE_SIZE - sizeof(esp_image_header_t) -
+                                                       sizeof(segment) - 16 };
+    memcpy(image + sizeof(esp_image_header_t), &segment, sizeof(segment));
+    esp_partition_write(running, 0, image, IMAGE_SIZE);
+    mbedtls_sha256(image, IMAGE_SIZE, sha, 0);
+
+    CHECK_ERR(ESP_OK, ota_arena_init());
+    httpd_handle_t server;
+    CHECK_ERR(ESP_OK, host_httpd_start(&server, &port));
+    CHECK_ERR(ESP_OK, ota_peer_register_handlers(server));
+    snprintf(url, sizeof(url), "http://127.0.0.1:%u/firmware.bin", port);
+
+    RUN_TEST(test_not_validated);
+    RUN_TEST(test_full_image);
+    RUN_TEST(test_ranges);
+    RUN_TEST(test_if_none_match);
+    RUN_TEST(test_busy);
+    RUN_TEST(test_engine_update);
+    RUN_TEST(test_engine_update_segmented);
+
+    free(image);
+    host_partition_delete(next);
+    host_partition_delete(running);
+    return TEST_EXIT();
+}
@@ -0,0 +1,89 @@
+// ota_ring: ordering and back-pressure between a producer and a consumer thread
+
+#include "host_test.h"
+#include "ota_arena.h"
+#include "ota_manager.h"
+#include "ota_ring.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#define SLOT_SIZE   64
+#define SLOT_COUNT  3
+#define SLOTS_SENT  500
+
+typedef struct {
+    ota_ring_t *ring;
+    int slots_seen;
+    int bytes_seen;
+    int order_errors;
+    SemaphoreHandle_t done;
+} consumer_t;
+
+static void consumer_task(void *arg)
+{
+    consumer_t *c = arg;
+    while (1) {
+        size_t len;
+        const uint8_t *data = ota_ring_peek(c->ring, &len);
+        if (len == 0) {
+            ota_ring_release(c->ring);
+            break;
+        }
+        // Slot n carries n % 251 in every byte and n % SLOT_SIZE + 1 bytes
+        if (len != (size_t)(c->slots_seen % SLOT_SIZE + 1) || data[0] != c->slots_seen % 251 ||
+            data[len - 1] != c->slots_seen % 251) {
+            c->order_errors++;
+        }
+        c->slots_seen++;
+        c->bytes_seen += len;
+        if (c->slots_seen % 7 == 0) {
+            vTaskDelay(1);      // Slow consumer: the producer must wait, not overwrite
+        }
+        ota_ring_release(c->ring);
+    }
+    xSemaphoreGive(c->done);
+    vTaskDelete(NULL);
+}
+
+static void test_ring_preserves_order(void)
+{
+    ota_arena_reset();
+    consumer_t c = { .done = xSemaphoreCreateBinary() };
+    c.ring = ota_ring_create(SLOT_SIZE, SLOT_COUNT);
+    CHECK(c.ring != NULL);
+    CHECK(ota_ring_slot_size(c.ring) == SLOT_SIZE);
+    CHECK(xTaskCreate(consumer_task, "consumer", 4096, &c, 5, NULL) == pdPASS);
+
+    int bytes_sent = 0;
+    for (int n = 0; n < SLOTS_SENT; n++) {
+        uint8_t *slot = ota_ring_acquire(c.ring);
+        size_t len = n % SLOT_SIZE + 1;
+        memset(slot, n % 251, len);
+        ota_ring_commit(c.ring, len);
+        bytes_sent += len;
+    }
+    ota_ring_acquire(c.ring);
+    ota_ring_commit(c.ring, 0);
+
+    CHECK(xSemaphoreTake(c.done, pdMS_TO_TICKS(5000)) == pdTRUE);
+    CHECK(c.slots_seen == SLOTS_SENT);
+    CHECK(c.bytes_seen == bytes_sent);
+    CHECK(c.order_errors == 0);
+    ota_ring_delete(c.ring);
+    vSemaphoreDelete(c.done);
+}
+
+static void test_ring_create_fails_without_budget(void)
+{
+    ota_arena_reset();
+    CHECK(ota_ring_create(OTA_ARENA_SIZE, 2) == NULL);
+}
+
+int main(void)
+{
+    ota_arena_init();
+    RUN_TEST(test_ring_preserves_order);
+    RUN_TEST(test_ring_create_fails_without_budget);
+    return TEST_EXIT();
+}
@@ -0,0 +1,85 @@
+// ota_throttle_take() against a fake clock: a reader that sleeps whatever
+// the bucket asks for must average the configured rate
+
+#include "host_test.h"
+#include "ota_throttle.h"
+
+#define RATE   (32 * 1024)
+#define BURST  (8 * 1024)
+
+static void test_unlimited(void)
+{
+    ota_throttle_t throttle;
+    ota_throttle_init(&throttle, 0, BURST, 0);
+    CHECK(ota_throttle_take(&throttle, 1 << 20, 0) == 0);
+}
+
+static void test_burst_is_free(void)
+{
+    ota_throttle_t throttle;
+    ota_throttle_init(&throttle, RATE, BURST, 1000);
+    CHECK(ota_throttle_take(&throttle, BURST, 1000) == 0);
+    // One byte past the bucket costs one byte's worth of time
+    int64_t wait = ota_throttle_take(&throttle, 1, 1000);
+    CHECK(wait == (1000000 + RATE - 1) / RATE);
+}
+
+static void test_debt_paid_by_waiting(void)
+{
+    ota_throttle_t throttle;
+    ota_throttle_init(&throttle, RATE, BURST, 0);
+    int64_t wait = ota_throttle_take(&throttle, BURST + RATE, 0);
+    CHECK(wait == 1000000);                 // One second of debt
+    CHECK(ota_throttle_take(&throttle, 0, wait) == 0);
+}
+
+static void test_average_rate(void)
+{
+    static const size_t reads[] = { 1024, 100, 4096, 1460, 7, 2048 };
+    ota_throttle_t throttle;
+    int64_t now = 5000000;
+    ota_throttle_init(&throttle, RATE, BURST, now);
+
+    size_t total = 0;
+    for (int i = 0; i < 2000; i++) {
+        size_t len = reads[i % 6];
+        total += len;
+        now += 200;                         // Network time per read
+        now += ota_throttle_take(&throttle, len, now);
+    }
+    // Everything past the initial burst took (total - BURST) / RATE seconds
+    int64_t expected_us = (int64_t)(total - BURST) * 1000000 / RATE;
+    int64_t elapsed_us = now - 5000000;
+    CHECK(elapsed_us >= expected_us);
+    CHECK(elapsed_us <= expected_us + expected_us / 100);
+}
+
+static void test_idle_refills_to_burst_only(void)
+{
+    ota_throttle_t throttle;
+    ota_throttle_init(&throttle, RATE, BURST, 0);
+    ota_throttle_take(&throttle, BURST, 0);
+    // An hour idle must not bank more than one burst
+    int64_t now = 3600LL * 1000000;
+    CHECK(ota_throttle_take(&throttle, BURST, now) == 0);
+    CHECK(ota_throttle_take(&throttle, RATE, now) == 1000000);
+}
+
+static void test_clock_going_backwards(void)
+{
+    ota_throttle_t throttle;
+    ota_throttle_init(&throttle, RATE, BURST, 1000000);
+    CHECK(ota_throttle_take(&throttle, BURST, 500000) == 0);
+    CHECK(ota_throttle_take(&throttle, RATE, 500000) == 1000000);
+}
+
+int main(void)
+{
+    RUN_TEST(test_unlimited);
+    RUN_TEST(test_burst_is_free);
+    RUN_TEST(test_debt_paid_by_waiting);
+    RUN_TEST(test_average_rate);
+    RUN_TEST(test_idle_refills_to_burst_only);
+    RUN_TEST(test_clock_going_backwards);
+    return TEST_EXIT();
+}
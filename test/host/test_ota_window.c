@@ -0,0 +1,70 @@
+// ota_window_contains() over a fake minute-of-day clock
+
+#include "host_test.h"
+#include "ota_window.h"
+
+#define DAY_MIN (24 * 60)
+
+static void test_no_window(void)
+{
+    for (int now = 0; now < DAY_MIN; now += 37) {
+        CHECK(ota_window_contains(-1, -1, now));
+    }
+}
+
+static void test_same_day(void)
+{
+    // 02:00 - 04:30
+    int start = 2 * 60, end = 4 * 60 + 30;
+    int open = 0;
+    for (int now = 0; now < DAY_MIN; now++) {
+        bool inside = ota_window_contains(start, end, now);
+        CHECK(inside == (now >= start && now < end));
+        open += inside;
+    }
+    CHECK(open == end - start);
+    CHECK(ota_window_contains(start, end, start));
+    CHECK(!ota_window_contains(start, end, end));
+}
+
+static void test_wraps_midnight(void)
+{
+    // 23:00 - 01:00
+    int start = 23 * 60, end = 60;
+    int open = 0;
+    for (int now = 0; now < DAY_MIN; now++) {
+        open += ota_window_contains(start, end, now);
+    }
+    CHECK(open == 120);
+    CHECK(ota_window_contains(start, end, DAY_MIN - 1));
+    CHECK(ota_window_contains(start, end, 0));
+    CHECK(!ota_window_contains(start, end, end));
+    CHECK(!ota_window_contains(start, end, start - 1));
+}
+
+static void test_empty_window(void)
+{
+    for (int now = 0; now < DAY_MIN; now++) {
+        CHECK(!ota_window_contains(120, 120, now));
+    }
+}
+
+static void test_whole_day_but_one_minute(void)
+{
+    int open = 0;
+    for (int now = 0; now < DAY_MIN; now++) {
+        open += ota_window_contains(1, 0, now);
+    }
+    CHECK(open == DAY_MIN - 1);
+    CHECK(!ota_window_contains(1, 0, 0));
+}
+
+int main(void)
+{
+    RUN_TEST(test_no_window);
+    RUN_TEST(test_same_day);
+    RUN_TEST(test_wraps_midnight);
+    RUN_TEST(test_empty_window);
+    RUN_TEST(test_whole_day_but_one_minute);
+    return TEST_EXIT();
+}
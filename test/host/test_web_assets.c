@@ -0,0 +1,175 @@
+// web_asset_send() over 127.0.0.1 with ota.html as gzip-asset.py packs it for
+// the firmware: the gzip bytes go out unchanged with Content-Encoding, the
+// ETag is the ELF hash prefix, and a matching If-None-Match gets a bodyless 304
+
+#include "host_test.h"
+#include "host_stubs.h"
+#include "esp_app_desc.h"
+#include "esp_http_client.h"
+#include "web_assets.h"
+#include <stdlib.h>
+#include <strings.h>
+#include <zlib.h>
+
+static uint8_t *page;           // main/www/ota.html
+static size_t page_len;
+static uint8_t *gz;             // What the firmware embeds
+static size_t gz_len;
+static char url[64];
+
+typedef struct {
+    int status;
+    int64_t content_length;
+    uint8_t *body;
+    int body_len;
+    char etag[32];
+    char content_type[32];
+    char content_encoding[16];
+    char cache_control[32];
+} response_t;
+
+static uint8_t *load(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    CHECK(f != NULL);
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    rewind(f);
+    uint8_t *buf = malloc(*len);
+    CHECK(fread(buf, 1, *len, f) == *len);
+    fclose(f);
+    return buf;
+}
+
+static esp_err_t page_handler(httpd_req_t *req)
+{
+    return web_asset_send(req, gz, gz + gz_len, "text/html");
+}
+
+static esp_err_t on_header(esp_http_client_event_t *evt)
+{
+    response_t *resp = evt->user_data;
+    if (evt->event_id != HTTP_EVENT_ON_HEADER) {
+        return ESP_OK;
+    }
+    struct { const char *name; char *dst; size_t size; } fields[] = {
+        { "ETag", resp->etag, sizeof(resp->etag) },
+        { "Content-Type", resp->content_type, sizeof(resp->content_type) },
+        { "Content-Encoding", resp->content_encoding, sizeof(resp->content_encoding) },
+        { "Cache-Control", resp->cache_control, sizeof(resp->cache_control) },
+    };
+    for (int i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        if (strcasecmp(evt->header_key, fields[i].name) == 0) {
+            snprintf(fields[i].dst, fields[i].size, "%s", evt->header_value);
+        }
+    }
+    return ESP_OK;
+}
+
+// GET /ota.html, whole body in resp->body (free it)
+static void fetch(const char *if_none_match, response_t *resp)
+{
+    memset(resp, 0, sizeof(*resp));
+    esp_http_client_config_t config = {
+        .url = url,
+        .timeout_ms = 5000,
+        .event_handler = on_header,
+        .user_data = resp,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (if_none_match) {
+        esp_http_client_set_header(client, "If-None-Match", if_none_match);
+    }
+    CHECK_ERR(ESP_OK, esp_http_client_open(client, 0));
+    resp->content_length = esp_http_client_fetch_headers(client);
+    resp->status = esp_http_client_get_status_code(client);
+    resp->body = malloc(gz_len + 1);
+    int n;
+    while ((n = esp_http_client_read(client, (char *)resp->body + resp->body_len, gz_len + 1 - resp->body_len)) > 0) {
+        resp->body_len += n;
+    }
+    esp_http_client_cleanup(client);
+}
+
+static bool gunzip_is_page(const uint8_t *data, size_t len)
+{
+    uint8_t *out = malloc(page_len + 1);
+    z_stream zs = { .next_in = (Bytef *)data, .avail_in = len, .next_out = out, .avail_out = page_len + 1 };
+    bool same = inflateInit2(&zs, 16 + MAX_WBITS) == Z_OK && inflate(&zs, Z_FINISH) == Z_STREAM_END &&
+                zs.total_out == page_len && memcmp(out, page, page_len) == 0;
+    inflateEnd(&zs);
+    free(out);
+    return same;
+}
+
+static void test_gzip_body(void)
+{
+    response_t resp;
+    fetch(NULL, &resp);
+    CHECK(resp.status == 200);
+    CHECK(resp.content_length == gz_len);
+    CHECK(resp.body_len == gz_len && memcmp(resp.body, gz, gz_len) == 0);
+    CHECK(strcmp(resp.content_encoding, "gzip") == 0);
+    CHECK(strcmp(resp.content_type, "text/html") == 0);
+    CHECK(strcmp(resp.cache_control, WEB_ASSET_CACHE_CONTROL) == 0);
+    CHECK(gunzip_is_page(resp.body, resp.body_len));
+    CHECK(gz_len < page_len);
+    free(resp.body);
+}
+
+static void test_etag_is_build_hash(void)
+{
+    char sha[17];
+    esp_app_get_elf_sha256(sha, sizeof(sha));
+    char expected[20];
+    snprintf(expected, sizeof(expected), "\"%s\"", sha);
+
+    response_t resp;
+    fetch(NULL, &resp);
+    CHECK(strlen(sha) == 16);
+    CHECK(strcmp(resp.etag, expected) == 0);
+    free(resp.body);
+}
+
+static void test_not_modified(void)
+{
+    response_t first;
+    fetch(NULL, &first);
+
+    response_t resp;
+    fetch(first.etag, &resp);
+    CHECK(resp.status == 304);
+    CHECK(resp.body_len == 0);
+    CHECK(strcmp(resp.etag, first.etag) == 0);
+    CHECK(strcmp(resp.cache_control, WEB_ASSET_CACHE_CONTROL) == 0);
+    CHECK(resp.content_encoding[0] == '\0');
+    free(resp.body);
+
+    // A copy from another build is sent again in full
+    fetch("\"0123456789abcdef\"", &resp);
+    CHECK(resp.status == 200);
+    CHECK(resp.body_len == gz_len);
+    free(resp.body);
+    free(first.body);
+}
+
+int main(void)
+{
+    page = load(WEB_ASSET_SRC, &page_len);
+    gz = load(WEB_ASSET_GZ, &gz_len);
+
+    httpd_handle_t server;
+    uint16_t port;
+    CHECK_ERR(ESP_OK, host_httpd_start(&server, &port));
+    httpd_uri_t uri = { .uri = "/ota.html", .method = HTTP_GET, .handler = page_handler };
+    CHECK_ERR(ESP_OK, httpd_register_uri_handler(server, &uri));
+    snprintf(url, sizeof(url), "http://127.0.0.1:%u/ota.html", port);
+
+    RUN_TEST(test_gzip_body);
+    RUN_TEST(test_etag_is_build_hash);
+    RUN_TEST(test_not_modified);
+
+    free(gz);
+    free(page);
+    return TEST_EXIT();
+}
@@ -0,0 +1,275 @@
+// wifi_rank_profiles() on made-up scans: RSSI first, recency as a bonus that
+// halves per newer network, ties in profile order, out-of-range dropped.
+// The retry state machine on event sequences: backoff growth and cap,
+// failover, and dropping the cache only after a failed fast connect.
+
+#include "host_test.h"
+#include "wifi_policy.h"
+
+static wifi_profile_t profile(const char *ssid, uint32_t last_success)
+{
+    wifi_profile_t p = { .last_success = last_success };
+    strcpy(p.ssid, ssid);
+    return p;
+}
+
+static wifi_scan_ap_t ap(const char *ssid, int8_t rssi)
+{
+    wifi_scan_ap_t a = { .rssi = rssi };
+    strcpy(a.ssid, ssid);
+    return a;
+}
+
+static void test_strongest_first(void)
+{
+    wifi_profile_t profiles[] = { profile("home", 0), profile("office", 0), profile("lab", 0) };
+    wifi_scan_ap_t aps[] = { ap("lab", -70), ap("home", -80), ap("office", -50) };
+    uint8_t order[WIFI_MAX_PROFILES];
+    CHECK(wifi_rank_profiles(profiles, 3, aps, 3, order) == 3);
+    CHECK(order[0] == 1);
+    CHECK(order[1] == 2);
+    CHECK(order[2] == 0);
+}
+
+static void test_out_of_range_dropped(void)
+{
+    wifi_profile_t profiles[] = { profile("home", 5), profile("office", 0) };
+    wifi_scan_ap_t aps[] = { ap("neighbour", -30), ap("office", -90) };
+    uint8_t order[WIFI_MAX_PROFILES];
+    CHECK(wifi_rank_profiles(profiles, 2, aps, 2, order) == 1);
+    CHECK(order[0] == 1);
+    CHECK(wifi_rank_profiles(profiles, 2, aps, 0, order) == 0);
+}
+
+static void test_best_bssid_counts(void)
+{
+    // Same SSID on several APs: the strongest one is what the network scores
+    wifi_profile_t profiles[] = { profile("mesh", 0), profile("single", 0) };
+    wifi_scan_ap_t aps[] = { ap("mesh", -85), ap("single", -60), ap("mesh", -55), ap("mesh", -75) };
+    uint8_t order[WIFI_MAX_PROFILES];
+    CHECK(wifi_rank_profiles(profiles, 2, aps, 4, order) == 2);
+    CHECK(order[0] == 0);
+}
+
+static void test_recency_bonus(void)
+{
+    // Most recent gets the full bonus, the one before half of it
+    wifi_profile_t profiles[] = { profile("old", 1), profile("recent", 2), profile("never", 0) };
+    wifi_scan_ap_t aps[] = {
+        ap("old", -60),                                  // -60 + half bonus
+        ap("recent", -60 - WIFI_RECENT_BONUS_DB / 2 + 2), // Full bonus lifts it to the top
+        ap("never", -60 + WIFI_RECENT_BONUS_DB / 2 - 1), // Stronger than "old", no bonus
+    };
+    uint8_t order[WIFI_MAX_PROFILES];
+    CHECK(wifi_rank_profiles(profiles, 3, aps, 3, order) == 3);
+    CHECK(order[0] == 1);
+    CHECK(order[1] == 0);
+    CHECK(order[2] == 2);
+
+    // A much stronger signal still wins over recency
+    aps[1].rssi = -60 - WIFI_RECENT_BONUS_DB - 1;
+    aps[2].rssi = -90;
+    CHECK(wifi_rank_profiles(profiles, 3, aps, 3, order) == 3);
+    CHECK(order[0] == 0);
+    CHECK(order[1] == 1);
+    CHECK(order[2] == 2);
+}
+
+static void test_ties_keep_profile_order(void)
+{
+    wifi_profile_t profiles[] = { profile("a", 0), profile("b", 0), profile("c", 0) };
+    wifi_scan_ap_t aps[] = { ap("c", -60), ap("b", -60), ap("a", -60) };
+    uint8_t order[WIFI_MAX_PROFILES];
+    CHECK(wifi_rank_profiles(profiles, 3, aps, 3, order) == 3);
+    CHECK(order[0] == 0);
+    CHECK(order[1] == 1);
+    CHECK(order[2] == 2);
+
+    // Bonus and RSSI adding up to the same score tie as well
+    profiles[1].last_success = 1;
+    aps[1].rssi = -60 - WIFI_RECENT_BONUS_DB;
+    CHECK(wifi_rank_profiles(profiles, 3, aps, 3, order) == 3);
+    CHECK(order[0] == 0);
+    CHECK(order[1] == 1);
+    CHECK(order[2] == 2);
+}
+
+static void test_full_store(void)
+{
+    wifi_profile_t profiles[WIFI_MAX_PROFILES];
+    wifi_scan_ap_t aps[WIFI_MAX_PROFILES];
+    for (int i = 0; i < WIFI_MAX_PROFILES; i++) {
+        char ssid[8];
+        snprintf(ssid, sizeof(ssid), "net%d", i);
+        profiles[i] = profile(ssid, 0);
+        aps[i] = ap(ssid, -90 + i);
+    }
+    uint8_t order[WIFI_MAX_PROFILES];
+    CHECK(wifi_rank_profiles(profiles, WIFI_MAX_PROFILES, aps, WIFI_MAX_PROFILES, order) == WIFI_MAX_PROFILES);
+    for (int i = 0; i < WIFI_MAX_PROFILES; i++) {
+        CHECK(order[i] == WIFI_MAX_PROFILES - 1 - i);
+    }
+}
+
+static void test_backoff_bounds(void)
+{
+    // Equal jitter: between half and all of the doubled delay
+    for (uint32_t attempt = 0; attempt < 40; attempt++) {
+        uint32_t full = attempt < 16 ? WIFI_BACKOFF_MIN_MS << attempt : WIFI_BACKOFF_MAX_MS;
+        if (full > WIFI_BACKOFF_MAX_MS) {
+            full = WIFI_BACKOFF_MAX_MS;
+        }
+        CHECK(wifi_backoff_ms(attempt, 0) == full / 2);
+        CHECK(wifi_backoff_ms(attempt, full / 2) == full);
+        CHECK(wifi_backoff_ms(attempt, UINT32_MAX) <= full);
+    }
+    CHECK(wifi_backoff_ms(UINT32_MAX, UINT32_MAX) <= WIFI_BACKOFF_MAX_MS);
+}
+
+static void test_disconnect_storm_single_profile(void)
+{
+    wifi_retry_t retry = { 0 };
+    wifi_retry_set_candidates(&retry, 1);
+
+    // Without jitter the delay only grows, up to the cap
+    uint32_t last = 0;
+    for (int i = 0; i < 200; i++) {
+        wifi_retry_action_t action = wifi_retry_on_disconnect(&retry, 1, 0);
+        CHECK(!action.forget_cache);
+        CHECK(!action.failover);
+        CHECK(action.delay_ms >= last);
+        CHECK(action.delay_ms <= WIFI_BACKOFF_MAX_MS);
+        last = action.delay_ms;
+    }
+    CHECK(last == WIFI_BACKOFF_MAX_MS / 2);
+    CHECK(retry.attempt == 200);
+    CHECK(retry.order_pos == 0);
+
+    // One success and the next loss starts from the shortest delay again
+    wifi_retry_on_connected(&retry);
+    wifi_retry_action_t action = wifi_retry_on_disconnect(&retry, 1, 0);
+    CHECK(action.delay_ms == WIFI_BACKOFF_MIN_MS / 2);
+}
+
+static void test_failover_then_rescan(void)
+{
+    wifi_retry_t retry = { 0 };
+    wifi_retry_set_candidates(&retry, 2);
+
+    for (int candidate = 0; candidate < 2; candidate++) {
+        for (int i = 1; i < WIFI_FAILOVER_ATTEMPTS; i++) {
+            CHECK(!wifi_retry_on_disconnect(&retry, 3, 0).failover);
+            CHECK(retry.order_pos == candidate);
+        }
+        CHECK(wifi_retry_on_disconnect(&retry, 3, 0).failover);
+        CHECK(retry.order_pos == candidate + 1);
+    }
+    // List used up: the next attempt scans; backoff kept growing throughout
+    CHECK(retry.order_pos >= retry.order_count);
+    CHECK(retry.attempt == 2 * WIFI_FAILOVER_ATTEMPTS);
+
+    wifi_retry_set_candidates(&retry, 3);
+    CHECK(retry.order_pos == 0);
+    CHECK(wifi_retry_on_disconnect(&retry, 3, 0).delay_ms ==
+          wifi_backoff_ms(2 * WIFI_FAILOVER_ATTEMPTS, 0));
+}
+
+static void test_fast_connect_failure_forgets_cache(void)
+{
+    wifi_retry_t retry = { 0 };
+    retry.fast = true;
+
+    // Cached AP gone: drop the cache, scan right away, no backoff counted
+    wifi_retry_action_t action = wifi_retry_on_disconnect(&retry, 2, UINT32_MAX);
+    CHECK(action.forget_cache);
+    CHECK(!action.failover);
+    CHECK(action.delay_ms == 0);
+    CHECK(!retry.fast);
+    CHECK(retry.attempt == 0);
+    CHECK(retry.profile_failures == 0);
+
+    // Failures after that are ordinary ones; the cache is only dropped once
+    action = wifi_retry_on_disconnect(&retry, 2, 0);
+    CHECK(!action.forget_cache);
+    CHECK(action.delay_ms == WIFI_BACKOFF_MIN_MS / 2);
+    CHECK(retry.attempt == 1);
+}
+
+static void test_fast_connect_success_keeps_cache(void)
+{
+    wifi_retry_t retry = { 0 };
+    retry.fast = true;
+    wifi_retry_on_connected(&retry);
+    CHECK(!retry.fast);
+
+    // Losing a link that came up through the cache is not a cache failure
+    wifi_retry_action_t action = wifi_retry_on_disconnect(&retry, 1, 0);
+    CHECK(!action.forget_cache);
+    CHECK(action.delay_ms == WIFI_BACKOFF_MIN_MS / 2);
+}
+
+static void test_restart_mid_backoff(void)
+{
+    wifi_retry_t retry = { 0 };
+    wifi_retry_set_candidates(&retry, 2);
+    for (int i = 0; i < 10; i++) {
+        wifi_retry_on_disconnect(&retry, 2, 0);
+    }
+    CHECK(retry.attempt == 10);
+
+    // Profiles edited in the portal: rescan now, backoff from the start
+    wifi_retry_restart(&retry);
+    CHECK(retry.attempt == 0);
+    CHECK(retry.profile_failures == 0);
+    CHECK(retry.order_pos >= retry.order_count);
+    CHECK(wifi_retry_backoff(&retry, 0) == WIFI_BACKOFF_MIN_MS / 2);
+}
+
+static void test_portal_save_during_outage(void)
+{
+    // Recovery portal, AP+STA: the upstream AP is down, the station has been
+    // failing over between two saved networks and backing off
+    wifi_retry_t retry = { 0 };
+    wifi_retry_set_candidates(&retry, 2);
+    for (int i = 0; i < 2 * WIFI_FAILOVER_ATTEMPTS + 1; i++) {
+        wifi_retry_on_disconnect(&retry, 2, 0);
+    }
+    CHECK(retry.order_pos >= retry.order_count);
+    wifi_retry_set_candidates(&retry, 0);           // Rescan found nothing in range
+    CHECK(wifi_retry_backoff(&retry, 0) > WIFI_BACKOFF_MIN_MS);
+
+    // A third network saved in the portal: rescan at once, and the new
+    // candidate gets a full WIFI_FAILOVER_ATTEMPTS from the shortest delay
+    wifi_retry_restart(&retry);
+    CHECK(retry.order_pos >= retry.order_count);
+    wifi_retry_set_candidates(&retry, 1);
+    for (int i = 1; i < WIFI_FAILOVER_ATTEMPTS; i++) {
+        wifi_retry_action_t action = wifi_retry_on_disconnect(&retry, 3, 0);
+        CHECK(!action.failover);
+        CHECK(action.delay_ms == wifi_backoff_ms(i - 1, 0));
+    }
+    CHECK(wifi_retry_on_disconnect(&retry, 3, 0).failover);
+
+    // Connected: the next loss starts from the shortest delay again
+    wifi_retry_on_connected(&retry);
+    CHECK(retry.attempt == 0);
+    CHECK(retry.profile_failures == 0);
+}
+
+int main(void)
+{
+    RUN_TEST(test_strongest_first);
+    RUN_TEST(test_out_of_range_dropped);
+    RUN_TEST(test_best_bssid_counts);
+    RUN_TEST(test_recency_bonus);
+    RUN_TEST(test_ties_keep_profile_order);
+    RUN_TEST(test_full_store);
+    RUN_TEST(test_backoff_bounds);
+    RUN_TEST(test_disconnect_storm_single_profile);
+    RUN_TEST(test_failover_then_rescan);
+    RUN_TEST(test_fast_connect_failure_forgets_cache);
+    RUN_TEST(test_fast_connect_success_keeps_cache);
+    RUN_TEST(test_restart_mid_backoff);
+    RUN_TEST(test_portal_save_during_outage);
+    return TEST_EXIT();
+}
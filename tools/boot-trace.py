@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+import sys
+import struct
+import argparse
+import urllib.request
+from pathlib import Path
+
+# Must match boot_trace.h
+TRACE_MAGIC = 0x54425254
+TRACE_FORMAT = 1
+HEADER = struct.Struct('<IBBHI32s')
+EVENT = struct.Struct('<QHH')
+
+# boot_trace_stage_t, in order
+STAGES = ['app_start', 'nvs', 'led', 'button', 'recovery', 'health_start',
+          'wifi', 'ota_server', 'ready', 'wifi_ip', 'validated', 'ota']
+
+# ota_phase_t, in order
+PHASES = ['idle', 'queued', 'connecting', 'downloading', 'verifying',
+          'scheduled', 'rebooting', 'failed', 'cancelled']
+
+RESETS = ['unknown', 'poweron', 'ext', 'sw', 'panic', 'int_wdt', 'task_wdt',
+          'wdt', 'deepsleep', 'brownout', 'sdio']
+
+def load(source):
+    """Raw dump from a file or from http://<device>/trace.bin"""
+    if source.startswith('http://') or source.startswith('https://'):
+        with urllib.request.urlopen(source, timeout=10) as resp:
+            return resp.read()
+    return Path(source).read_bytes()
+
+def parse(data):
+    """
+    Dump from GET /trace.bin: one or two traces (previous boot, then this one),
+    each a header followed by its events. Returns a list of dicts.
+    """
+    traces = []
+    pos = 0
+    while pos + HEADER.size <= len(data):
+        magic, fmt, reset, count, boot, version = HEADER.unpack_from(data, pos)
+        if magic != TRACE_MAGIC or fmt != TRACE_FORMAT:
+            sys.exit(f"Not a boot trace at offset {pos} (magic 0x{magic:08x}, format {fmt})")
+        pos += HEADER.size
+        events = []
+        for _ in range(count):
+            t_us, stage, arg = EVENT.unpack_from(data, pos)
+            pos += EVENT.size
+            events.append((t_us, stage, arg))
+        traces.append({
+            'boot': boot,
+            'reset': RESETS[reset] if reset < len(RESETS) else str(reset),
+            'version': version.split(b'\0', 1)[0].decode(errors='replace'),
+            'events': events,
+        })
+    return traces
+
+def label(stage, arg):
+    name = STAGES[stage] if stage < len(STAGES) else f"stage{stage}"
+    if name == 'ota':
+        return f"ota:{PHASES[arg] if arg < len(PHASES) else arg}"
+    return name
+
+def durations(trace):
+    """Time each stage took (since the previous mark), first occurrence only"""
+    out = {}
+    prev = 0
+    for t_us, stage, arg in trace['events']:
+        out.setdefault(label(stage, arg), t_us - prev)
+        prev = t_us
+    return out
+
+def render(trace):
+    print(f"Boot {trace['boot']} ({trace['reset']} reset), version {trace['version']}")
+    print(f"  {'stage':<18}{'at ms':>12}{'took ms':>12}")
+    prev = 0
+    for t_us, stage, arg in trace['events']:
+        print(f"  {label(stage, arg):<18}{t_us / 1000:>12.1f}{(t_us - prev) / 1000:>12.1f}")
+        prev = t_us
+
+def compare(a, b):
+    da, db = durations(a), durations(b)
+    print(f"Stage durations, {a['version']} -> {b['version']}")
+    print(f"  {'stage':<18}{'A ms':>10}{'B ms':>10}{'delta ms':>11}")
+    for name in list(da) + [n for n in db if n not in da]:
+        ta, tb = da.get(name), db.get(name)
+        fa = f"{ta / 1000:.1f}" if ta is not None else '-'
+        fb = f"{tb / 1000:.1f}" if tb is not None else '-'
+        delta = f"{(tb - ta) / 1000:+.1f}" if ta is not None and tb is not None else ''
+        print(f"  {name:<18}{fa:>10}{fb:>10}{delta:>11}")
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(
+        description="Decode boot/OTA timing traces from GET /trace.bin",
+        epilog="Example: boot-trace.py http://192.168.1.50/trace.bin --save v1.bin; "
+               "boot-trace.py --compare v1.bin v2.bin")
+    parser.add_argument('source', nargs='?', help="dump file or http://<device>/trace.bin")
+    parser.add_argument('--save', metavar='FILE', help="also write the raw dump to FILE")
+    parser.add_argument('--compare', nargs=2, metavar=('A', 'B'),
+                        help="compare the latest boot of two dumps (e.g. two builds)")
+    args = parser.parse_args()
+
+    if args.compare:
+        a, b = (parse(load(s)) for s in args.compare)
+        if not a or not b:
+            sys.exit("Empty dump")
+        compare(a[-1], b[-1])
+    elif args.source:
+        data = load(args.source)
+        if args.save:
+            Path(args.save).write_bytes(data)
+        for trace in parse(data):
+            render(trace)
+    else:
+        parser.error("give a source or --compare A B")
@@ -0,0 +1,33 @@
+#!/usr/bin/env python3
+import sys
+import gzip
+import argparse
+from pathlib import Path
+
+def gzip_asset(input_file, output_file, max_size):
+    data = Path(input_file).read_bytes()
+
+    # mtime=0 keeps the output (and therefore the firmware image) reproducible
+    packed = gzip.compress(data, compresslevel=9, mtime=0)
+
+    # Build-time check of what gets embedded
+    if gzip.decompress(packed) != data:
+        sys.exit(f"Error: {output_file} does not round-trip")
+    if len(packed) > max_size:
+        sys.exit(f"Error: {output_file} is {len(packed)} bytes, limit {max_size}")
+
+    Path(output_file).write_bytes(packed)
+    print(f"{Path(input_file).name}: {len(data)} -> {len(packed)} bytes "
+          f"({100 * len(packed) // max(len(data), 1)}%)")
+
+def main():
+    parser = argparse.ArgumentParser(description="Gzip a portal asset for embedding")
+    parser.add_argument('input', help="Source file (main/www/...)")
+    parser.add_argument('output', help="Gzipped file to embed")
+    parser.add_argument('--max-size', type=int, default=16 * 1024,
+                        help="Fail the build above this many compressed bytes")
+    args = parser.parse_args()
+    gzip_asset(args.input, args.output, args.max_size)
+
+if __name__ == "__main__":
+    main()
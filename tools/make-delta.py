@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+import sys
+import struct
+import hashlib
+import argparse
+import importlib.util
+from pathlib import Path
+
+# Reuse header packing and compression from prepare-firmware.py
+_spec = importlib.util.spec_from_file_location(
+    "prepare_firmware", Path(__file__).with_name("prepare-firmware.py"))
+prepare_firmware = importlib.util.module_from_spec(_spec)
+_spec.loader.exec_module(prepare_firmware)
+
+# Header flag, must match OTA_HEADER_FLAG_DELTA in main/ota_header.h
+FLAG_DELTA = 0x02
+
+# Patch ops, must match main/ota_delta.h
+OP_COPY = 0x01
+OP_ADD = 0x02
+
+BLOCK = 32      # Minimum match length
+STRIDE = 16     # Base image is indexed every STRIDE bytes
+
+def make_patch(old, new):
+    """
+    Greedy block matcher: index aligned blocks of the base image, scan the
+    new image byte by byte and extend every hit in both directions.
+    Returns the patch stream and the number of bytes covered by COPY ops.
+    """
+    index = {}
+    for i in range(0, len(old) - BLOCK + 1, STRIDE):
+        index.setdefault(old[i:i + BLOCK], i)
+
+    patch = bytearray()
+    copied = 0
+
+    def emit_add(data):
+        if data:
+            patch.extend(struct.pack('<BI', OP_ADD, len(data)))
+            patch.extend(data)
+
+    lit_start = 0
+    j = 0
+    while j <= len(new) - BLOCK:
+        i = index.get(new[j:j + BLOCK])
+        if i is None:
+            j += 1
+            continue
+
+        back = 0
+        while j - back > lit_start and i - back > 0 and new[j - back - 1] == old[i - back - 1]:
+            back += 1
+        fwd = BLOCK
+        while j + fwd < len(new) and i + fwd < len(old) and new[j + fwd] == old[i + fwd]:
+            fwd += 1
+
+        emit_add(new[lit_start:j - back])
+        patch.extend(struct.pack('<BII', OP_COPY, i - back, back + fwd))
+        copied += back + fwd
+        j += fwd
+        lit_start = j
+
+    emit_add(new[lit_start:])
+    return bytes(patch), copied
+
+def apply_patch(old, patch):
+    """Reference applier used to self-check every generated patch"""
+    out = bytearray()
+    pos = 0
+    while pos < len(patch):
+        op = patch[pos]
+        if op == OP_COPY:
+            src, length = struct.unpack_from('<II', patch, pos + 1)
+            out.extend(old[src:src + length])
+            pos += 9
+        elif op == OP_ADD:
+            length, = struct.unpack_from('<I', patch, pos + 1)
+            out.extend(patch[pos + 5:pos + 5 + length])
+            pos += 5 + length
+        else:
+            raise ValueError(f"bad op 0x{op:02x} at {pos}")
+    return bytes(out)
+
+def make_delta(base_file, input_file, output_file, version, compress=False, block_size=None):
+    """
+    Delta container:
+    - Header (44 bytes): as prepare-firmware.py, with FLAG_DELTA set
+    - Base size (4 bytes) + base SHA256 (32 bytes): image the patch applies to
+    - With block_size: per-block digests of the patch stream (FLAG_BLOCKS)
+    - Patch stream (optionally raw deflate, FLAG_DEFLATE)
+    """
+    old = Path(base_file).read_bytes()
+    new = Path(input_file).read_bytes()
+
+    patch, copied = make_patch(old, new)
+    if apply_patch(old, patch) != new:
+        sys.exit("Internal error: patch does not reproduce the new image")
+
+    flags = FLAG_DELTA
+    payload = patch
+    if compress:
+        flags |= prepare_firmware.FLAG_DEFLATE
+        payload = prepare_firmware.compress_firmware(patch)
+    if block_size:
+        flags |= prepare_firmware.FLAG_BLOCKS
+
+    sha256 = hashlib.sha256(new).digest()
+    version_uint = (flags << 24) | prepare_firmware.parse_version(version)
+    header = struct.pack('<III', prepare_firmware.HEADER_MAGIC, version_uint, len(new)) + sha256
+    ext = struct.pack('<I', len(old)) + hashlib.sha256(old).digest()
+    if block_size:
+        ext += prepare_firmware.block_table(payload, block_size)
+
+    with open(output_file, 'wb') as f:
+        f.write(header + ext + payload)
+
+    total = len(header) + len(ext) + len(payload)
+    print(f"✓ Delta prepared:")
+    print(f"  Version: {version}")
+    print(f"  Base: {len(old)} bytes, SHA256 {hashlib.sha256(old).hexdigest()}")
+    print(f"  Image: {len(new)} bytes, {100 * copied / max(len(new), 1):.1f}% reused from base")
+    print(f"  Patch: {len(payload)} bytes{' (compressed)' if compress else ''}")
+    print(f"  Download: {total} bytes ({100 * total / max(len(new), 1):.1f}% of full image)")
+    print(f"  Output: {output_file}")
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(
+        description="Generate a delta OTA container from the running image to a new one",
+        epilog="Example: make-delta.py app_v1.bin app_v2.bin app_v1_to_v2.bin 2.0.0")
+    parser.add_argument('base', help="raw binary currently running on the device")
+    parser.add_argument('input', help="new raw application binary")
+    parser.add_argument('output', help="delta container")
+    parser.add_argument('version', help="major.minor.patch of the new image")
+    parser.add_argument('--compress', action='store_true',
+                        help="deflate the patch stream")
+    parser.add_argument('--block-size', type=int, metavar='BYTES',
+                        help="add per-block digests of the patch stream (e.g. 8192)")
+    args = parser.parse_args()
+
+    make_delta(args.base, args.input, args.output, args.version, args.compress, args.block_size)
@@ -2,15 +2,60 @@
 import sys
 import struct
 import hashlib
+import zlib
+import argparse
 from pathlib import Path
 
-def add_firmware_header(input_file, output_file, version):
+HEADER_MAGIC = 0xDEADBEEF
+
+# Header flags, stored in the top byte of the version word
+FLAG_DEFLATE = 0x01
+FLAG_BLOCKS = 0x04
+
+# Must match OTA_BLOCK_MAX_SIZE / OTA_BLOCK_MAX_COUNT in main/ota_blocks.h
+BLOCK_MAX_SIZE = 16 * 1024
+BLOCK_MAX_COUNT = 1024
+
+# Must match OTA_INFLATE_WINDOW_BITS in main/ota_inflate.h
+DEFLATE_WINDOW_BITS = 12
+
+def parse_version(version):
+    # Parse version (e.g., "1.0.0" -> 0x010000)
+    major, minor, patch = map(int, version.split('.'))
+    return (major << 16) | (minor << 8) | patch
+
+def compress_firmware(firmware_data):
+    """
+    Raw deflate (no zlib wrapper) with a small window so the device
+    only needs 2^DEFLATE_WINDOW_BITS bytes of history to decode it.
+    """
+    compressor = zlib.compressobj(9, zlib.DEFLATED, -DEFLATE_WINDOW_BITS, 9)
+    return compressor.compress(firmware_data) + compressor.flush()
+
+def block_table(payload, block_size):
+    """
+    Block extension (FLAG_BLOCKS) for a payload as it goes over the wire:
+    - Block size (4 bytes), block count (4 bytes)
+    - SHA256 of the digest table (32 bytes)
+    - Digest table: SHA256 of every block_size piece, the last one shorter
+    """
+    if block_size <= 0 or block_size % 4096 or block_size > BLOCK_MAX_SIZE:
+        sys.exit(f"Block size must be a multiple of 4096 up to {BLOCK_MAX_SIZE}")
+    table = b''.join(hashlib.sha256(payload[i:i + block_size]).digest()
+                     for i in range(0, len(payload), block_size))
+    count = len(table) // 32
+    if count > BLOCK_MAX_COUNT:
+        sys.exit(f"{count} blocks, the device accepts {BLOCK_MAX_COUNT}; use a larger --block-size")
+    return struct.pack('<II', block_size, count) + hashlib.sha256(table).digest() + table
+
+def add_firmware_header(input_file, output_file, version, compress=False, block_size=None):
     """
     Add header to firmware binary:
     - Magic (4 bytes): 0xDEADBEEF
-    - Version (4 bytes): major.minor.patch as uint32
-    - Size (4 bytes): firmware size
-    - SHA256 (32 bytes): firmware hash
+    - Version (4 bytes): flags << 24 | major.minor.patch as uint32
+    - Size (4 bytes): firmware size (uncompressed)
+    - SHA256 (32 bytes): firmware hash (uncompressed)
+    - With block_size: block_table() of the payload
     """
     
     # Read original firmware
@@ -20,30 +65,49 @@ def add_firmware_header(input_file, output_file, version):
     # Calculate hash
     sha256 = hashlib.sha256(firmware_data).digest()
     
-    # Parse version (e.g., "1.0.0" -> 0x010000)
-    major, minor, patch = map(int, version.split('.'))
-    version_uint = (major << 16) | (minor << 8) | patch
+    flags = 0
+    payload = firmware_data
+    if compress:
+        flags |= FLAG_DEFLATE
+        payload = compress_firmware(firmware_data)
+    if block_size:
+        flags |= FLAG_BLOCKS
+
+    version_uint = (flags << 24) | parse_version(version)
     
     # Build header
-    magic = 0xDEADBEEF
     size = len(firmware_data)
     
-    header = struct.pack('<III', magic, version_uint, size) + sha256
+    header = struct.pack('<III', HEADER_MAGIC, version_uint, size) + sha256
+    if block_size:
+        header += block_table(payload, block_size)
     
     # Write output
     with open(output_file, 'wb') as f:
-        f.write(header + firmware_data)
+        f.write(header + payload)
     
     print(f"✓ Firmware prepared:")
     print(f"  Version: {version}")
     print(f"  Size: {size} bytes")
+    if compress:
+        print(f"  Compressed: {len(payload)} bytes ({100 * len(payload) / size:.1f}%)")
+    if block_size:
+        print(f"  Blocks: {(len(payload) + block_size - 1) // block_size} x {block_size} bytes")
     print(f"  SHA256: {sha256.hex()}")
     print(f"  Output: {output_file}")
 
 if __name__ == '__main__':
-    if len(sys.argv) != 4:
-        print("Usage: prepare-firmware.py <input.bin> <output.bin> <version>")
-        print("Example: prepare-firmware.py app.bin app_signed.bin 1.0.0")
-        sys.exit(1)
+    parser = argparse.ArgumentParser(
+        description="Add OTA header to firmware binary",
+        epilog="Example: prepare-firmware.py app.bin app_signed.bin 1.0.0")
+    parser.add_argument('input', help="raw application binary")
+    parser.add_argument('output', help="prepared firmware file")
+    parser.add_argument('version', help="major.minor.patch")
+    parser.add_argument('--compress', action='store_true',
+                        help="deflate the payload (device decompresses while flashing)")
+    parser.add_argument('--block-size', type=int, metavar='BYTES',
+                        help="add per-block digests (e.g. 8192) so the device rejects "
+                             "a corrupt block as soon as it arrives")
+    args = parser.parse_args()
     
-    add_firmware_header(sys.argv[1], sys.argv[2], sys.argv[3])
\ No newline at end of file
+    add_firmware_header(args.input, args.output, args.version, args.compress, args.block_size)
@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+import sys
+import struct
+import hashlib
+import zlib
+import argparse
+import importlib.util
+from pathlib import Path
+
+# Reuse the container constants from prepare-firmware.py
+_spec = importlib.util.spec_from_file_location(
+    "prepare_firmware", Path(__file__).with_name("prepare-firmware.py"))
+prepare_firmware = importlib.util.module_from_spec(_spec)
+_spec.loader.exec_module(prepare_firmware)
+
+# Must match OTA_HEADER_FLAG_DELTA in main/ota_header.h
+FLAG_DELTA = 0x02
+
+def verify_container(path):
+    """
+    Check a container the way the device does: header, block table and every
+    block digest, then the image SHA256 when the payload is the plain image.
+    Returns the list of problems found, empty when the file is good.
+    """
+    data = Path(path).read_bytes()
+    if len(data) < 44:
+        return ["shorter than the 44-byte header"]
+    magic, version_uint, size = struct.unpack_from('<III', data, 0)
+    if magic != prepare_firmware.HEADER_MAGIC:
+        return [f"bad magic 0x{magic:08x}"]
+    sha256 = data[12:44]
+    flags = version_uint >> 24
+    pos = 44
+    problems = []
+
+    print(f"Version: {(version_uint >> 16) & 0xFF}.{(version_uint >> 8) & 0xFF}.{version_uint & 0xFF}")
+    print(f"Image: {size} bytes, flags 0x{flags:02x}")
+
+    if flags & FLAG_DELTA:
+        base_size, = struct.unpack_from('<I', data, pos)
+        print(f"Delta against {base_size}-byte base {data[pos + 4:pos + 36].hex()}")
+        pos += 36
+
+    if flags & prepare_firmware.FLAG_BLOCKS:
+        block_size, count = struct.unpack_from('<II', data, pos)
+        table_sha = data[pos + 8:pos + 40]
+        pos += 40
+        table = data[pos:pos + 32 * count]
+        pos += 32 * count
+        payload = data[pos:]
+        print(f"Blocks: {count} x {block_size} bytes")
+        if hashlib.sha256(table).digest() != table_sha:
+            problems.append("block table digest mismatch")
+        if count != (len(payload) + block_size - 1) // block_size:
+            problems.append(f"table has {count} blocks, payload needs "
+                            f"{(len(payload) + block_size - 1) // block_size}")
+        for i in range(min(count, len(table) // 32)):
+            block = payload[i * block_size:(i + 1) * block_size]
+            if hashlib.sha256(block).digest() != table[i * 32:(i + 1) * 32]:
+                problems.append(f"block {i} (payload offset {i * block_size}) corrupt")
+    else:
+        payload = data[pos:]
+
+    if flags & FLAG_DELTA:
+        print("Image SHA256 needs the base image, not checked")
+        return problems
+
+    image = payload
+    if flags & prepare_firmware.FLAG_DEFLATE:
+        try:
+            image = zlib.decompress(payload, -prepare_firmware.DEFLATE_WINDOW_BITS)
+        except zlib.error as e:
+            problems.append(f"compressed payload does not decode: {e}")
+            return problems
+    if len(image) != size:
+        problems.append(f"image is {len(image)} bytes, header says {size}")
+    elif hashlib.sha256(image).digest() != sha256:
+        problems.append("image SHA256 mismatch")
+    return problems
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(
+        description="Verify an OTA container before publishing it",
+        epilog="Example: verify-firmware.py release/firmware_v2.0.0.bin")
+    parser.add_argument('input', help="container from prepare-firmware.py or make-delta.py")
+    args = parser.parse_args()
+
+    problems = verify_container(args.input)
+    for p in problems:
+        print(f"✗ {p}")
+    if problems:
+        sys.exit(1)
+    print("✓ Container OK")